@@ -0,0 +1,56 @@
+/*
+ * PXA2xx/PXA3xx DMA controller
+ *
+ * Copyright (C) 2010 Marek Vasut <marek.vasut@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston,
+ * MA 02111-1307 USA
+ */
+
+#ifndef __PXA_DMA_H__
+#define __PXA_DMA_H__
+
+#include <asm/types.h>
+
+#if defined(CONFIG_PXA250)
+#define	PXA_DMA_CHANNELS	16
+#else
+#define	PXA_DMA_CHANNELS	32
+#endif
+
+/*
+ * Largest chunk a single descriptor moves. DCMD allows up to 8K - 1, we
+ * keep to a power of two so every chunk stays burst-aligned.
+ */
+#define	PXA_DMA_DESC_MAXLEN	4096
+
+/* Hardware descriptor, must be 16-byte aligned */
+struct pxa_dma_desc {
+	u32	ddadr;	/* next descriptor address */
+	u32	dsadr;	/* source address */
+	u32	dtadr;	/* target address */
+	u32	dcmd;	/* command */
+} __attribute__((aligned(16)));
+
+int pxa_dma_request(void);
+void pxa_dma_free(int chan);
+int pxa_dma_prep(struct pxa_dma_desc *desc, int ndesc,
+			u32 src, u32 dst, u32 len, u32 dcmd);
+void pxa_dma_start(int chan, struct pxa_dma_desc *desc);
+int pxa_dma_done(int chan);
+int pxa_dma_wait(int chan, ulong timeout);
+void pxa_dma_stop(int chan);
+
+#endif /* __PXA_DMA_H__ */
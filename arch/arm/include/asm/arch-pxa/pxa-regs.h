@@ -150,6 +150,7 @@ typedef void		(*ExcpHndlr) (void) ;
 #define DCSR_STARTINTR	(1 << 1)	/* Start Interrupt (read / write) */
 #define DCSR_BUSERR	(1 << 0)	/* Bus Error Interrupt (read / write) */
 
+#define DALGN		__REG(0x400000a0)  /* DMA Alignment Register */
 #define DINT		__REG(0x400000f0)  /* DMA Interrupt Register */
 
 #define DRCMR0		__REG(0x40000100)  /* Request to Channel Map Register for DREQ 0 */
@@ -0,0 +1,75 @@
+/*
+ * See file CREDITS for list of people who contributed to this
+ * project.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston,
+ * MA 02111-1307 USA
+ */
+
+/*
+ * Block device cache: show statistics, resize, invalidate
+ */
+#include <common.h>
+#include <command.h>
+#include <part.h>
+
+int do_blkcache(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[])
+{
+	struct blk_cache_stats stats;
+
+	if (argc < 2)
+		return cmd_usage(cmdtp);
+
+	if (strcmp(argv[1], "show") == 0 && argc == 2) {
+		blk_cache_get_stats(&stats);
+		printf("    hits: %u\n", stats.hits);
+		printf("  misses: %u\n", stats.misses);
+		printf(" entries: %u / %u\n", stats.entries, stats.max_entries);
+		printf("  blocks: %u per entry\n", stats.max_blocks);
+#ifdef CONFIG_BLOCK_READAHEAD
+		printf("readahead: %u hits, %u reads, %u blocks max\n",
+			stats.ra_hits, stats.ra_reads, stats.ra_max);
+#endif
+	} else if (strcmp(argv[1], "reset") == 0 && argc == 2) {
+		blk_cache_reset_stats();
+	} else if (strcmp(argv[1], "invalidate") == 0 && argc == 2) {
+		blk_cache_invalidate(IF_TYPE_UNKNOWN, 0);
+	} else if (strcmp(argv[1], "configure") == 0 && argc == 4) {
+		blk_cache_configure(simple_strtoul(argv[2], NULL, 0),
+				simple_strtoul(argv[3], NULL, 0));
+#ifdef CONFIG_BLOCK_READAHEAD
+	} else if (strcmp(argv[1], "readahead") == 0 && argc == 3) {
+		blk_readahead_configure(simple_strtoul(argv[2], NULL, 0));
+#endif
+	} else {
+		return cmd_usage(cmdtp);
+	}
+
+	return 0;
+}
+
+U_BOOT_CMD(
+	blkcache, 4, 0, do_blkcache,
+	"block device cache",
+	"show - show cache statistics\n"
+	"blkcache reset - reset hit/miss counters\n"
+	"blkcache invalidate - drop all cached blocks\n"
+	"blkcache configure <blocks> <entries>\n"
+	"    - cache reads of up to <blocks> blocks in <entries> entries"
+#ifdef CONFIG_BLOCK_READAHEAD
+	"\nblkcache readahead <blocks>\n"
+	"    - limit the readahead window to <blocks> blocks (0: off)"
+#endif
+);
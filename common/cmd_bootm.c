@@ -341,7 +341,11 @@ static int bootm_load_os(image_info_t os, ulong *load_end, int boot_progress)
 
 	switch (comp) {
 	case IH_COMP_NONE:
-		if (load == blob_start) {
+		/*
+		 * Images whose data is already at the load address, as
+		 * left by "load -d", are not moved either.
+		 */
+		if (load == blob_start || load == image_start) {
 			printf ("   XIP %s ... ", type_name);
 		} else {
 			printf ("   Loading %s ... ", type_name);
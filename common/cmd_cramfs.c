@@ -82,6 +82,7 @@ extern int cramfs_check (struct part_info *info);
 extern int cramfs_load (char *loadoffset, struct part_info *info, char *filename);
 extern int cramfs_ls (struct part_info *info, char *filename);
 extern int cramfs_info (struct part_info *info);
+extern int cramfs_map (struct part_info *info, char *filename, ulong *addr);
 
 /***************************************************/
 /* U-boot commands				   */
@@ -194,6 +195,65 @@ int do_cramfs_ls(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[])
 	return ret ? 0 : 1;
 }
 
+/**
+ * Routine implementing u-boot cramfsmap command which finds a file that
+ * is stored uncompressed in the image at location 'cramfsaddr', so that
+ * it can be used in place without loading it. Sets 'fileaddr' and
+ * 'filesize'.
+ *
+ * @param cmdtp command internal data
+ * @param flag command flag
+ * @param argc number of arguments supplied to the command
+ * @param argv arguments list
+ * @return 0 on success, 1 otherwise
+ */
+int do_cramfs_map(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[])
+{
+	char *filename;
+	int size;
+	char buf[12];
+	ulong fileaddr;
+
+	struct part_info part;
+	struct mtd_device dev;
+	struct mtdids id;
+
+	ulong addr;
+	addr = simple_strtoul(getenv("cramfsaddr"), NULL, 16);
+
+	/* fake a NOR device, as in do_cramfs_load() */
+	id.type = MTD_DEV_TYPE_NOR;
+	id.num = 0;
+	dev.id = &id;
+	part.dev = &dev;
+	part.offset = addr - flash_info[id.num].start[0];
+
+	if ((filename = getenv("bootfile")) == NULL) {
+		filename = "uImage";
+	}
+
+	if (argc == 2) {
+		filename = argv[1];
+	}
+
+	size = -1;
+	if (cramfs_check(&part))
+		size = cramfs_map (&part, filename, &fileaddr);
+
+	if (size < 0) {
+		printf("### CRAMFS: %s is not stored uncompressed\n", filename);
+		return 1;
+	}
+
+	printf("### CRAMFS: %d bytes at 0x%lx\n", size, fileaddr);
+	sprintf(buf, "%lx", fileaddr);
+	setenv("fileaddr", buf);
+	sprintf(buf, "%x", size);
+	setenv("filesize", buf);
+
+	return 0;
+}
+
 /* command line only */
 
 /***************************************************/
@@ -210,6 +270,14 @@ U_BOOT_CMD(
 	"[ directory ]\n"
 	"    - list files in a directory.\n"
 );
+U_BOOT_CMD(
+	cramfsmap,	2,	0,	do_cramfs_map,
+	"locate an uncompressed file in a filesystem image",
+	"[ filename ]\n"
+	"    - set 'fileaddr' and 'filesize' to the location of a file\n"
+	"      stored uncompressed in the image at 'cramfsaddr', to use\n"
+	"      it in place (XIP) without loading it\n"
+);
 
 #endif /* #ifdef CONFIG_CRAMFS_CMDLINE */
 
@@ -133,6 +133,8 @@ int do_ext2load (cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[])
 	block_dev_desc_t *dev_desc = NULL;
 	char buf [12];
 	unsigned long count;
+	unsigned long pos = 0;
+	ulong time;
 	char *addr_str;
 
 	switch (argc) {
@@ -156,6 +158,9 @@ int do_ext2load (cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[])
 		filename = argv[4];
 		count = 0;
 		break;
+	case 7:
+		pos = simple_strtoul (argv[6], NULL, 16);
+		/* Fall through */
 	case 6:
 		addr = simple_strtoul (argv[3], NULL, 16);
 		filename = argv[4];
@@ -188,7 +193,9 @@ int do_ext2load (cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[])
 	PRINTF("Using device %s%d, partition %d\n", argv[1], dev, part);
 
 	if (part != 0) {
-		if (get_partition_info (dev_desc, part, &info)) {
+		/* No need to read the partition table if still mounted */
+		if (!ext2fs_mounted_part (dev_desc, part, &info) &&
+		    get_partition_info (dev_desc, part, &info)) {
 			printf ("** Bad partition %d **\n", part);
 			return 1;
 		}
@@ -228,23 +235,34 @@ int do_ext2load (cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[])
 		ext2fs_close();
 		return 1;
 	}
+	if (pos > filelen) {
+		printf("** Offset 0x%lx beyond end of file %s\n",
+			pos, filename);
+		ext2fs_close();
+		return 1;
+	}
+	filelen -= pos;
 	if ((count < filelen) && (count != 0)) {
 	    filelen = count;
 	}
 
-	if (ext2fs_read((char *)addr, filelen) != filelen) {
+	time = get_timer(0);
+	if (ext2fs_read_at((char *)addr, pos, filelen) != filelen) {
 		printf("** Unable to read \"%s\" from %s %d:%d **\n",
 			filename, argv[1], dev, part);
 		ext2fs_close();
 		return 1;
 	}
 
+	time = get_timer(time);
+
 	ext2fs_close();
 
 	/* Loading ok, update default load address */
 	load_addr = addr;
 
-	printf ("%d bytes read\n", filelen);
+	printf ("%d bytes read in %d run(s) (", filelen, ext2fs_read_runs());
+	print_rate(filelen, time, ")\n");
 	sprintf(buf, "%X", filelen);
 	setenv("filesize", buf);
 
@@ -252,9 +270,10 @@ int do_ext2load (cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[])
 }
 
 U_BOOT_CMD(
-	ext2load,	6,	0,	do_ext2load,
+	ext2load,	7,	0,	do_ext2load,
 	"load binary file from a Ext2 filesystem",
-	"<interface> <dev[:part]> [addr] [filename] [bytes]\n"
+	"<interface> <dev[:part]> [addr] [filename] [bytes [pos]]\n"
 	"    - load binary file 'filename' from 'dev' on 'interface'\n"
-	"      to address 'addr' from ext2 filesystem"
+	"      to address 'addr' from ext2 filesystem.\n"
+	"      'pos' gives the file position to start loading from."
 );
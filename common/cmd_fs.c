@@ -0,0 +1,386 @@
+/*
+ * Generic filesystem commands for block devices
+ *
+ * See file CREDITS for list of people who contributed to this
+ * project.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston,
+ * MA 02111-1307 USA
+ */
+
+#include <common.h>
+#include <command.h>
+#include <fs.h>
+#include <image.h>
+
+DECLARE_GLOBAL_DATA_PTR;
+
+#ifndef CONFIG_SYS_BOOTM_LEN
+#define CONFIG_SYS_BOOTM_LEN	0x800000	/* as in cmd_bootm.c */
+#endif
+
+/*
+ * State of "load -d": the file is a legacy image or a gzip file and is
+ * decompressed while it is read, piece by piece.
+ */
+struct load_stream {
+	image_stream_t	is;
+	int		started;	/* 'is' is set up */
+	int		legacy;		/* a legacy image, 'hdr' is valid */
+	int		verify;		/* check and compute CRCs */
+	image_header_t	hdr;
+	ulong		addr;		/* destination of gzip files */
+	ulong		todo;		/* image data still to be read */
+	uint32_t	dcrc;		/* CRC of the data read */
+	uint32_t	ucrc;		/* CRC of the data decompressed */
+	ulong		ucrc_len;	/* bytes covered by 'ucrc' */
+};
+
+/*
+ * The header for the decompressed data of a legacy image goes in front of
+ * its load address, check that this is still RAM.
+ */
+static int load_stream_hdr_fits (ulong dst)
+{
+#ifdef CONFIG_NR_DRAM_BANKS
+	bd_t *bd = gd->bd;
+	ulong start = dst - image_get_header_size();
+	int i;
+
+	if (dst < image_get_header_size())
+		return 0;
+	for (i = 0; i < CONFIG_NR_DRAM_BANKS; i++)
+		if (start >= bd->bi_dram[i].start &&
+		    dst - bd->bi_dram[i].start <= bd->bi_dram[i].size)
+			return 1;
+	return 0;
+#else
+	return 1;
+#endif
+}
+
+/* Look at the start of the file, return the length of its header */
+static int load_stream_start (struct load_stream *ls, const uchar *buf,
+			      ulong len)
+{
+	image_header_t *hdr = &ls->hdr;
+	uint8_t comp = IH_COMP_GZIP;
+	ulong dst = ls->addr;
+	int hlen = 0;
+
+	if (len >= image_get_header_size() &&
+	    image_check_magic((const image_header_t *)buf)) {
+		memcpy(hdr, buf, image_get_header_size());
+		if (!image_check_hcrc(hdr)) {
+			puts("** Bad header checksum **\n");
+			return -1;
+		}
+		comp = image_get_comp(hdr);
+		if (image_check_type(hdr, IH_TYPE_MULTI) &&
+		    comp != IH_COMP_NONE) {
+			puts("** Compressed multi-file images can not be "
+			     "streamed **\n");
+			return -1;
+		}
+		ls->legacy = 1;
+		ls->todo = image_get_size(hdr);
+		dst = image_get_load(hdr);
+		hlen = image_get_header_size();
+		if (!load_stream_hdr_fits(dst)) {
+			printf("** No RAM for the image header below load "
+			       "address 0x%08lx **\n", dst);
+			return -1;
+		}
+	} else if (len < 2 || buf[0] != 0x1f || buf[1] != 0x8b) {
+		puts("** Neither a legacy image nor a gzip file **\n");
+		return -1;
+	}
+
+	if (image_stream_init(&ls->is, comp, (void *)dst,
+			      CONFIG_SYS_BOOTM_LEN) != 0)
+		return -1;
+	ls->started = 1;
+
+	return hlen;
+}
+
+static int load_stream_write (void *priv, const void *data, ulong len)
+{
+	struct load_stream *ls = priv;
+	const uchar *buf = data;
+	int hlen;
+
+	if (!ls->started) {
+		hlen = load_stream_start(ls, buf, len);
+		if (hlen < 0)
+			return -1;
+		buf += hlen;
+		len -= hlen;
+	}
+
+	if (len > ls->todo)
+		len = ls->todo;
+	if (ls->verify)
+		ls->dcrc = crc32(ls->dcrc, buf, len);
+	if (image_stream_write(&ls->is, buf, len) != 0)
+		return -1;
+	ls->todo -= len;
+
+	/* While it is still in the cache */
+	if (ls->verify && ls->legacy) {
+		ls->ucrc = crc32(ls->ucrc, ls->is.dst + ls->ucrc_len,
+				 ls->is.len - ls->ucrc_len);
+		ls->ucrc_len = ls->is.len;
+	}
+
+	if (ls->todo == 0 || (!ls->legacy && ls->is.done))
+		return 1;
+	return 0;
+}
+
+/*
+ * Replace the header of a legacy image by one for the decompressed data,
+ * in front of it at the load address. "bootm" then boots the kernel in
+ * place.
+ */
+static ulong load_stream_legacy_hdr (struct load_stream *ls)
+{
+	image_header_t *hdr;
+
+	if (ls->todo) {
+		puts("** Image truncated **\n");
+		return 0;
+	}
+	if (ls->verify && ls->dcrc != image_get_dcrc(&ls->hdr)) {
+		puts("** Bad data CRC **\n");
+		return 0;
+	}
+
+	hdr = (image_header_t *)(ls->is.dst - image_get_header_size());
+	memcpy(hdr, &ls->hdr, image_get_header_size());
+	image_set_comp(hdr, IH_COMP_NONE);
+	image_set_size(hdr, ls->is.len);
+	image_set_dcrc(hdr, ls->verify ? ls->ucrc : 0);
+	image_set_hcrc(hdr, 0);
+	image_set_hcrc(hdr, crc32(0, (uchar *)hdr, image_get_header_size()));
+
+	return (ulong)hdr;
+}
+
+static int do_fs_load_stream (int argc, char * const argv[])
+{
+	struct load_stream ls;
+	char *filename;
+	char buf[12];
+	ulong addr, time, size;
+	long read;
+
+	if (argc < 3 || argc > 5)
+		return -1;
+
+	memset(&ls, 0, sizeof(ls));
+	ls.todo = ~0UL;
+	ls.verify = getenv_yesno("verify");
+	if (argc >= 4) {
+		ls.addr = simple_strtoul(argv[3], NULL, 16);
+	} else {
+		char *addr_str = getenv("loadaddr");
+
+		if (addr_str != NULL)
+			ls.addr = simple_strtoul(addr_str, NULL, 16);
+		else
+			ls.addr = CONFIG_SYS_LOAD_ADDR;
+	}
+	if (argc >= 5)
+		filename = argv[4];
+	else
+		filename = getenv("bootfile");
+
+	if (!filename) {
+		puts("** No boot file defined **\n");
+		return 1;
+	}
+
+	if (fs_set_blk_dev(argv[1], argv[2], FS_TYPE_ANY))
+		return 1;
+
+	time = get_timer(0);
+	read = fs_read_stream(filename, load_stream_write, &ls);
+	if (ls.started && image_stream_end(&ls.is) != 0)
+		read = -1;
+	time = get_timer(time);
+	if (read < 0) {
+		printf("** Unable to load \"%s\" from %s %s (%s) **\n",
+			filename, argv[1], argv[2], fs_type_name());
+		return 1;
+	}
+
+	addr = (ulong)ls.is.dst;
+	size = ls.is.len;
+	if (ls.legacy) {
+		addr = load_stream_legacy_hdr(&ls);
+		if (addr == 0)
+			return 1;
+		size += image_get_header_size();
+	}
+
+	/* Loading ok, update default load address */
+	load_addr = addr;
+
+	printf("%ld bytes read from %s, %lu bytes at 0x%08lx (",
+		read, fs_type_name(), size, addr);
+	print_rate(read, time, ")\n");
+	sprintf(buf, "%lX", size);
+	setenv("filesize", buf);
+
+	return 0;
+}
+
+int do_fs_load (cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[])
+{
+	unsigned long addr;
+	unsigned long count = 0;
+	unsigned long pos = 0;
+	char *filename;
+	char buf[12];
+	ulong time;
+	long size;
+	int ret;
+
+	if (argc >= 2 && strcmp(argv[1], "-d") == 0) {
+		ret = do_fs_load_stream(argc - 1, argv + 1);
+		return ret < 0 ? cmd_usage(cmdtp) : ret;
+	}
+
+	if (argc < 3 || argc > 7)
+		return cmd_usage(cmdtp);
+
+	if (argc >= 4) {
+		addr = simple_strtoul(argv[3], NULL, 16);
+	} else {
+		char *addr_str = getenv("loadaddr");
+
+		if (addr_str != NULL)
+			addr = simple_strtoul(addr_str, NULL, 16);
+		else
+			addr = CONFIG_SYS_LOAD_ADDR;
+	}
+	if (argc >= 5)
+		filename = argv[4];
+	else
+		filename = getenv("bootfile");
+	if (argc >= 6)
+		count = simple_strtoul(argv[5], NULL, 16);
+	if (argc >= 7)
+		pos = simple_strtoul(argv[6], NULL, 16);
+
+	if (!filename) {
+		puts("** No boot file defined **\n");
+		return 1;
+	}
+
+	if (fs_set_blk_dev(argv[1], argv[2], FS_TYPE_ANY))
+		return 1;
+
+	time = get_timer(0);
+	size = fs_read(filename, addr, pos, count);
+	time = get_timer(time);
+	if (size < 0) {
+		printf("** Unable to read \"%s\" from %s %s (%s) **\n",
+			filename, argv[1], argv[2], fs_type_name());
+		return 1;
+	}
+
+	/* Loading ok, update default load address */
+	load_addr = addr;
+
+	printf("%ld bytes read from %s (", size, fs_type_name());
+	print_rate(size, time, ")\n");
+	sprintf(buf, "%lX", size);
+	setenv("filesize", buf);
+
+	return 0;
+}
+
+U_BOOT_CMD(
+	load,	7,	0,	do_fs_load,
+	"load binary file from a filesystem",
+	"<interface> <dev[:part]> [addr] [filename] [bytes [pos]]\n"
+	"    - load binary file 'filename' from 'dev' on 'interface'\n"
+	"      to address 'addr' from any supported filesystem.\n"
+	"      'pos' gives the file position to start loading from.\n"
+	"      If 'bytes' is 0 or omitted, the file is read to its end.\n"
+	"load -d <interface> <dev[:part]> [addr] [filename]\n"
+	"    - decompress a legacy image or gzip file while reading it.\n"
+	"      Image data goes to its load address, preceded by a header\n"
+	"      for \"bootm\"; gzip files are decompressed to 'addr'."
+);
+
+int do_fs_ls (cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[])
+{
+	if (argc < 3 || argc > 4)
+		return cmd_usage(cmdtp);
+
+	if (fs_set_blk_dev(argv[1], argv[2], FS_TYPE_ANY))
+		return 1;
+
+	if (fs_ls(argc == 4 ? argv[3] : "/")) {
+		puts("** Can not list directory **\n");
+		return 1;
+	}
+
+	return 0;
+}
+
+/* The JFFS2 commands have an `ls' of their own */
+#ifndef CONFIG_CMD_JFFS2
+U_BOOT_CMD(
+	ls,	4,	1,	do_fs_ls,
+	"list files in a directory (default /)",
+	"<interface> <dev[:part]> [directory]\n"
+	"    - list files from 'dev' on 'interface' in a 'directory'"
+);
+#endif
+
+int do_fs_size (cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[])
+{
+	char buf[12];
+	long size;
+
+	if (argc != 4)
+		return cmd_usage(cmdtp);
+
+	if (fs_set_blk_dev(argv[1], argv[2], FS_TYPE_ANY))
+		return 1;
+
+	size = fs_size(argv[3]);
+	if (size < 0) {
+		printf("** File not found %s **\n", argv[3]);
+		return 1;
+	}
+
+	sprintf(buf, "%lX", size);
+	setenv("filesize", buf);
+
+	return 0;
+}
+
+U_BOOT_CMD(
+	size,	4,	0,	do_fs_size,
+	"determine a file's size",
+	"<interface> <dev[:part]> <filename>\n"
+	"    - find file 'filename' from 'dev' on 'interface'\n"
+	"      and set the 'filesize' environment variable to its size"
+);
@@ -24,6 +24,7 @@
 #include <common.h>
 #include <command.h>
 #include <mmc.h>
+#include <part.h>
 
 #ifndef CONFIG_GENERIC_MMC
 static int curr_device = -1;
@@ -176,6 +177,7 @@ int do_mmcops(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[])
 			u32 n;
 			u32 blk = simple_strtoul(argv[4], NULL, 16);
 			struct mmc *mmc = find_mmc_device(dev);
+			ulong start;
 
 			if (!mmc)
 				return 1;
@@ -185,13 +187,21 @@ int do_mmcops(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[])
 
 			mmc_init(mmc);
 
+			start = get_timer(0);
 			n = mmc->block_dev.block_read(dev, blk, cnt, addr);
+			start = get_timer(start);
 
 			/* flush cache after read */
 			flush_cache((ulong)addr, cnt * 512); /* FIXME */
 
-			printf("%d blocks read: %s\n",
+			printf("%d blocks read: %s",
 				n, (n==cnt) ? "OK" : "ERROR");
+			if (n) {
+				puts(" (");
+				print_rate((u64)n * mmc->read_bl_len, start,
+					")");
+			}
+			puts("\n");
 			return (n == cnt) ? 0 : 1;
 		} else if (strcmp(argv[1], "write") == 0) {
 			int dev = simple_strtoul(argv[2], NULL, 10);
@@ -199,6 +209,7 @@ int do_mmcops(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[])
 			u32 cnt = simple_strtoul(argv[5], NULL, 16);
 			u32 n;
 			struct mmc *mmc = find_mmc_device(dev);
+			ulong start;
 
 			int blk = simple_strtoul(argv[4], NULL, 16);
 
@@ -210,10 +221,50 @@ int do_mmcops(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[])
 
 			mmc_init(mmc);
 
-			n = mmc->block_dev.block_write(dev, blk, cnt, addr);
+			start = get_timer(0);
+			n = blk_dwrite(&mmc->block_dev, blk, cnt, addr);
+			start = get_timer(start);
 
-			printf("%d blocks written: %s\n",
+			printf("%d blocks written: %s",
 				n, (n == cnt) ? "OK" : "ERROR");
+			if (n) {
+				puts(" (");
+				print_rate((u64)n * mmc->write_bl_len, start,
+					")");
+			}
+			puts("\n");
+			return (n == cnt) ? 0 : 1;
+		} else if (strcmp(argv[1], "bench") == 0) {
+			int dev = simple_strtoul(argv[2], NULL, 10);
+			void *addr = (void *)simple_strtoul(argv[3], NULL, 16);
+			u32 blk = simple_strtoul(argv[4], NULL, 16);
+			u32 cnt = simple_strtoul(argv[5], NULL, 16);
+			struct mmc *mmc = find_mmc_device(dev);
+			ulong start;
+			u32 n;
+
+			if (!mmc)
+				return 1;
+
+			if (mmc_init(mmc)) {
+				puts("MMC init failed\n");
+				return 1;
+			}
+
+			printf("%s: %d-bit bus, %d Hz clock, %s\n", mmc->name,
+				mmc->bus_width, mmc->clock,
+				mmc->high_capacity ? "high capacity" :
+				"standard capacity");
+
+			start = get_timer(0);
+			n = mmc->block_dev.block_read(dev, blk, cnt, addr);
+			start = get_timer(start);
+
+			printf("read %d blocks (", n);
+			print_size((u64)n * mmc->read_bl_len, ") in ");
+			printf("%lu ms, ", start / (CONFIG_SYS_HZ / 1000));
+			print_rate((u64)n * mmc->read_bl_len, start, "\n");
+
 			return (n == cnt) ? 0 : 1;
 		} else {
 			printf("Usage:\n%s\n", cmdtp->usage);
@@ -229,6 +280,7 @@ U_BOOT_CMD(
 	"MMC sub system",
 	"read <device num> addr blk# cnt\n"
 	"mmc write <device num> addr blk# cnt\n"
+	"mmc bench <device num> addr blk# cnt - time a read of cnt blocks\n"
 	"mmc rescan <device num>\n"
 	"mmc list - lists available devices");
 #endif
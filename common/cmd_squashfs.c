@@ -0,0 +1,120 @@
+/*
+ * SquashFS commands for images in memory or NOR flash
+ *
+ * See file CREDITS for list of people who contributed to this
+ * project.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston,
+ * MA 02111-1307 USA
+ *
+ * Images on block devices are handled by the generic load/ls commands.
+ */
+
+#include <common.h>
+#include <command.h>
+#include <part.h>
+#include <squashfs.h>
+
+/* Mount the image at address 'sqfsaddr' */
+static int sqfs_mount_env (void)
+{
+	char *s = getenv("sqfsaddr");
+
+	if (s == NULL) {
+		puts("** sqfsaddr not set **\n");
+		return -1;
+	}
+	sqfs_set_mem(simple_strtoul(s, NULL, 16));
+	return sqfs_mount();
+}
+
+int do_sqfs_load (cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[])
+{
+	unsigned long addr = load_addr;
+	unsigned long count = 0;
+	unsigned long pos = 0;
+	char *filename;
+	char buf[12];
+	long size;
+
+	if (argc > 5)
+		return cmd_usage(cmdtp);
+
+	if (argc >= 2)
+		addr = simple_strtoul(argv[1], NULL, 16);
+	if (argc >= 3)
+		filename = argv[2];
+	else
+		filename = getenv("bootfile");
+	if (argc >= 4)
+		count = simple_strtoul(argv[3], NULL, 16);
+	if (argc >= 5)
+		pos = simple_strtoul(argv[4], NULL, 16);
+
+	if (!filename) {
+		puts("** No boot file defined **\n");
+		return 1;
+	}
+
+	if (sqfs_mount_env())
+		return 1;
+
+	size = sqfs_read(filename, (void *)addr, pos, count);
+	if (size < 0) {
+		printf("** Unable to read \"%s\" **\n", filename);
+		return 1;
+	}
+
+	load_addr = addr;
+
+	printf("%ld bytes read\n", size);
+	sprintf(buf, "%lX", size);
+	setenv("filesize", buf);
+
+	return 0;
+}
+
+U_BOOT_CMD(
+	sqfsload,	5,	0,	do_sqfs_load,
+	"load binary file from a SquashFS image",
+	"[addr] [filename] [bytes [pos]]\n"
+	"    - load binary file 'filename' from the image at 'sqfsaddr'\n"
+	"      to address 'addr'. 'pos' gives the file position to start\n"
+	"      loading from. If 'bytes' is 0 or omitted, the file is read\n"
+	"      to its end."
+);
+
+int do_sqfs_ls (cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[])
+{
+	if (argc > 2)
+		return cmd_usage(cmdtp);
+
+	if (sqfs_mount_env())
+		return 1;
+
+	if (sqfs_ls(argc == 2 ? argv[1] : "/")) {
+		puts("** Can not list directory **\n");
+		return 1;
+	}
+
+	return 0;
+}
+
+U_BOOT_CMD(
+	sqfsls,	2,	1,	do_sqfs_ls,
+	"list files in a SquashFS directory (default /)",
+	"[directory]\n"
+	"    - list files in a directory of the image at 'sqfsaddr'"
+);
@@ -41,6 +41,7 @@ int ubifs_init(void);
 int ubifs_mount(char *vol_name);
 int ubifs_ls(char *dir_name);
 int ubifs_load(char *filename, u32 addr, u32 size);
+void ubifs_print_info(void);
 
 int do_ubifs_mount(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[])
 {
@@ -124,6 +125,18 @@ int do_ubifs_load(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[])
 	return ret;
 }
 
+int do_ubifs_info(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[])
+{
+	if (!ubifs_mounted) {
+		printf("UBIFS not mounted, use ubifs mount to mount volume first!\n");
+		return -1;
+	}
+
+	ubifs_print_info();
+
+	return 0;
+}
+
 U_BOOT_CMD(
 	ubifsmount, 2, 0, do_ubifs_mount,
 	"mount UBIFS volume",
@@ -144,3 +157,12 @@ U_BOOT_CMD(
 	"<addr> <filename> [bytes]\n"
 	"    - load file 'filename' to address 'addr'"
 );
+
+U_BOOT_CMD(
+	ubifsinfo, 1, 0, do_ubifs_info,
+	"print UBIFS decompression statistics",
+	"\n"
+	"    - print the default compressor and, per compressor, the number\n"
+	"      of data nodes decompressed since mount and the time it took,\n"
+	"      and the number of nodes with an unknown or unsupported compressor"
+);
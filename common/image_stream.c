@@ -0,0 +1,308 @@
+/*
+ * Decompression of images fed in pieces
+ *
+ * See file CREDITS for list of people who contributed to this
+ * project.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston,
+ * MA 02111-1307 USA
+ */
+
+#include <common.h>
+#include <watchdog.h>
+#include <image.h>
+#include <malloc.h>
+#include <u-boot/zlib.h>
+#ifdef CONFIG_LZMA
+#include <lzma/LzmaTypes.h>
+#include <lzma/LzmaDec.h>
+#endif
+
+/* lib/gunzip.c */
+void *zalloc(void *, unsigned, unsigned);
+void zfree(void *, void *, unsigned);
+
+#ifdef CONFIG_GZIP
+static int gzip_stream_init (image_stream_t *s)
+{
+	z_stream *z;
+
+	z = malloc(sizeof(z_stream));
+	if (z == NULL)
+		return -1;
+
+	memset(z, 0, sizeof(z_stream));
+	z->zalloc = zalloc;
+	z->zfree = zfree;
+#if defined(CONFIG_HW_WATCHDOG) || defined(CONFIG_WATCHDOG)
+	z->outcb = (cb_func)WATCHDOG_RESET;
+#endif
+	if (inflateInit2(z, -MAX_WBITS) != Z_OK) {
+		free(z);
+		return -1;
+	}
+
+	s->priv = z;
+	return 0;
+}
+
+static int gzip_stream_write (image_stream_t *s, const uchar *buf, ulong len)
+{
+	z_stream *z = s->priv;
+	int i, r;
+
+	if (s->in_len == 0) {
+		i = gzip_header_len(buf, len);
+		if (i <= 0) {
+			puts ("Error: Bad gzipped data\n");
+			return -1;
+		}
+		buf += i;
+		len -= i;
+	}
+
+	z->next_in = (uchar *)buf;
+	z->avail_in = len;
+	z->next_out = s->dst + s->len;
+	z->avail_out = s->dstlen - s->len;
+	r = inflate(z, Z_NO_FLUSH);
+	s->len = z->next_out - s->dst;
+	if (r == Z_STREAM_END) {
+		/* The rest is the gzip trailer */
+		s->done = 1;
+		return 0;
+	}
+	if (r != Z_OK) {
+		printf ("Error: inflate() returned %d\n", r);
+		return -1;
+	}
+
+	return 0;
+}
+
+static void gzip_stream_free (image_stream_t *s)
+{
+	inflateEnd(s->priv);
+	free(s->priv);
+}
+#endif /* CONFIG_GZIP */
+
+#ifdef CONFIG_LZMA
+/* LZMA_Alone header: properties and the uncompressed size */
+#define LZMA_HEADER_SIZE	(LZMA_PROPS_SIZE + 8)
+
+struct lzma_stream {
+	CLzmaDec	dec;
+	ISzAlloc	alloc;
+	SizeT		limit;		/* output size */
+	int		known_size;	/* the header gave the output size */
+};
+
+static void *lzma_alloc (void *p, size_t size) { return malloc(size); }
+static void lzma_free (void *p, void *address) { free(address); }
+
+static int lzma_stream_init (image_stream_t *s)
+{
+	struct lzma_stream *ls;
+
+	ls = malloc(sizeof(struct lzma_stream));
+	if (ls == NULL)
+		return -1;
+
+	LzmaDec_Construct(&ls->dec);
+	ls->alloc.Alloc = lzma_alloc;
+	ls->alloc.Free = lzma_free;
+	s->priv = ls;
+	return 0;
+}
+
+static int lzma_stream_header (image_stream_t *s, const uchar *buf,
+			       ulong len)
+{
+	struct lzma_stream *ls = s->priv;
+	unsigned long long size = 0;
+	int i;
+
+	if (len < LZMA_HEADER_SIZE) {
+		puts ("LZMA: header incomplete\n");
+		return -1;
+	}
+
+	for (i = 7; i >= 0; i--)
+		size = (size << 8) | buf[LZMA_PROPS_SIZE + i];
+
+	ls->limit = s->dstlen;
+	ls->known_size = size != ~0ULL;
+	if (ls->known_size) {
+		if (size > s->dstlen) {
+			printf ("LZMA: image of %llu bytes does not fit\n",
+				size);
+			return -1;
+		}
+		ls->limit = size;
+	}
+
+	if (LzmaDec_AllocateProbs(&ls->dec, buf, LZMA_PROPS_SIZE,
+				  &ls->alloc) != SZ_OK) {
+		puts ("LZMA: out of memory\n");
+		return -1;
+	}
+
+	/* The output buffer is the dictionary */
+	ls->dec.dic = s->dst;
+	ls->dec.dicBufSize = ls->limit;
+	LzmaDec_Init(&ls->dec);
+	return 0;
+}
+
+static int lzma_stream_write (image_stream_t *s, const uchar *buf, ulong len)
+{
+	struct lzma_stream *ls = s->priv;
+	ELzmaStatus status;
+	SizeT in_len;
+	SRes res;
+
+	if (s->in_len == 0) {
+		if (lzma_stream_header(s, buf, len) != 0)
+			return -1;
+		buf += LZMA_HEADER_SIZE;
+		len -= LZMA_HEADER_SIZE;
+	}
+
+	in_len = len;
+	res = LzmaDec_DecodeToDic(&ls->dec, ls->limit, buf, &in_len,
+				  LZMA_FINISH_ANY, &status);
+	s->len = ls->dec.dicPos;
+	if (res != SZ_OK) {
+		printf ("LZMA: uncompress error %d\n", res);
+		return -1;
+	}
+
+	if (status == LZMA_STATUS_FINISHED_WITH_MARK ||
+	    (ls->known_size && s->len == ls->limit)) {
+		s->done = 1;
+	} else if (s->len == ls->limit) {
+		puts ("LZMA: output buffer too small\n");
+		return -1;
+	}
+
+	return 0;
+}
+
+static void lzma_stream_free (image_stream_t *s)
+{
+	struct lzma_stream *ls = s->priv;
+
+	LzmaDec_FreeProbs(&ls->dec, &ls->alloc);
+	free(ls);
+}
+#endif /* CONFIG_LZMA */
+
+/*
+ * Set up 's' to decompress data of type 'comp' (IH_COMP_NONE, IH_COMP_GZIP
+ * or, with CONFIG_LZMA, IH_COMP_LZMA) to at most 'dstlen' bytes at 'dst'.
+ * Return 0 on success; image_stream_end() has to be called then.
+ */
+int image_stream_init (image_stream_t *s, uint8_t comp, void *dst,
+		       ulong dstlen)
+{
+	memset(s, 0, sizeof(image_stream_t));
+	s->comp = comp;
+	s->dst = dst;
+	s->dstlen = dstlen;
+
+	switch (comp) {
+	case IH_COMP_NONE:
+		return 0;
+#ifdef CONFIG_GZIP
+	case IH_COMP_GZIP:
+		return gzip_stream_init(s);
+#endif
+#ifdef CONFIG_LZMA
+	case IH_COMP_LZMA:
+		return lzma_stream_init(s);
+#endif
+	default:
+		printf ("Compression type %d can not be streamed\n", comp);
+		return -1;
+	}
+}
+
+/*
+ * Decompress the next 'len' bytes of compressed data. Data after the end of
+ * the compressed stream is ignored. Return 0 on success.
+ */
+int image_stream_write (image_stream_t *s, const void *buf, ulong len)
+{
+	int ret = 0;
+
+	WATCHDOG_RESET();
+
+	if (s->done || len == 0)
+		return 0;
+
+	switch (s->comp) {
+	case IH_COMP_NONE:
+		if (len > s->dstlen - s->len) {
+			puts ("Error: image does not fit\n");
+			return -1;
+		}
+		memcpy(s->dst + s->len, buf, len);
+		s->len += len;
+		break;
+#ifdef CONFIG_GZIP
+	case IH_COMP_GZIP:
+		ret = gzip_stream_write(s, buf, len);
+		break;
+#endif
+#ifdef CONFIG_LZMA
+	case IH_COMP_LZMA:
+		ret = lzma_stream_write(s, buf, len);
+		break;
+#endif
+	}
+
+	s->in_len += len;
+	return ret;
+}
+
+/*
+ * Free the decompressor state. Return 0 if the end of the compressed data
+ * has been seen, so that s->len is the size of the decompressed image.
+ */
+int image_stream_end (image_stream_t *s)
+{
+	switch (s->comp) {
+	case IH_COMP_NONE:
+		return 0;
+#ifdef CONFIG_GZIP
+	case IH_COMP_GZIP:
+		gzip_stream_free(s);
+		break;
+#endif
+#ifdef CONFIG_LZMA
+	case IH_COMP_LZMA:
+		lzma_stream_free(s);
+		break;
+#endif
+	}
+
+	if (!s->done) {
+		puts ("Error: compressed data truncated\n");
+		return -1;
+	}
+
+	return 0;
+}
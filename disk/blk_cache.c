@@ -0,0 +1,455 @@
+/*
+ * Block device sector cache
+ *
+ * Keeps recently read small extents (partition tables, FAT sectors,
+ * ext2 superblock/group descriptors/inode tables, directory blocks) in
+ * memory so filesystems re-reading their metadata don't hit the device.
+ *
+ * With CONFIG_BLOCK_READAHEAD, sequential streams of small reads (file
+ * data walked cluster by cluster or block by block) are detected and
+ * served from a prefetch buffer filled by large multi-block reads.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston,
+ * MA 02111-1307 USA
+ */
+
+#include <common.h>
+#include <malloc.h>
+#include <part.h>
+#include <linux/list.h>
+
+#ifndef CONFIG_BLOCK_CACHE_ENTRIES
+#define CONFIG_BLOCK_CACHE_ENTRIES	32
+#endif
+
+#ifndef CONFIG_BLOCK_CACHE_BLOCKS
+#define CONFIG_BLOCK_CACHE_BLOCKS	8
+#endif
+
+#ifndef CONFIG_BLOCK_READAHEAD_MAX
+#define CONFIG_BLOCK_READAHEAD_MAX	128
+#endif
+
+#ifndef CONFIG_BLOCK_READAHEAD_STREAMS
+#define CONFIG_BLOCK_READAHEAD_STREAMS	2
+#endif
+
+/* Smallest readahead window, in blocks */
+#define BLK_RA_MIN_WINDOW		8
+
+/* Non-sequential reads an established stream survives before eviction */
+#define BLK_RA_MAX_MISSES		4
+
+struct blk_cache_entry {
+	struct list_head	link;
+	int			if_type;
+	int			dev;
+	lbaint_t		start;
+	lbaint_t		blkcnt;
+	unsigned long		blksz;
+	char			*buf;
+};
+
+/* Most recently used entries are kept at the head of the list */
+static struct list_head blk_cache;
+static unsigned int blk_cache_count;
+
+static struct blk_cache_stats blk_cache_stats = {
+	.max_entries	= CONFIG_BLOCK_CACHE_ENTRIES,
+	.max_blocks	= CONFIG_BLOCK_CACHE_BLOCKS,
+#ifdef CONFIG_BLOCK_READAHEAD
+	.ra_max		= CONFIG_BLOCK_READAHEAD_MAX,
+#endif
+};
+
+static void blk_cache_init(void)
+{
+	if (!blk_cache.next)
+		INIT_LIST_HEAD(&blk_cache);
+}
+
+#ifdef CONFIG_BLOCK_READAHEAD
+struct blk_ra_stream {
+	int			if_type;
+	int			dev;
+	unsigned long		blksz;
+	lbaint_t		next;		/* where a sequential read starts */
+	lbaint_t		win;		/* current window, in blocks */
+	lbaint_t		buf_start;	/* first block in buf */
+	lbaint_t		buf_cnt;	/* number of valid blocks in buf */
+	char			*buf;		/* ra_max blocks */
+	unsigned int		misses;		/* reads since the last hit */
+	unsigned int		age;
+};
+
+static struct blk_ra_stream blk_ra_streams[CONFIG_BLOCK_READAHEAD_STREAMS];
+static unsigned int blk_ra_clock;
+
+static void blk_ra_reset(struct blk_ra_stream *s)
+{
+	free(s->buf);
+	memset(s, 0, sizeof(*s));
+	s->if_type = IF_TYPE_UNKNOWN;
+}
+
+static struct blk_ra_stream *blk_ra_find(block_dev_desc_t *dev_desc,
+					lbaint_t start)
+{
+	struct blk_ra_stream *s;
+	int i;
+
+	for (i = 0; i < CONFIG_BLOCK_READAHEAD_STREAMS; i++) {
+		s = &blk_ra_streams[i];
+
+		if (!s->age || s->if_type != dev_desc->if_type ||
+		    s->dev != dev_desc->dev || s->blksz != dev_desc->blksz)
+			continue;
+
+		if (start == s->next || (start >= s->buf_start &&
+		    start < s->buf_start + s->buf_cnt))
+			return s;
+	}
+
+	return NULL;
+}
+
+/*
+ * Start tracking a new potential stream in the least recently used slot
+ * that is free or not yet sequential. A read that continues no stream
+ * counts as a miss for every established stream; those are only replaced
+ * after BLK_RA_MAX_MISSES misses in a row, so interleaved streams and
+ * stray metadata reads don't reset each other.
+ */
+static void blk_ra_track(block_dev_desc_t *dev_desc, lbaint_t next)
+{
+	struct blk_ra_stream *s = NULL, *t;
+	int i;
+
+	for (i = 0; i < CONFIG_BLOCK_READAHEAD_STREAMS; i++) {
+		t = &blk_ra_streams[i];
+
+		if (t->win && ++t->misses <= BLK_RA_MAX_MISSES)
+			continue;
+
+		if (!s || t->age < s->age)
+			s = t;
+	}
+
+	if (!s)
+		return;
+
+	if (s->blksz != dev_desc->blksz) {
+		blk_ra_reset(s);
+		s->blksz = dev_desc->blksz;
+	}
+
+	s->if_type = dev_desc->if_type;
+	s->dev = dev_desc->dev;
+	s->next = next;
+	s->win = 0;
+	s->buf_cnt = 0;
+	s->misses = 0;
+	s->age = ++blk_ra_clock;
+}
+
+/*
+ * Serve a read that continues a known sequential stream, refilling the
+ * prefetch buffer with a window that doubles on each refill. Returns
+ * the number of blocks read or -1 if the read isn't sequential.
+ */
+static long blk_ra_read(block_dev_desc_t *dev_desc, lbaint_t start,
+			lbaint_t blkcnt, void *buffer)
+{
+	unsigned long blksz = dev_desc->blksz;
+	struct blk_ra_stream *s;
+	lbaint_t done = 0, cur, cnt, off;
+	char *dst = buffer;
+	ulong n;
+
+	if (!blk_cache_stats.ra_max)
+		return -1;
+
+	s = blk_ra_find(dev_desc, start);
+	if (!s) {
+		blk_ra_track(dev_desc, start + blkcnt);
+		return -1;
+	}
+
+	s->age = ++blk_ra_clock;
+	s->misses = 0;
+
+	while (done < blkcnt) {
+		cur = start + done;
+
+		if (s->buf_cnt && cur >= s->buf_start &&
+		    cur < s->buf_start + s->buf_cnt) {
+			off = cur - s->buf_start;
+			cnt = min(blkcnt - done, s->buf_cnt - off);
+			memcpy(dst + done * blksz, s->buf + off * blksz,
+				cnt * blksz);
+			blk_cache_stats.ra_hits++;
+			done += cnt;
+			continue;
+		}
+
+		/* Grow the window on every refill */
+		if (s->win)
+			s->win = min(s->win * 2, (lbaint_t)blk_cache_stats.ra_max);
+		else
+			s->win = min((lbaint_t)BLK_RA_MIN_WINDOW,
+					(lbaint_t)blk_cache_stats.ra_max);
+
+		cnt = s->win;
+		if (dev_desc->lba && cur + cnt > dev_desc->lba)
+			cnt = dev_desc->lba > cur ? dev_desc->lba - cur : 0;
+
+		if (!s->buf)
+			s->buf = malloc(blk_cache_stats.ra_max * blksz);
+
+		/* Reads as large as the window gain nothing from buffering */
+		if (!s->buf || cnt <= blkcnt - done) {
+			n = dev_desc->block_read(dev_desc->dev, cur,
+					blkcnt - done, dst + done * blksz);
+			s->buf_cnt = 0;
+			done += n;
+			break;
+		}
+
+		n = dev_desc->block_read(dev_desc->dev, cur, cnt, s->buf);
+		blk_cache_stats.ra_reads++;
+
+		s->buf_start = cur;
+		s->buf_cnt = n;
+
+		if (!n)
+			break;
+	}
+
+	s->next = start + done;
+
+	return done;
+}
+
+/* Forget the prefetched blocks of a device, or of all devices */
+static void blk_ra_invalidate(int if_type, int dev)
+{
+	int i;
+
+	for (i = 0; i < CONFIG_BLOCK_READAHEAD_STREAMS; i++) {
+		if (if_type == IF_TYPE_UNKNOWN ||
+		    (blk_ra_streams[i].if_type == if_type &&
+		     blk_ra_streams[i].dev == dev))
+			blk_ra_reset(&blk_ra_streams[i]);
+	}
+}
+
+void blk_readahead_configure(unsigned int blocks)
+{
+	blk_ra_invalidate(IF_TYPE_UNKNOWN, 0);
+	blk_cache_stats.ra_max = blocks;
+}
+#else
+static inline long blk_ra_read(block_dev_desc_t *dev_desc, lbaint_t start,
+				lbaint_t blkcnt, void *buffer)
+{
+	return -1;
+}
+
+static inline void blk_ra_invalidate(int if_type, int dev) {}
+#endif
+
+static void blk_cache_drop(struct blk_cache_entry *e)
+{
+	list_del(&e->link);
+	free(e->buf);
+	free(e);
+	blk_cache_count--;
+}
+
+static struct blk_cache_entry *blk_cache_find(block_dev_desc_t *dev_desc,
+					lbaint_t start, lbaint_t blkcnt)
+{
+	struct blk_cache_entry *e;
+	struct list_head *entry;
+
+	list_for_each(entry, &blk_cache) {
+		e = list_entry(entry, struct blk_cache_entry, link);
+
+		if (e->if_type != dev_desc->if_type || e->dev != dev_desc->dev)
+			continue;
+
+		if (e->blksz != dev_desc->blksz)
+			continue;
+
+		if (start >= e->start && start + blkcnt <= e->start + e->blkcnt) {
+			/* Move to the head of the LRU list */
+			list_del(&e->link);
+			list_add(&e->link, &blk_cache);
+			return e;
+		}
+	}
+
+	return NULL;
+}
+
+static void blk_cache_fill(block_dev_desc_t *dev_desc, lbaint_t start,
+				lbaint_t blkcnt, const void *buffer)
+{
+	struct blk_cache_entry *e;
+
+	if (!blk_cache_stats.max_entries)
+		return;
+
+	/* Recycle the least recently used entry when full */
+	if (blk_cache_count >= blk_cache_stats.max_entries)
+		blk_cache_drop(list_entry(blk_cache.prev,
+				struct blk_cache_entry, link));
+
+	e = malloc(sizeof(*e));
+	if (!e)
+		return;
+
+	e->buf = malloc(blkcnt * dev_desc->blksz);
+	if (!e->buf) {
+		free(e);
+		return;
+	}
+
+	e->if_type = dev_desc->if_type;
+	e->dev = dev_desc->dev;
+	e->start = start;
+	e->blkcnt = blkcnt;
+	e->blksz = dev_desc->blksz;
+	memcpy(e->buf, buffer, blkcnt * dev_desc->blksz);
+
+	list_add(&e->link, &blk_cache);
+	blk_cache_count++;
+}
+
+/* Drop every cached block of dev_desc overlapping [start, start + blkcnt) */
+static void blk_cache_invalidate_range(block_dev_desc_t *dev_desc,
+				lbaint_t start, lbaint_t blkcnt)
+{
+	struct blk_cache_entry *e;
+	struct list_head *entry, *n;
+
+	list_for_each_safe(entry, n, &blk_cache) {
+		e = list_entry(entry, struct blk_cache_entry, link);
+
+		if (e->if_type != dev_desc->if_type || e->dev != dev_desc->dev)
+			continue;
+
+		if (start < e->start + e->blkcnt && e->start < start + blkcnt)
+			blk_cache_drop(e);
+	}
+}
+
+ulong blk_dread(block_dev_desc_t *dev_desc, lbaint_t start,
+		lbaint_t blkcnt, void *buffer)
+{
+	struct blk_cache_entry *e;
+	long ra;
+	ulong n;
+
+	if (!dev_desc->block_read)
+		return 0;
+
+	blk_cache_init();
+
+	/* Sequential (file data) reads are served by readahead */
+	ra = blk_ra_read(dev_desc, start, blkcnt, buffer);
+	if (ra >= 0)
+		return ra;
+
+	/* Large (data) reads go straight to the device */
+	if (blkcnt > blk_cache_stats.max_blocks)
+		return dev_desc->block_read(dev_desc->dev, start, blkcnt,
+						buffer);
+
+	e = blk_cache_find(dev_desc, start, blkcnt);
+	if (e) {
+		memcpy(buffer, e->buf + (start - e->start) * e->blksz,
+			blkcnt * e->blksz);
+		blk_cache_stats.hits++;
+		return blkcnt;
+	}
+
+	blk_cache_stats.misses++;
+
+	n = dev_desc->block_read(dev_desc->dev, start, blkcnt, buffer);
+	if (n == blkcnt)
+		blk_cache_fill(dev_desc, start, blkcnt, buffer);
+
+	return n;
+}
+
+ulong blk_dwrite(block_dev_desc_t *dev_desc, lbaint_t start,
+		lbaint_t blkcnt, const void *buffer)
+{
+	ulong n;
+
+	if (!dev_desc->block_write)
+		return 0;
+
+	blk_cache_init();
+	blk_cache_invalidate_range(dev_desc, start, blkcnt);
+	blk_ra_invalidate(dev_desc->if_type, dev_desc->dev);
+
+	n = dev_desc->block_write(dev_desc->dev, start, blkcnt, buffer);
+
+	/* Even a failed write may have changed some blocks */
+	blk_media_changed(dev_desc);
+
+	return n;
+}
+
+void blk_cache_invalidate(int if_type, int dev)
+{
+	struct blk_cache_entry *e;
+	struct list_head *entry, *n;
+
+	blk_cache_init();
+	blk_ra_invalidate(if_type, dev);
+
+	list_for_each_safe(entry, n, &blk_cache) {
+		e = list_entry(entry, struct blk_cache_entry, link);
+
+		if (if_type == IF_TYPE_UNKNOWN ||
+		    (e->if_type == if_type && e->dev == dev))
+			blk_cache_drop(e);
+	}
+}
+
+void blk_cache_configure(unsigned int blocks, unsigned int entries)
+{
+	blk_cache_invalidate(IF_TYPE_UNKNOWN, 0);
+
+	blk_cache_stats.max_blocks = blocks;
+	blk_cache_stats.max_entries = entries;
+}
+
+void blk_cache_get_stats(struct blk_cache_stats *stats)
+{
+	*stats = blk_cache_stats;
+	stats->entries = blk_cache_count;
+}
+
+void blk_cache_reset_stats(void)
+{
+	blk_cache_stats.hits = 0;
+	blk_cache_stats.misses = 0;
+	blk_cache_stats.ra_hits = 0;
+	blk_cache_stats.ra_reads = 0;
+}
@@ -241,6 +241,18 @@ void dev_print (block_dev_desc_t *dev_desc)
      defined(CONFIG_MMC)		|| \
      defined(CONFIG_SYSTEMACE) )
 
+/*
+ * Every (re)scan of a device and every write to it gets a new media
+ * generation, so cached filesystem state can tell a re-inserted,
+ * re-initialized or rewritten card apart.
+ */
+static unsigned long media_gen;
+
+void blk_media_changed (block_dev_desc_t *dev_desc)
+{
+	dev_desc->media_gen = ++media_gen;
+}
+
 #if defined(CONFIG_MAC_PARTITION) || \
     defined(CONFIG_DOS_PARTITION) || \
     defined(CONFIG_ISO_PARTITION) || \
@@ -249,6 +261,9 @@ void dev_print (block_dev_desc_t *dev_desc)
 
 void init_part (block_dev_desc_t * dev_desc)
 {
+	blk_media_changed(dev_desc);
+	blk_cache_invalidate(dev_desc->if_type, dev_desc->dev);
+
 #ifdef CONFIG_ISO_PARTITION
 	if (test_part_iso(dev_desc) == 0) {
 		dev_desc->part_type = PART_TYPE_ISO;
@@ -89,7 +89,7 @@ int test_part_dos (block_dev_desc_t *dev_desc)
 {
 	unsigned char buffer[DEFAULT_SECTOR_SIZE];
 
-	if ((dev_desc->block_read(dev_desc->dev, 0, 1, (ulong *) buffer) != 1) ||
+	if ((blk_dread(dev_desc, 0, 1, (ulong *) buffer) != 1) ||
 	    (buffer[DOS_PART_MAGIC_OFFSET + 0] != 0x55) ||
 	    (buffer[DOS_PART_MAGIC_OFFSET + 1] != 0xaa) ) {
 		return (-1);
@@ -106,7 +106,7 @@ static void print_partition_extended (block_dev_desc_t *dev_desc, int ext_part_s
 	dos_partition_t *pt;
 	int i;
 
-	if (dev_desc->block_read(dev_desc->dev, ext_part_sector, 1, (ulong *) buffer) != 1) {
+	if (blk_dread(dev_desc, ext_part_sector, 1, (ulong *) buffer) != 1) {
 		printf ("** Can't read partition table on %d:%d **\n",
 			dev_desc->dev, ext_part_sector);
 		return;
@@ -170,7 +170,7 @@ static int get_partition_info_extended (block_dev_desc_t *dev_desc, int ext_part
 	dos_partition_t *pt;
 	int i;
 
-	if (dev_desc->block_read (dev_desc->dev, ext_part_sector, 1, (ulong *) buffer) != 1) {
+	if (blk_dread(dev_desc, ext_part_sector, 1, (ulong *) buffer) != 1) {
 		printf ("** Can't read partition table on %d:%d **\n",
 			dev_desc->dev, ext_part_sector);
 		return -1;
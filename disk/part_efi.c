@@ -188,7 +188,7 @@ int test_part_efi(block_dev_desc_t * dev_desc)
 	legacy_mbr legacymbr;
 
 	/* Read legacy MBR from block 0 and validate it */
-	if ((dev_desc->block_read(dev_desc->dev, 0, 1, (ulong *) & legacymbr) != 1)
+	if ((blk_dread(dev_desc, 0, 1, (ulong *) & legacymbr) != 1)
 		|| (is_pmbr_valid(&legacymbr) != 1)) {
 		return -1;
 	}
@@ -260,7 +260,7 @@ static int is_gpt_valid(block_dev_desc_t * dev_desc, unsigned long long lba,
 	}
 
 	/* Read GPT Header from device */
-	if (dev_desc->block_read(dev_desc->dev, lba, 1, pgpt_head) != 1) {
+	if (blk_dread(dev_desc, lba, 1, pgpt_head) != 1) {
 		printf("*** ERROR: Can't read GPT header ***\n");
 		return 0;
 	}
@@ -382,8 +382,7 @@ static gpt_entry *alloc_read_gpt_entries(block_dev_desc_t * dev_desc,
 	}
 
 	/* Read GPT Entries from device */
-	if (dev_desc->block_read (dev_desc->dev,
-		(unsigned long)le64_to_int(pgpt_head->partition_entry_lba),
+	if (blk_dread(dev_desc, (unsigned long)le64_to_int(pgpt_head->partition_entry_lba),
 		(lbaint_t) (count / GPT_BLOCK_SIZE), pte)
 		!= (count / GPT_BLOCK_SIZE)) {
 
@@ -0,0 +1,156 @@
+/*
+ * PXA2xx/PXA3xx descriptor-based DMA controller
+ *
+ * Copyright (C) 2010 Marek Vasut <marek.vasut@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston,
+ * MA 02111-1307 USA
+ */
+
+#include <config.h>
+#include <common.h>
+#include <asm/errno.h>
+#include <asm/arch/hardware.h>
+#include <asm/arch/pxa-dma.h>
+
+/* Channels handed out by pxa_dma_request() */
+static u32 pxa_dma_busy;
+
+int pxa_dma_request(void)
+{
+	int chan;
+
+	for (chan = 0; chan < PXA_DMA_CHANNELS; chan++) {
+		if (pxa_dma_busy & (1 << chan))
+			continue;
+
+		pxa_dma_busy |= 1 << chan;
+		DCSR(chan) = DCSR_ENDINTR | DCSR_STARTINTR | DCSR_BUSERR;
+		return chan;
+	}
+
+	return -EBUSY;
+}
+
+void pxa_dma_free(int chan)
+{
+	if (chan < 0 || chan >= PXA_DMA_CHANNELS)
+		return;
+
+	pxa_dma_stop(chan);
+	pxa_dma_busy &= ~(1 << chan);
+}
+
+/*
+ * Fill in a descriptor chain moving len bytes from src to dst. The
+ * source or target address is advanced per descriptor depending on
+ * DCMD_INCSRCADDR/DCMD_INCTRGADDR in dcmd. Returns the number of
+ * descriptors used or -ENOMEM if the chain does not fit into ndesc.
+ */
+int pxa_dma_prep(struct pxa_dma_desc *desc, int ndesc,
+			u32 src, u32 dst, u32 len, u32 dcmd)
+{
+	u32 chunk;
+	int i = 0;
+
+	while (len) {
+		if (i >= ndesc)
+			return -ENOMEM;
+
+		chunk = min(len, (u32)PXA_DMA_DESC_MAXLEN);
+
+		desc[i].ddadr = (u32)&desc[i + 1];
+		desc[i].dsadr = src;
+		desc[i].dtadr = dst;
+		desc[i].dcmd = dcmd | chunk;
+
+		if (dcmd & DCMD_INCSRCADDR)
+			src += chunk;
+		if (dcmd & DCMD_INCTRGADDR)
+			dst += chunk;
+
+		len -= chunk;
+		i++;
+	}
+
+	if (i)
+		desc[i - 1].ddadr = DDADR_STOP;
+
+	return i;
+}
+
+void pxa_dma_start(int chan, struct pxa_dma_desc *desc)
+{
+	/* Make sure the channel is idle and in descriptor mode */
+	pxa_dma_stop(chan);
+
+	/* Unaligned buffers need the channel's alignment bit set */
+	if (desc->dsadr & 0x7 || desc->dtadr & 0x7)
+		DALGN |= 1 << chan;
+	else
+		DALGN &= ~(1 << chan);
+
+	DDADR(chan) = (u32)desc;
+	DCSR(chan) = DCSR_RUN;
+}
+
+/*
+ * Check whether the channel ran through the whole descriptor chain.
+ * Returns 1 when done, 0 while still running and -EIO on a bus error.
+ */
+int pxa_dma_done(int chan)
+{
+	u32 dcsr = DCSR(chan);
+
+	if (dcsr & DCSR_BUSERR) {
+		pxa_dma_stop(chan);
+		return -EIO;
+	}
+
+	if (!(dcsr & DCSR_STOPSTATE))
+		return 0;
+
+	/* Clear the sticky status bits */
+	DCSR(chan) = DCSR_ENDINTR | DCSR_STARTINTR | DCSR_BUSERR;
+
+	return 1;
+}
+
+/* Wait for the channel to finish, the timeout is in microseconds */
+int pxa_dma_wait(int chan, ulong timeout)
+{
+	int ret;
+
+	while (!(ret = pxa_dma_done(chan))) {
+		if (!timeout--) {
+			pxa_dma_stop(chan);
+			return -ETIMEDOUT;
+		}
+
+		udelay(1);
+	}
+
+	return ret < 0 ? ret : 0;
+}
+
+void pxa_dma_stop(int chan)
+{
+	int timeout = 1000;
+
+	DCSR(chan) &= ~DCSR_RUN;
+
+	while (!(DCSR(chan) & DCSR_STOPSTATE) && --timeout)
+		udelay(1);
+}
@@ -77,61 +77,149 @@ struct mmc *find_mmc_device(int dev_num)
 	return NULL;
 }
 
-static ulong
-mmc_bwrite(int dev_num, ulong start, lbaint_t blkcnt, const void*src)
+static int mmc_send_status(struct mmc *mmc, int timeout)
 {
 	struct mmc_cmd cmd;
-	struct mmc_data data;
 	int err;
-	int stoperr = 0;
-	struct mmc *mmc = find_mmc_device(dev_num);
-	int blklen;
 
-	if (!mmc)
-		return -1;
+	cmd.cmdidx = MMC_CMD_SEND_STATUS;
+	cmd.resp_type = MMC_RSP_R1;
+	cmd.cmdarg = mmc->rca << 16;
+	cmd.flags = 0;
 
-	blklen = mmc->write_bl_len;
+	do {
+		err = mmc_send_cmd(mmc, &cmd, NULL);
 
-	err = mmc_set_blocklen(mmc, mmc->write_bl_len);
+		if (err)
+			return err;
 
-	if (err) {
-		printf("set write bl len failed\n\r");
-		return err;
-	}
+		/* Card is done programming once it's back in transfer state */
+		if ((cmd.response[0] & MMC_STATUS_RDY_FOR_DATA) &&
+		    (cmd.response[0] & MMC_STATUS_CURR_STATE) != MMC_STATE_PRG)
+			return 0;
+
+		udelay(1000);
+	} while (timeout--);
+
+	printf("Timeout waiting for card to finish programming\n");
+
+	return TIMEOUT;
+}
+
+/*
+ * Tell an SD card how many blocks the following WRITE_MULTIPLE_BLOCK is
+ * going to write, so it can pre-erase them. This is only a hint, hence
+ * failures are ignored.
+ */
+static void mmc_set_wr_blk_erase_count(struct mmc *mmc, lbaint_t blkcnt)
+{
+	struct mmc_cmd cmd;
+
+	if (!IS_SD(mmc))
+		return;
 
-	if (blkcnt > 1)
+	cmd.cmdidx = MMC_CMD_APP_CMD;
+	cmd.resp_type = MMC_RSP_R1;
+	cmd.cmdarg = mmc->rca << 16;
+	cmd.flags = 0;
+
+	if (mmc_send_cmd(mmc, &cmd, NULL))
+		return;
+
+	cmd.cmdidx = SD_CMD_APP_SET_WR_BLK_ERASE_COUNT;
+	cmd.resp_type = MMC_RSP_R1;
+	cmd.cmdarg = blkcnt & 0x7fffff;
+	cmd.flags = 0;
+
+	mmc_send_cmd(mmc, &cmd, NULL);
+}
+
+/*
+ * Write up to mmc->b_max blocks with a single write command and wait for
+ * the card to finish programming them. Returns the number of blocks
+ * written.
+ */
+static int mmc_write_blocks(struct mmc *mmc, const void *src, ulong start,
+				lbaint_t blkcnt)
+{
+	struct mmc_cmd cmd;
+	struct mmc_data data;
+	int err;
+
+	if (blkcnt > 1) {
+		mmc_set_wr_blk_erase_count(mmc, blkcnt);
 		cmd.cmdidx = MMC_CMD_WRITE_MULTIPLE_BLOCK;
-	else
+	} else
 		cmd.cmdidx = MMC_CMD_WRITE_SINGLE_BLOCK;
 
 	if (mmc->high_capacity)
 		cmd.cmdarg = start;
 	else
-		cmd.cmdarg = start * blklen;
+		cmd.cmdarg = start * mmc->write_bl_len;
 
 	cmd.resp_type = MMC_RSP_R1;
 	cmd.flags = 0;
 
 	data.src = src;
 	data.blocks = blkcnt;
-	data.blocksize = blklen;
+	data.blocksize = mmc->write_bl_len;
 	data.flags = MMC_DATA_WRITE;
 
 	err = mmc_send_cmd(mmc, &cmd, &data);
 
-	if (err) {
-		printf("mmc write failed\n\r");
-		return err;
-	}
+	if (err)
+		printf("mmc write failed\n");
 
 	if (blkcnt > 1) {
 		cmd.cmdidx = MMC_CMD_STOP_TRANSMISSION;
 		cmd.cmdarg = 0;
 		cmd.resp_type = MMC_RSP_R1b;
 		cmd.flags = 0;
-		stoperr = mmc_send_cmd(mmc, &cmd, NULL);
+
+		if (mmc_send_cmd(mmc, &cmd, NULL)) {
+			printf("mmc fail to send stop cmd\n");
+			return 0;
+		}
+	}
+
+	/* Only now wait for the whole batch to be programmed */
+	if (mmc_send_status(mmc, MMC_WRITE_TIMEOUT))
+		return 0;
+
+	return err ? 0 : blkcnt;
+}
+
+static ulong
+mmc_bwrite(int dev_num, ulong start, lbaint_t blkcnt, const void *src)
+{
+	int err;
+	lbaint_t cur, blocks_todo = blkcnt;
+	struct mmc *mmc = find_mmc_device(dev_num);
+
+	if (!mmc)
+		return 0;
+
+	if (!blkcnt)
+		return 0;
+
+	err = mmc_set_blocklen(mmc, mmc->write_bl_len);
+
+	if (err) {
+		printf("set write bl len failed\n\r");
+		return 0;
 	}
 
+	do {
+		cur = min(blocks_todo, (lbaint_t)mmc->b_max);
+
+		if (mmc_write_blocks(mmc, src, start, cur) != cur)
+			return blkcnt - blocks_todo;
+
+		blocks_todo -= cur;
+		start += cur;
+		src = (const char *)src + cur * mmc->write_bl_len;
+	} while (blocks_todo > 0);
+
 	return blkcnt;
 }
 
@@ -158,6 +246,51 @@ int mmc_read_block(struct mmc *mmc, void *dst, uint blocknum)
 	return mmc_send_cmd(mmc, &cmd, &data);
 }
 
+/*
+ * Read up to mmc->b_max blocks with a single READ_MULTIPLE_BLOCK command,
+ * terminated by STOP_TRANSMISSION. Returns the number of blocks read.
+ */
+static int mmc_read_blocks(struct mmc *mmc, void *dst, ulong start,
+				lbaint_t blkcnt)
+{
+	struct mmc_cmd cmd;
+	struct mmc_data data;
+	int err;
+
+	if (blkcnt == 1)
+		return mmc_read_block(mmc, dst, start) ? 0 : 1;
+
+	cmd.cmdidx = MMC_CMD_READ_MULTIPLE_BLOCK;
+
+	if (mmc->high_capacity)
+		cmd.cmdarg = start;
+	else
+		cmd.cmdarg = start * mmc->read_bl_len;
+
+	cmd.resp_type = MMC_RSP_R1;
+	cmd.flags = 0;
+
+	data.dest = dst;
+	data.blocks = blkcnt;
+	data.blocksize = mmc->read_bl_len;
+	data.flags = MMC_DATA_READ;
+
+	err = mmc_send_cmd(mmc, &cmd, &data);
+
+	/* The card stays in data state until stopped, even on errors */
+	cmd.cmdidx = MMC_CMD_STOP_TRANSMISSION;
+	cmd.cmdarg = 0;
+	cmd.resp_type = MMC_RSP_R1b;
+	cmd.flags = 0;
+
+	if (mmc_send_cmd(mmc, &cmd, NULL)) {
+		printf("mmc fail to send stop cmd\n");
+		return 0;
+	}
+
+	return err ? 0 : blkcnt;
+}
+
 int mmc_read(struct mmc *mmc, u64 src, uchar *dst, int size)
 {
 	char *buffer;
@@ -213,12 +346,15 @@ free_buffer:
 static ulong mmc_bread(int dev_num, ulong start, lbaint_t blkcnt, void *dst)
 {
 	int err;
-	int i;
+	lbaint_t cur, blocks_todo = blkcnt;
 	struct mmc *mmc = find_mmc_device(dev_num);
 
 	if (!mmc)
 		return 0;
 
+	if (!blkcnt)
+		return 0;
+
 	/* We always do full block reads from the card */
 	err = mmc_set_blocklen(mmc, mmc->read_bl_len);
 
@@ -226,14 +362,18 @@ static ulong mmc_bread(int dev_num, ulong start, lbaint_t blkcnt, void *dst)
 		return 0;
 	}
 
-	for (i = start; i < start + blkcnt; i++, dst += mmc->read_bl_len) {
-		err = mmc_read_block(mmc, dst, i);
+	do {
+		cur = min(blocks_todo, (lbaint_t)mmc->b_max);
 
-		if (err) {
-			printf("block read failed: %d\n", err);
-			return i - start;
+		if (mmc_read_blocks(mmc, dst, start, cur) != cur) {
+			printf("block read failed at %lu\n", start);
+			return blkcnt - blocks_todo;
 		}
-	}
+
+		blocks_todo -= cur;
+		start += cur;
+		dst += cur * mmc->read_bl_len;
+	} while (blocks_todo > 0);
 
 	return blkcnt;
 }
@@ -520,6 +660,10 @@ retry_scr:
 			break;
 	}
 
+	/* Every SD version may support the 4-bit bus */
+	if (mmc->scr[0] & SD_DATA_4BIT)
+		mmc->card_caps |= MMC_MODE_4BIT;
+
 	/* Version 1.0 doesn't support switching */
 	if (mmc->version == SD_VERSION_1_0)
 		return 0;
@@ -537,9 +681,6 @@ retry_scr:
 			break;
 	}
 
-	if (mmc->scr[0] & SD_DATA_4BIT)
-		mmc->card_caps |= MMC_MODE_4BIT;
-
 	/* If high-speed isn't supported, we return */
 	if (!(__be32_to_cpu(switch_status[3]) & SD_HIGHSPEED_SUPPORTED))
 		return 0;
@@ -851,6 +992,10 @@ int mmc_register(struct mmc *mmc)
 	mmc->block_dev.block_read = mmc_bread;
 	mmc->block_dev.block_write = mmc_bwrite;
 
+	/* Hosts that don't know their transfer limit get the default */
+	if (!mmc->b_max)
+		mmc->b_max = CONFIG_SYS_MMC_MAX_BLK_COUNT;
+
 	INIT_LIST_HEAD (&mmc->link);
 
 	list_add_tail (&mmc->link, &mmc_devices);
@@ -874,6 +1019,9 @@ int mmc_init(struct mmc *mmc)
 	if (err)
 		return err;
 
+	/* The card may have been swapped, forget what we cached from it */
+	blk_cache_invalidate(IF_TYPE_MMC, mmc->block_dev.dev);
+
 	mmc_set_bus_width(mmc, 1);
 	mmc_set_clock(mmc, 1);
 
@@ -491,7 +491,7 @@ static int mxcmci_initialize(bd_t *bis)
 {
 	struct mmc *mmc = NULL;
 
-	mmc = malloc(sizeof(struct mmc));
+	mmc = calloc(1, sizeof(struct mmc));
 
 	if (!mmc)
 		return -ENOMEM;
@@ -75,6 +75,9 @@
 /* MMC_RDTO */
 #define MMC_READ_TO_MAX			(0x0ffffUL) /* [15:0] */
 
+/* MMC_NOB */
+#define MMC_NOB_MAX			(0x0ffffUL) /* [15:0] */
+
 /* MMC_BLKLEN */
 #define MMC_BLK_LEN_MAX			(0x03ffUL) /* [9:0] */
 
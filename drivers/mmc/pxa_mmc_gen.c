@@ -26,12 +26,25 @@
 #include <mmc.h>
 #include <asm/errno.h>
 #include <asm/arch/hardware.h>
+#ifdef	CONFIG_PXA_DMA
+#include <asm/arch/pxa-dma.h>
+#endif
 
 #include "pxa_mmc.h"
 
 /* 1000uS (in wait cycles below it's 100 x 10uS waits) */
 #define	PXA_MMC_TIMEOUT	100
 
+#ifdef	CONFIG_PXA_DMA
+/* Descriptor chain for the data phase, limits the size of one request */
+#define	PXAMMC_DMA_DESCS	256
+/* 2s (in 1uS DMA status polls) for one data phase, a card may stall writes */
+#define	PXAMMC_DMA_TIMEOUT	2000000
+
+static struct pxa_dma_desc pxa_mmc_desc[PXAMMC_DMA_DESCS];
+static int pxa_mmc_dma = -1;
+#endif
+
 static int pxa_mmc_wait(int mask)
 {
 	int timeout = PXA_MMC_TIMEOUT;
@@ -75,7 +88,7 @@ static int pxa_mmc_start_cmd(struct mmc_cmd *cmd, unsigned long cmdat)
 	int ret;
 
 	/* The card can send a "busy" response */
-	if (cmd->flags & MMC_RSP_BUSY)
+	if (cmd->resp_type & MMC_RSP_BUSY)
 		cmdat |= MMC_CMDAT_BUSY;
 
 	/* Inform the controller about response type */
@@ -161,11 +174,16 @@ static int pxa_mmc_do_read_xfer(struct mmc_data *data)
 		/* The controller has data ready */
 		if (MMC_I_REG & MMC_I_REG_RXFIFO_RD_REQ) {
 			i = min(len, PXAMMC_FIFO_SIZE);
+			len -= i;
 
-			while (i--) {
-				*data->dest++ = *((volatile uchar *)&MMC_RXFIFO);
-				len--;
+			/* Drain the FIFO a word at a time if we can */
+			if (!((ulong)data->dest & 3)) {
+				for (; i >= 4; i -= 4, data->dest += 4)
+					*(u32 *)data->dest = MMC_RXFIFO;
 			}
+
+			while (i--)
+				*data->dest++ = *((volatile uchar *)&MMC_RXFIFO);
 		}
 
 		if (MMC_STAT & MMC_STAT_ERRORS)
@@ -206,23 +224,107 @@ static int pxa_mmc_do_write_xfer(struct mmc_data *data)
 			return -EIO;
 	}
 
-	/* Wait for the transmission-done interrupt */
+	/*
+	 * Wait for the transmission-done interrupt. The card may still be
+	 * programming, the MMC core polls its status once per batch.
+	 */
 	ret = pxa_mmc_wait(MMC_STAT_DATA_TRAN_DONE);
 	if (ret)
 		return ret;
 
-	/* Wait until the data are really written to the card */
-	ret = pxa_mmc_wait(MMC_STAT_PRG_DONE);
-	if (ret)
+	return 0;
+}
+
+#ifdef	CONFIG_PXA_DMA
+static int pxa_mmc_dma_prep_chain(u32 src, u32 dst, u32 len, u32 dcmd)
+{
+	return pxa_dma_prep(pxa_mmc_desc, PXAMMC_DMA_DESCS, src, dst, len,
+				dcmd | DCMD_BURST32 | DCMD_WIDTH1);
+}
+
+/*
+ * Set up the DMA descriptor chain for the data phase. Returns 0 if the
+ * transfer is going to use DMA, non-zero if it has to fall back to PIO.
+ */
+static int pxa_mmc_dma_prep(struct mmc_data *data)
+{
+	u32 len = data->blocks * data->blocksize;
+	u32 fifo, dcmd;
+	int ret;
+
+	if (pxa_mmc_dma < 0)
+		return -ENODEV;
+
+	/* Short register reads (SCR, switch status) are not worth it */
+	if (len & (PXAMMC_FIFO_SIZE - 1) || len < MMC_BLOCK_SIZE)
+		return -EINVAL;
+
+	if (data->flags & MMC_DATA_WRITE) {
+		fifo = (u32)&MMC_TXFIFO;
+		dcmd = DCMD_INCSRCADDR | DCMD_FLOWTRG;
+		ret = pxa_mmc_dma_prep_chain((u32)data->src, fifo, len, dcmd);
+	} else {
+		fifo = (u32)&MMC_RXFIFO;
+		dcmd = DCMD_INCTRGADDR | DCMD_FLOWSRC;
+		ret = pxa_mmc_dma_prep_chain(fifo, (u32)data->dest, len, dcmd);
+	}
+	if (ret < 0)
 		return ret;
 
+	/* Only route the FIFO requests to the channel once it is set up */
+	if (data->flags & MMC_DATA_WRITE) {
+		DRCMRRXMMC = 0;
+		DRCMRTXMMC = pxa_mmc_dma | DRCMR_MAPVLD;
+	} else {
+		DRCMRTXMMC = 0;
+		DRCMRRXMMC = pxa_mmc_dma | DRCMR_MAPVLD;
+	}
+
 	return 0;
 }
 
+/* Stop the data phase channel and unmap the FIFO requests from it */
+static void pxa_mmc_dma_stop(void)
+{
+	pxa_dma_stop(pxa_mmc_dma);
+	DRCMRRXMMC = 0;
+	DRCMRTXMMC = 0;
+}
+
+static int pxa_mmc_do_dma_xfer(struct mmc_data *data)
+{
+	int ret;
+
+	/* PXA27x erratum: start TX DMA only after the command response */
+	if (data->flags & MMC_DATA_WRITE)
+		pxa_dma_start(pxa_mmc_dma, pxa_mmc_desc);
+
+	/* On a CRC or read timeout error the DMA stalls until the timeout */
+	ret = pxa_dma_wait(pxa_mmc_dma, PXAMMC_DMA_TIMEOUT);
+	pxa_mmc_dma_stop();
+
+	if (ret == -ETIMEDOUT)
+		return (MMC_STAT & MMC_STAT_ERRORS) ? -EIO : TIMEOUT;
+	if (ret < 0)
+		return ret;
+
+	if (data->flags & MMC_DATA_WRITE)
+		data->src += data->blocks * data->blocksize;
+	else
+		data->dest += data->blocks * data->blocksize;
+
+	/* Wait for the transmission-done interrupt */
+	return pxa_mmc_wait(MMC_STAT_DATA_TRAN_DONE);
+}
+#endif
+
 static int pxa_mmc_request(struct mmc *mmc, struct mmc_cmd *cmd,
 				struct mmc_data *data)
 {
 	unsigned long cmdat = 0;
+#ifdef	CONFIG_PXA_DMA
+	int dma = 0;
+#endif
 	int ret;
 
 	/* Stop the controller */
@@ -239,6 +341,15 @@ static int pxa_mmc_request(struct mmc *mmc, struct mmc_cmd *cmd,
 		cmdat |= MMC_CMDAT_DATA_EN;
 		if (data->flags & MMC_DATA_WRITE)
 			cmdat |= MMC_CMDAT_WRITE;
+#ifdef	CONFIG_PXA_DMA
+		/* Use DMA for the data phase if possible, PIO otherwise */
+		if (!pxa_mmc_dma_prep(data)) {
+			dma = 1;
+			cmdat |= MMC_CMDAT_MMC_DMA_EN;
+			if (!(data->flags & MMC_DATA_WRITE))
+				pxa_dma_start(pxa_mmc_dma, pxa_mmc_desc);
+		}
+#endif
 	}
 
 	/* Run in 4bit mode if the card can do it */
@@ -248,32 +359,46 @@ static int pxa_mmc_request(struct mmc *mmc, struct mmc_cmd *cmd,
 	/* Execute the command */
 	ret = pxa_mmc_start_cmd(cmd, cmdat);
 	if (ret)
-		return ret;
+		goto out_err;
 
 	/* Wait until the command completes */
 	ret = pxa_mmc_wait(MMC_STAT_END_CMD_RES);
 	if (ret)
-		return ret;
+		goto out_err;
 
 	/* Read back the result */
 	ret = pxa_mmc_cmd_done(cmd);
 	if (ret)
-		return ret;
+		goto out_err;
 
 	/* In case there was a data transfer scheduled, do it */
 	if (data) {
+#ifdef	CONFIG_PXA_DMA
+		if (dma)
+			ret = pxa_mmc_do_dma_xfer(data);
+		else
+#endif
 		if (data->flags & MMC_DATA_WRITE)
-			pxa_mmc_do_write_xfer(data);
+			ret = pxa_mmc_do_write_xfer(data);
 		else
-			pxa_mmc_do_read_xfer(data);
+			ret = pxa_mmc_do_read_xfer(data);
+		if (ret)
+			return ret;
 	}
 
 	return 0;
+
+out_err:
+#ifdef	CONFIG_PXA_DMA
+	/* The data phase never ran, the RX channel may already be running */
+	if (dma)
+		pxa_mmc_dma_stop();
+#endif
+	return ret;
 }
 
 static void pxa_mmc_set_ios(struct mmc *mmc)
 {
-	unsigned long tmp;
 	unsigned long pxa_mmc_clock;
 
 	/* Set clock to the card */
@@ -282,14 +407,15 @@ static void pxa_mmc_set_ios(struct mmc *mmc)
 		if (mmc->clock == 26000000)
 			MMC_CLKRT = 0x7;
 		else {
+			/* Fastest divider not exceeding the requested clock */
 			pxa_mmc_clock = 0;
-			tmp = mmc->f_max / mmc->clock;
-			tmp += tmp % 2;
-			while (tmp > 1) {
+			while ((mmc->f_max >> pxa_mmc_clock) > mmc->clock &&
+				pxa_mmc_clock < MMC_CLKRT_0_3125MHZ)
 				pxa_mmc_clock++;
-				tmp >>= 1;
-			}
 			MMC_CLKRT = pxa_mmc_clock;
+
+			/* Let the core know what the card really runs at */
+			mmc->clock = mmc->f_max >> pxa_mmc_clock;
 		}
 	} else
 		pxa_mmc_stop_clock();
@@ -312,7 +438,7 @@ int pxa_mmc_init(bd_t *bis)
 {
 	struct mmc *mmc;
 
-	mmc = malloc(sizeof(struct mmc));
+	mmc = calloc(1, sizeof(struct mmc));
 
 	if (!mmc)
 		return -ENOMEM;
@@ -325,6 +451,16 @@ int pxa_mmc_init(bd_t *bis)
 	mmc->f_max	= PXAMMC_MAX_SPEED;
 	mmc->f_min	= PXAMMC_MIN_SPEED;
 	mmc->host_caps	= PXAMMC_HOST_CAPS;
+	mmc->b_max	= MMC_NOB_MAX;
+
+#ifdef	CONFIG_PXA_DMA
+	/* Without a DMA channel, the data phases are done via PIO */
+	pxa_mmc_dma = pxa_dma_request();
+	if (pxa_mmc_dma >= 0)
+		mmc->b_max = PXAMMC_DMA_DESCS * PXA_DMA_DESC_MAXLEN /
+				MMC_MAX_BLOCK_SIZE;
+#endif
+
 	mmc_register(mmc);
 
 	return 0;
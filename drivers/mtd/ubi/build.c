@@ -453,10 +453,9 @@ static void uif_close(struct ubi_device *ubi)
  * This function returns zero in case of success and a negative error code in
  * case of failure.
  *
- * Note, currently this is the only method to attach UBI devices. Hopefully in
- * the future we'll have more scalable attaching methods and avoid full media
- * scanning. But even in this case scanning will be needed as a fall-back
- * attaching method if there are some on-flash table corruptions.
+ * Note, with CONFIG_MTD_UBI_FASTMAP 'ubi_scan()' takes the scanning information
+ * from the on-flash fastmap if there is a valid one, full media scanning is
+ * the fall-back attaching method if it is missing or stale.
  */
 static int attach_by_scanning(struct ubi_device *ubi)
 {
@@ -492,6 +491,9 @@ out_wl:
 out_vtbl:
 	vfree(ubi->vtbl);
 out_si:
+#ifdef CONFIG_MTD_UBI_FASTMAP
+	ubi_free_fastmap(ubi);
+#endif
 	ubi_scan_destroy_si(si);
 	return err;
 }
@@ -816,6 +818,13 @@ int ubi_attach_mtd_dev(struct mtd_info *mtd, int ubi_num, int vid_hdr_offset)
 			goto out_detach;
 	}
 
+#ifdef CONFIG_MTD_UBI_FASTMAP
+	/* Next time, attach without scanning */
+	err = ubi_update_fastmap(ubi);
+	if (err)
+		ubi_warn("cannot write fastmap, error %d", err);
+#endif
+
 	err = uif_init(ubi);
 	if (err)
 		goto out_detach;
@@ -858,6 +867,9 @@ out_uif:
 out_detach:
 	ubi_eba_close(ubi);
 	ubi_wl_close(ubi);
+#ifdef CONFIG_MTD_UBI_FASTMAP
+	ubi_free_fastmap(ubi);
+#endif
 	vfree(ubi->vtbl);
 out_free:
 	vfree(ubi->peb_buf1);
@@ -921,6 +933,9 @@ int ubi_detach_mtd_dev(int ubi_num, int anyway)
 	uif_close(ubi);
 	ubi_eba_close(ubi);
 	ubi_wl_close(ubi);
+#ifdef CONFIG_MTD_UBI_FASTMAP
+	ubi_free_fastmap(ubi);
+#endif
 	vfree(ubi->vtbl);
 	put_mtd_device(ubi->mtd);
 	vfree(ubi->peb_buf1);
@@ -0,0 +1,881 @@
+/*
+ * UBI fastmap support
+ *
+ * See file CREDITS for list of people who contributed to this
+ * project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See
+ * the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+/*
+ * UBI fastmap unit.
+ *
+ * A fastmap is a snapshot of the scanning information: the erase counters of
+ * all physical eraseblocks and the EBA tables of all volumes. It is stored in
+ * the on-flash format of Linux, in the internal volumes
+ * %UBI_FM_SB_VOLUME_ID and %UBI_FM_DATA_VOLUME_ID. The physical eraseblock
+ * with the fastmap super block is always one of the first %UBI_FM_MAX_START
+ * ones, so attaching from a fastmap reads a few physical eraseblocks instead
+ * of the headers of all of them.
+ *
+ * The physical eraseblocks the writer of the fastmap may have used after
+ * writing it are listed in the pools of the fastmap and are scanned as usual.
+ * If anything in the fastmap does not add up, it is ignored and the device is
+ * fully scanned.
+ *
+ * Any write or erasure makes the fastmap stale, so the I/O unit invalidates it
+ * before the first one by erasing the fastmap physical eraseblocks and handing
+ * them to the WL unit. After attaching by full scanning, a new fastmap is
+ * written for the next attach.
+ */
+
+#ifdef UBI_LINUX
+#include <linux/crc32.h>
+#endif
+
+#include <ubi_uboot.h>
+#include "ubi.h"
+
+/* States of the physical eraseblocks while attaching from a fastmap */
+enum {
+	FM_PEB_UNKNOWN = 0,
+	FM_PEB_DONE,	/* accounted for */
+	FM_PEB_USED,	/* used, not yet found in an EBA table */
+	FM_PEB_SCRUB,	/* same, but has to be scrubbed */
+};
+
+/**
+ * add_peb - add a physical eraseblock to a list of the scanning information.
+ * @si: scanning information
+ * @list: the list to add to
+ * @pnum: physical eraseblock number
+ * @ec: erase counter of the physical eraseblock
+ *
+ * Returns zero in case of success and %-ENOMEM in case of failure.
+ */
+static int add_peb(struct ubi_scan_info *si, struct list_head *list, int pnum,
+		   int ec)
+{
+	struct ubi_scan_leb *seb;
+
+	seb = kmalloc(sizeof(struct ubi_scan_leb), GFP_KERNEL);
+	if (!seb)
+		return -ENOMEM;
+
+	seb->pnum = pnum;
+	seb->ec = ec;
+	list_add_tail(&seb->u.list, list);
+	return 0;
+}
+
+/**
+ * account_ec - update the erase counter statistics of the scanning
+ * information.
+ * @si: scanning information
+ * @ec: erase counter of a physical eraseblock
+ */
+static void account_ec(struct ubi_scan_info *si, int ec)
+{
+	si->ec_sum += ec;
+	si->ec_count += 1;
+	if (ec > si->max_ec)
+		si->max_ec = ec;
+	if (ec < si->min_ec)
+		si->min_ec = ec;
+}
+
+/**
+ * add_used - add a used physical eraseblock to the scanning information.
+ * @ubi: UBI device description object
+ * @si: scanning information
+ * @pnum: physical eraseblock number
+ * @ec: erase counter of the physical eraseblock
+ * @vid_hdr: the volume identifier header describing the logical eraseblock
+ * @scrub: whether the physical eraseblock has to be scrubbed
+ *
+ * Returns zero in case of success, %UBI_BAD_FASTMAP if the logical eraseblock
+ * is inconsistent with the others and %-ENOMEM if there is no memory.
+ */
+static int add_used(struct ubi_device *ubi, struct ubi_scan_info *si,
+		    int pnum, int ec, const struct ubi_vid_hdr *vid_hdr,
+		    int scrub)
+{
+	int err;
+
+	err = ubi_scan_add_used(ubi, si, pnum, ec, vid_hdr, scrub);
+	if (err == -ENOMEM)
+		return err;
+	return err ? UBI_BAD_FASTMAP : 0;
+}
+
+/**
+ * scan_pool_peb - scan a physical eraseblock listed in a fastmap pool.
+ * @ubi: UBI device description object
+ * @si: scanning information
+ * @pnum: physical eraseblock number
+ * @ech: buffer for the erase counter header
+ * @vh: buffer for the volume identifier header
+ *
+ * This is a simplified 'process_eb()': anything unusual is left to full
+ * scanning. Returns zero in case of success, %UBI_BAD_FASTMAP or %-ENOMEM.
+ */
+static int scan_pool_peb(struct ubi_device *ubi, struct ubi_scan_info *si,
+			 int pnum, struct ubi_ec_hdr *ech,
+			 struct ubi_vid_hdr *vh)
+{
+	long long ec;
+	int err, vol_id, bitflips = 0;
+
+	if (ubi_io_is_bad(ubi, pnum))
+		return UBI_BAD_FASTMAP;
+
+	err = ubi_io_read_ec_hdr(ubi, pnum, ech, 0);
+	if (err == UBI_IO_BITFLIPS)
+		bitflips = 1;
+	else if (err)
+		return UBI_BAD_FASTMAP;
+
+	ec = be64_to_cpu(ech->ec);
+	if (ech->version != UBI_VERSION || ec > UBI_MAX_ERASECOUNTER)
+		return UBI_BAD_FASTMAP;
+
+	err = ubi_io_read_vid_hdr(ubi, pnum, vh, 0);
+	if (err == UBI_IO_PEB_FREE) {
+		err = add_peb(si, &si->free, pnum, ec);
+		goto out;
+	} else if (err == UBI_IO_BITFLIPS)
+		bitflips = 1;
+	else if (err)
+		return UBI_BAD_FASTMAP;
+
+	vol_id = be32_to_cpu(vh->vol_id);
+	if (vol_id == UBI_FM_SB_VOLUME_ID || vol_id == UBI_FM_DATA_VOLUME_ID)
+		/* An older fastmap */
+		err = add_peb(si, &si->erase, pnum, ec);
+	else if (vol_id >= UBI_MAX_VOLUMES && vol_id != UBI_LAYOUT_VOLUME_ID)
+		return UBI_BAD_FASTMAP;
+	else
+		err = add_used(ubi, si, pnum, ec, vh, bitflips);
+
+out:
+	if (err)
+		return err;
+	account_ec(si, ec);
+	return 0;
+}
+
+/**
+ * attach_fastmap - fill the scanning information from fastmap data.
+ * @ubi: UBI device description object
+ * @si: scanning information to fill
+ * @fm: the fastmap physical eraseblocks
+ * @fm_raw: the fastmap data
+ * @fm_size: size of @fm_raw
+ * @ech: buffer for erase counter headers
+ * @vh: buffer for volume identifier headers
+ *
+ * Everything read from @fm_raw is checked against @fm_size and the device
+ * geometry, every physical eraseblock has to be accounted for exactly once.
+ * Returns zero in case of success, %UBI_BAD_FASTMAP if the fastmap cannot be
+ * used and %-ENOMEM if there is no memory.
+ */
+static int attach_fastmap(struct ubi_device *ubi, struct ubi_scan_info *si,
+			  struct ubi_fastmap_layout *fm, void *fm_raw,
+			  size_t fm_size, struct ubi_ec_hdr *ech,
+			  struct ubi_vid_hdr *vh)
+{
+	struct ubi_fm_hdr *fmhdr;
+	struct ubi_fm_scan_pool *fmpl[2];
+	struct ubi_fm_ec *fmec;
+	struct ubi_fm_volhdr *fmvhdr;
+	struct ubi_fm_eba *fm_eba;
+	unsigned char *state;
+	int *ecs;
+	size_t pos;
+	int counts[4];
+	int i, j, n, pnum, ec, vol_id, reserved_pebs, bad_peb_count, err;
+
+	state = kzalloc(ubi->peb_count, GFP_KERNEL);
+	ecs = kmalloc(ubi->peb_count * sizeof(int), GFP_KERNEL);
+	err = -ENOMEM;
+	if (!state || !ecs)
+		goto out;
+
+	err = UBI_BAD_FASTMAP;
+	pos = sizeof(struct ubi_fm_sb);
+	if (pos + sizeof(*fmhdr) + 2 * sizeof(**fmpl) > fm_size)
+		goto out;
+
+	fmhdr = fm_raw + pos;
+	pos += sizeof(*fmhdr);
+	for (n = 0; n < 2; n++) {
+		fmpl[n] = fm_raw + pos;
+		pos += sizeof(**fmpl);
+		if (be32_to_cpu(fmpl[n]->magic) != UBI_FM_POOL_MAGIC)
+			goto out;
+	}
+	if (be32_to_cpu(fmhdr->magic) != UBI_FM_HDR_MAGIC)
+		goto out;
+
+	for (i = 0; i < fm->used_blocks; i++)
+		state[fm->e[i]->pnum] = FM_PEB_DONE;
+
+	/* The free, used, scrub and erase lists, in this order */
+	counts[0] = be32_to_cpu(fmhdr->free_peb_count);
+	counts[1] = be32_to_cpu(fmhdr->used_peb_count);
+	counts[2] = be32_to_cpu(fmhdr->scrub_peb_count);
+	counts[3] = be32_to_cpu(fmhdr->erase_peb_count);
+	for (n = 0; n < 4; n++) {
+		if (counts[n] < 0 || counts[n] > ubi->peb_count ||
+		    pos + counts[n] * sizeof(*fmec) > fm_size)
+			goto out;
+
+		for (i = 0; i < counts[n]; i++) {
+			fmec = fm_raw + pos;
+			pos += sizeof(*fmec);
+
+			pnum = be32_to_cpu(fmec->pnum);
+			ec = be32_to_cpu(fmec->ec);
+			if (pnum < 0 || pnum >= ubi->peb_count || state[pnum] ||
+			    ec < 0 || ec > UBI_MAX_ERASECOUNTER)
+				goto out;
+
+			account_ec(si, ec);
+			ecs[pnum] = ec;
+			if (n == 0 || n == 3) {
+				state[pnum] = FM_PEB_DONE;
+				err = add_peb(si, n == 0 ? &si->free :
+					      &si->erase, pnum, ec);
+				if (err)
+					goto out;
+				err = UBI_BAD_FASTMAP;
+			} else
+				state[pnum] = n == 1 ? FM_PEB_USED :
+					      FM_PEB_SCRUB;
+		}
+	}
+
+	/* The volumes and their EBA tables */
+	n = be32_to_cpu(fmhdr->vol_count);
+	if (n < 0 || n > UBI_MAX_VOLUMES + UBI_INT_VOL_COUNT)
+		goto out;
+
+	for (i = 0; i < n; i++) {
+		if (pos + sizeof(*fmvhdr) + sizeof(*fm_eba) > fm_size)
+			goto out;
+		fmvhdr = fm_raw + pos;
+		pos += sizeof(*fmvhdr);
+		fm_eba = fm_raw + pos;
+		pos += sizeof(*fm_eba);
+
+		if (be32_to_cpu(fmvhdr->magic) != UBI_FM_VHDR_MAGIC ||
+		    be32_to_cpu(fm_eba->magic) != UBI_FM_EBA_MAGIC)
+			goto out;
+
+		vol_id = be32_to_cpu(fmvhdr->vol_id);
+		if ((vol_id < 0 || vol_id >= UBI_MAX_VOLUMES) &&
+		    vol_id != UBI_LAYOUT_VOLUME_ID)
+			goto out;
+
+		reserved_pebs = be32_to_cpu(fm_eba->reserved_pebs);
+		if (reserved_pebs < 0 || reserved_pebs > ubi->peb_count ||
+		    pos + reserved_pebs * sizeof(__be32) > fm_size)
+			goto out;
+		pos += reserved_pebs * sizeof(__be32);
+
+		/*
+		 * All logical eraseblocks are described by one VID header,
+		 * like the ones written for this volume.
+		 */
+		memset(vh, 0, sizeof(struct ubi_vid_hdr));
+		vh->compat = vol_id == UBI_LAYOUT_VOLUME_ID ?
+			     UBI_LAYOUT_VOLUME_COMPAT : 0;
+		vh->vol_id = fmvhdr->vol_id;
+		vh->data_pad = fmvhdr->data_pad;
+		if (fmvhdr->vol_type == UBI_STATIC_VOLUME) {
+			vh->vol_type = UBI_VID_STATIC;
+			vh->used_ebs = fmvhdr->used_ebs;
+			vh->data_size = fmvhdr->last_eb_bytes;
+		} else
+			vh->vol_type = UBI_VID_DYNAMIC;
+
+		for (j = 0; j < reserved_pebs; j++) {
+			pnum = be32_to_cpu(fm_eba->pnum[j]);
+			if (pnum < 0)
+				continue;
+			if (pnum >= ubi->peb_count ||
+			    (state[pnum] != FM_PEB_USED &&
+			     state[pnum] != FM_PEB_SCRUB))
+				goto out;
+
+			vh->lnum = cpu_to_be32(j);
+			err = add_used(ubi, si, pnum, ecs[pnum], vh,
+				       state[pnum] == FM_PEB_SCRUB);
+			if (err)
+				goto out;
+			err = UBI_BAD_FASTMAP;
+			state[pnum] = FM_PEB_DONE;
+		}
+	}
+
+	/* The pools were written to after the fastmap, scan them */
+	for (n = 0; n < 2; n++) {
+		j = be16_to_cpu(fmpl[n]->size);
+		if (j > UBI_FM_MAX_POOL_SIZE)
+			goto out;
+
+		for (i = 0; i < j; i++) {
+			pnum = be32_to_cpu(fmpl[n]->pebs[i]);
+			if (pnum < 0 || pnum >= ubi->peb_count || state[pnum])
+				goto out;
+
+			err = scan_pool_peb(ubi, si, pnum, ech, vh);
+			if (err)
+				goto out;
+			err = UBI_BAD_FASTMAP;
+			state[pnum] = FM_PEB_DONE;
+		}
+	}
+
+	/*
+	 * Used physical eraseblocks without a logical eraseblock in the
+	 * fastmap belong to volumes which were being changed, look at them.
+	 */
+	for (pnum = 0; pnum < ubi->peb_count; pnum++) {
+		if (state[pnum] != FM_PEB_USED && state[pnum] != FM_PEB_SCRUB)
+			continue;
+
+		err = ubi_io_read_vid_hdr(ubi, pnum, vh, 0);
+		if (err && err != UBI_IO_BITFLIPS)
+			goto out_bad;
+		vol_id = be32_to_cpu(vh->vol_id);
+		if (vol_id >= UBI_MAX_VOLUMES && vol_id != UBI_LAYOUT_VOLUME_ID)
+			goto out_bad;
+
+		err = add_used(ubi, si, pnum, ecs[pnum], vh,
+			       err || state[pnum] == FM_PEB_SCRUB);
+		if (err)
+			goto out;
+		err = UBI_BAD_FASTMAP;
+		state[pnum] = FM_PEB_DONE;
+	}
+
+	bad_peb_count = be32_to_cpu(fmhdr->bad_peb_count);
+	if (bad_peb_count < 0)
+		goto out;
+	j = bad_peb_count;
+	for (pnum = 0; pnum < ubi->peb_count; pnum++)
+		if (state[pnum])
+			j += 1;
+	if (j != ubi->peb_count) {
+		dbg_bld("fastmap describes %d of %d PEBs", j, ubi->peb_count);
+		goto out;
+	}
+
+	si->bad_peb_count = bad_peb_count;
+	si->is_empty = 0;
+	err = 0;
+	goto out;
+
+out_bad:
+	err = UBI_BAD_FASTMAP;
+out:
+	kfree(ecs);
+	kfree(state);
+	return err;
+}
+
+/**
+ * free_layout - free a fastmap layout object.
+ * @fm: the object to free
+ */
+static void free_layout(struct ubi_fastmap_layout *fm)
+{
+	int i;
+
+	for (i = 0; i < fm->used_blocks; i++)
+		kmem_cache_free(ubi_wl_entry_slab, fm->e[i]);
+	kfree(fm);
+}
+
+/**
+ * ubi_scan_fastmap - attach an MTD device from its fastmap.
+ * @ubi: UBI device description object
+ * @si: empty scanning information to fill
+ *
+ * This function looks for the most recent fastmap in the first
+ * %UBI_FM_MAX_START physical eraseblocks and fills @si from it. On success
+ * @ubi->fm describes the fastmap physical eraseblocks, which are not in @si.
+ * Returns zero in case of success, %UBI_NO_FASTMAP if there is no fastmap,
+ * %UBI_BAD_FASTMAP if it is damaged or stale, in which case @si has to be
+ * thrown away, and %-ENOMEM if there is no memory.
+ */
+int ubi_scan_fastmap(struct ubi_device *ubi, struct ubi_scan_info *si)
+{
+	struct ubi_fastmap_layout *fm = NULL;
+	struct ubi_fm_sb *fmsb = NULL, *raw_sb;
+	struct ubi_ec_hdr *ech;
+	struct ubi_vid_hdr *vh;
+	unsigned long long sqnum, max_sqnum = 0;
+	void *fm_raw = NULL;
+	size_t fm_size;
+	uint32_t crc;
+	int i, err, pnum, anchor = -1, used_blocks;
+
+	ech = kzalloc(ubi->ec_hdr_alsize, GFP_KERNEL);
+	vh = ubi_zalloc_vid_hdr(ubi, GFP_KERNEL);
+	err = -ENOMEM;
+	if (!ech || !vh)
+		goto out;
+
+	/* Find the most recent fastmap super block */
+	for (pnum = 0; pnum < UBI_FM_MAX_START && pnum < ubi->peb_count;
+	     pnum++) {
+		if (ubi_io_is_bad(ubi, pnum))
+			continue;
+		err = ubi_io_read_vid_hdr(ubi, pnum, vh, 0);
+		if (err && err != UBI_IO_BITFLIPS)
+			continue;
+		sqnum = be64_to_cpu(vh->sqnum);
+		if (be32_to_cpu(vh->vol_id) == UBI_FM_SB_VOLUME_ID &&
+		    (anchor < 0 || sqnum > max_sqnum)) {
+			anchor = pnum;
+			max_sqnum = sqnum;
+		}
+	}
+
+	err = UBI_NO_FASTMAP;
+	if (anchor < 0)
+		goto out;
+
+	err = -ENOMEM;
+	fmsb = kmalloc(sizeof(struct ubi_fm_sb), GFP_KERNEL);
+	fm = kzalloc(sizeof(struct ubi_fastmap_layout), GFP_KERNEL);
+	if (!fmsb || !fm)
+		goto out;
+
+	err = ubi_io_read_data(ubi, fmsb, anchor, 0, sizeof(struct ubi_fm_sb));
+	if (err && err != UBI_IO_BITFLIPS)
+		goto out_bad;
+
+	used_blocks = be32_to_cpu(fmsb->used_blocks);
+	if (be32_to_cpu(fmsb->magic) != UBI_FM_SB_MAGIC ||
+	    fmsb->version != UBI_FM_FMT_VERSION ||
+	    used_blocks < 1 || used_blocks > UBI_FM_MAX_BLOCKS ||
+	    be32_to_cpu(fmsb->block_loc[0]) != anchor) {
+		ubi_warn("bad fastmap super block at PEB %d", anchor);
+		goto out_bad;
+	}
+
+	fm_size = ubi->leb_size * used_blocks;
+	err = -ENOMEM;
+	fm_raw = vmalloc(fm_size);
+	if (!fm_raw)
+		goto out;
+
+	for (i = 0; i < used_blocks; i++) {
+		pnum = be32_to_cpu(fmsb->block_loc[i]);
+		if (pnum < 0 || pnum >= ubi->peb_count ||
+		    ubi_io_is_bad(ubi, pnum))
+			goto out_bad;
+
+		err = ubi_io_read_ec_hdr(ubi, pnum, ech, 0);
+		if (err && err != UBI_IO_BITFLIPS)
+			goto out_bad;
+		if (be64_to_cpu(ech->ec) > UBI_MAX_ERASECOUNTER)
+			goto out_bad;
+
+		err = ubi_io_read_vid_hdr(ubi, pnum, vh, 0);
+		if (err && err != UBI_IO_BITFLIPS)
+			goto out_bad;
+		if (be32_to_cpu(vh->vol_id) != (i == 0 ? UBI_FM_SB_VOLUME_ID :
+						UBI_FM_DATA_VOLUME_ID))
+			goto out_bad;
+		sqnum = be64_to_cpu(vh->sqnum);
+		if (sqnum > max_sqnum)
+			max_sqnum = sqnum;
+
+		err = ubi_io_read_data(ubi, fm_raw + i * ubi->leb_size, pnum,
+				       0, ubi->leb_size);
+		if (err && err != UBI_IO_BITFLIPS)
+			goto out_bad;
+
+		err = -ENOMEM;
+		fm->e[i] = kmem_cache_alloc(ubi_wl_entry_slab, GFP_KERNEL);
+		if (!fm->e[i])
+			goto out;
+		fm->e[i]->pnum = pnum;
+		fm->e[i]->ec = be64_to_cpu(ech->ec);
+		fm->used_blocks = i + 1;
+	}
+
+	/* The CRC is calculated with the CRC field zeroed */
+	raw_sb = fm_raw;
+	crc = be32_to_cpu(raw_sb->data_crc);
+	raw_sb->data_crc = 0;
+	if (crc32(UBI_CRC32_INIT, fm_raw, fm_size) != crc) {
+		ubi_warn("fastmap data CRC error");
+		goto out_bad;
+	}
+
+	err = attach_fastmap(ubi, si, fm, fm_raw, fm_size, ech, vh);
+	if (err)
+		goto out;
+
+	sqnum = be64_to_cpu(raw_sb->sqnum);
+	if (sqnum > max_sqnum)
+		max_sqnum = sqnum;
+	if (max_sqnum > si->max_sqnum)
+		si->max_sqnum = max_sqnum;
+
+	ubi_msg("attached from the fastmap at PEB %d", anchor);
+	ubi->fm = fm;
+	fm = NULL;
+	goto out;
+
+out_bad:
+	err = UBI_BAD_FASTMAP;
+out:
+	if (err == UBI_BAD_FASTMAP)
+		ubi_msg("fastmap is not usable, scanning the device");
+	if (fm)
+		free_layout(fm);
+	vfree(fm_raw);
+	kfree(fmsb);
+	ubi_free_vid_hdr(ubi, vh);
+	kfree(ech);
+	return err;
+}
+
+/**
+ * fastmap_size - calculate the size of a fastmap.
+ * @ubi: UBI device description object
+ *
+ * Like Linux, this reserves room for the largest possible fastmap of the
+ * device, so a fastmap always fits into the same number of blocks.
+ */
+static size_t fastmap_size(const struct ubi_device *ubi)
+{
+	size_t size;
+
+	size = sizeof(struct ubi_fm_sb) + sizeof(struct ubi_fm_hdr) +
+	       2 * sizeof(struct ubi_fm_scan_pool) +
+	       ubi->peb_count * sizeof(struct ubi_fm_ec) +
+	       sizeof(struct ubi_fm_eba) + ubi->peb_count * sizeof(__be32) +
+	       sizeof(struct ubi_fm_volhdr) * UBI_MAX_VOLUMES;
+	return roundup(size, ubi->leb_size);
+}
+
+/**
+ * write_fastmap - fill and write the fastmap data.
+ * @ubi: UBI device description object
+ * @fm: the physical eraseblocks to write the fastmap to
+ * @fm_raw: zeroed buffer of @fm->used_blocks logical eraseblocks
+ * @vh: buffer for the volume identifier headers
+ *
+ * Returns zero in case of success, %1 if the device cannot be described by
+ * a fastmap and a negative error code in case of failure.
+ */
+static int write_fastmap(struct ubi_device *ubi, struct ubi_fastmap_layout *fm,
+			 void *fm_raw, struct ubi_vid_hdr *vh)
+{
+	struct ubi_fm_sb *fmsb = fm_raw;
+	struct ubi_fm_hdr *fmhdr;
+	struct ubi_fm_scan_pool *fmpl;
+	struct ubi_fm_ec *fmec;
+	struct ubi_fm_volhdr *fmvhdr;
+	struct ubi_fm_eba *fm_eba;
+	struct ubi_volume *vol;
+	struct ubi_wl_entry *e;
+	unsigned char *used;
+	size_t pos, fm_size = fm->used_blocks * ubi->leb_size;
+	int i, j, pnum, err, pool_size, free_peb_count = 0;
+	int used_peb_count = 0, vol_count = 0;
+
+	used = kzalloc(ubi->peb_count, GFP_KERNEL);
+	if (!used)
+		return -ENOMEM;
+
+	pos = sizeof(struct ubi_fm_sb);
+	fmhdr = fm_raw + pos;
+	pos += sizeof(struct ubi_fm_hdr);
+
+	/* Nothing was written after this fastmap, the pools are empty */
+	pool_size = ubi->peb_count / 100 * 5;
+	if (pool_size < UBI_FM_MIN_POOL_SIZE)
+		pool_size = UBI_FM_MIN_POOL_SIZE;
+	if (pool_size > UBI_FM_MAX_POOL_SIZE)
+		pool_size = UBI_FM_MAX_POOL_SIZE;
+	for (i = 0; i < 2; i++) {
+		fmpl = fm_raw + pos;
+		pos += sizeof(struct ubi_fm_scan_pool);
+		fmpl->magic = cpu_to_be32(UBI_FM_POOL_MAGIC);
+		fmpl->max_size = cpu_to_be16(i == 0 ? pool_size : pool_size / 2);
+	}
+
+	for (i = 0; i < ubi->vtbl_slots + UBI_INT_VOL_COUNT; i++) {
+		vol = ubi->volumes[i];
+		if (!vol)
+			continue;
+		for (j = 0; j < vol->reserved_pebs; j++)
+			if (vol->eba_tbl[j] >= 0)
+				used[vol->eba_tbl[j]] = 1;
+	}
+
+	/* Free physical eraseblocks first, then the used ones */
+	for (i = 0; i < 2; i++) {
+		for (pnum = 0; pnum < ubi->peb_count; pnum++) {
+			e = ubi->lookuptbl[pnum];
+			if (!e || used[pnum] != i)
+				continue;
+
+			fmec = fm_raw + pos;
+			pos += sizeof(struct ubi_fm_ec);
+			fmec->pnum = cpu_to_be32(pnum);
+			fmec->ec = cpu_to_be32(e->ec);
+			if (i == 0)
+				free_peb_count += 1;
+			else
+				used_peb_count += 1;
+		}
+	}
+
+	err = 1;
+	if (free_peb_count + used_peb_count + fm->used_blocks +
+	    ubi->bad_peb_count != ubi->peb_count) {
+		dbg_msg("not all PEBs are known to the WL unit");
+		goto out;
+	}
+
+	fmhdr->magic = cpu_to_be32(UBI_FM_HDR_MAGIC);
+	fmhdr->free_peb_count = cpu_to_be32(free_peb_count);
+	fmhdr->used_peb_count = cpu_to_be32(used_peb_count);
+	fmhdr->bad_peb_count = cpu_to_be32(ubi->bad_peb_count);
+
+	for (i = 0; i < ubi->vtbl_slots + UBI_INT_VOL_COUNT; i++) {
+		vol = ubi->volumes[i];
+		if (!vol)
+			continue;
+
+		fmvhdr = fm_raw + pos;
+		pos += sizeof(struct ubi_fm_volhdr);
+		fmvhdr->magic = cpu_to_be32(UBI_FM_VHDR_MAGIC);
+		fmvhdr->vol_id = cpu_to_be32(vol->vol_id);
+		fmvhdr->vol_type = vol->vol_type;
+		fmvhdr->used_ebs = cpu_to_be32(vol->used_ebs);
+		fmvhdr->data_pad = cpu_to_be32(vol->data_pad);
+		fmvhdr->last_eb_bytes = cpu_to_be32(vol->last_eb_bytes);
+
+		fm_eba = fm_raw + pos;
+		pos += sizeof(struct ubi_fm_eba) +
+		       vol->reserved_pebs * sizeof(__be32);
+		fm_eba->magic = cpu_to_be32(UBI_FM_EBA_MAGIC);
+		fm_eba->reserved_pebs = cpu_to_be32(vol->reserved_pebs);
+		for (j = 0; j < vol->reserved_pebs; j++)
+			fm_eba->pnum[j] = cpu_to_be32(vol->eba_tbl[j]);
+		vol_count += 1;
+	}
+	fmhdr->vol_count = cpu_to_be32(vol_count);
+	ubi_assert(pos <= fm_size);
+
+	spin_lock(&ubi->ltree_lock);
+	fmsb->sqnum = cpu_to_be64(ubi->global_sqnum);
+	spin_unlock(&ubi->ltree_lock);
+	fmsb->magic = cpu_to_be32(UBI_FM_SB_MAGIC);
+	fmsb->version = UBI_FM_FMT_VERSION;
+	fmsb->used_blocks = cpu_to_be32(fm->used_blocks);
+	for (i = 0; i < fm->used_blocks; i++) {
+		fmsb->block_loc[i] = cpu_to_be32(fm->e[i]->pnum);
+		fmsb->block_ec[i] = cpu_to_be32(fm->e[i]->ec);
+	}
+	fmsb->data_crc = cpu_to_be32(crc32(UBI_CRC32_INIT, fm_raw, fm_size));
+
+	/*
+	 * The super block goes last, a fastmap is only found once all of it
+	 * is on the flash.
+	 */
+	for (i = fm->used_blocks - 1; i >= 0; i--) {
+		vh->vol_type = UBI_VID_DYNAMIC;
+		vh->compat = UBI_COMPAT_DELETE;
+		vh->vol_id = cpu_to_be32(i == 0 ? UBI_FM_SB_VOLUME_ID :
+					 UBI_FM_DATA_VOLUME_ID);
+		vh->lnum = cpu_to_be32(i);
+		spin_lock(&ubi->ltree_lock);
+		vh->sqnum = cpu_to_be64(ubi->global_sqnum++);
+		spin_unlock(&ubi->ltree_lock);
+
+		pnum = fm->e[i]->pnum;
+		err = ubi_io_write_vid_hdr(ubi, pnum, vh);
+		if (err)
+			goto out;
+		err = ubi_io_write_data(ubi, fm_raw + i * ubi->leb_size, pnum,
+					0, ubi->leb_size);
+		if (err)
+			goto out;
+	}
+
+out:
+	kfree(used);
+	return err;
+}
+
+/**
+ * put_blocks - erase fastmap physical eraseblocks and give them back.
+ * @ubi: UBI device description object
+ * @fm: the physical eraseblocks, the object is freed
+ *
+ * If the WL unit is not initialized yet, the physical eraseblocks are only
+ * erased; they are found free by the next attach. Returns zero in case of
+ * success and a negative error code if the super block could not be erased.
+ */
+static int put_blocks(struct ubi_device *ubi, struct ubi_fastmap_layout *fm)
+{
+	struct ubi_wl_entry *e;
+	int i, err, ret = 0;
+
+	for (i = 0; i < fm->used_blocks; i++) {
+		e = fm->e[i];
+		err = ubi_scan_erase_peb(ubi, NULL, e->pnum, e->ec + 1);
+		if (err) {
+			ubi_err("cannot erase fastmap PEB %d, error %d",
+				e->pnum, err);
+			/* A stale super block must not be found again */
+			if (i == 0)
+				ret = err;
+			kmem_cache_free(ubi_wl_entry_slab, e);
+			continue;
+		}
+
+		e->ec += 1;
+		if (ubi->lookuptbl)
+			ubi_wl_put_fm_peb(ubi, e);
+		else
+			kmem_cache_free(ubi_wl_entry_slab, e);
+	}
+
+	kfree(fm);
+	return ret;
+}
+
+/**
+ * ubi_update_fastmap - write a fastmap describing the device.
+ * @ubi: UBI device description object
+ *
+ * This function is called after attaching by full scanning, when the device
+ * has no valid fastmap. It does nothing if the device cannot be described by
+ * a fastmap at the moment. Returns zero in case of success and a negative
+ * error code in case of failure.
+ */
+int ubi_update_fastmap(struct ubi_device *ubi)
+{
+	struct ubi_fastmap_layout *fm;
+	struct ubi_vid_hdr *vh;
+	void *fm_raw;
+	size_t fm_size;
+	int i, err;
+
+	if (ubi->fm || ubi->ro_mode || ubi->works_count)
+		return 0;
+
+	fm_size = fastmap_size(ubi);
+	if (fm_size / ubi->leb_size > UBI_FM_MAX_BLOCKS) {
+		dbg_msg("the device is too large for a fastmap");
+		return 0;
+	}
+
+	err = -ENOMEM;
+	fm = kzalloc(sizeof(struct ubi_fastmap_layout), GFP_KERNEL);
+	if (!fm)
+		return err;
+	fm_raw = vmalloc(fm_size);
+	if (!fm_raw)
+		goto out_fm;
+	memset(fm_raw, 0, fm_size);
+	vh = ubi_zalloc_vid_hdr(ubi, GFP_KERNEL);
+	if (!vh)
+		goto out_raw;
+
+	/* The super block has to be in one of the first PEBs */
+	for (i = 0; i < fm_size / ubi->leb_size; i++) {
+		fm->e[i] = ubi_wl_get_fm_peb(ubi, i == 0 ? UBI_FM_MAX_START :
+					     ubi->peb_count);
+		if (!fm->e[i]) {
+			err = 0;
+			dbg_msg("no free PEBs for the fastmap");
+			goto out_put;
+		}
+		fm->used_blocks = i + 1;
+	}
+
+	err = write_fastmap(ubi, fm, fm_raw, vh);
+	if (err) {
+		if (err > 0)
+			err = 0;
+		goto out_put;
+	}
+
+	ubi_msg("fastmap written to PEB %d", fm->e[0]->pnum);
+	ubi->fm = fm;
+	ubi_free_vid_hdr(ubi, vh);
+	vfree(fm_raw);
+	return 0;
+
+out_put:
+	/* Written or not, the PEBs have to be erased before reuse */
+	i = put_blocks(ubi, fm);
+	if (!err)
+		err = i;
+	fm = NULL;
+	ubi_free_vid_hdr(ubi, vh);
+out_raw:
+	vfree(fm_raw);
+out_fm:
+	kfree(fm);
+	return err;
+}
+
+/**
+ * ubi_invalidate_fastmap - make sure the fastmap is not used any more.
+ * @ubi: UBI device description object
+ *
+ * This function is called before the device is changed. It erases the
+ * fastmap physical eraseblocks, the super block first, and hands them to the
+ * WL unit. Returns zero in case of success and a negative error code in case
+ * of failure.
+ */
+int ubi_invalidate_fastmap(struct ubi_device *ubi)
+{
+	struct ubi_fastmap_layout *fm = ubi->fm;
+
+	if (!fm)
+		return 0;
+
+	/* Erasing goes through the I/O unit which calls us again */
+	ubi->fm = NULL;
+	dbg_msg("invalidate the fastmap at PEB %d", fm->e[0]->pnum);
+	return put_blocks(ubi, fm);
+}
+
+/**
+ * ubi_free_fastmap - free the fastmap description of a device.
+ * @ubi: UBI device description object
+ */
+void ubi_free_fastmap(struct ubi_device *ubi)
+{
+	if (ubi->fm) {
+		free_layout(ubi->fm);
+		ubi->fm = NULL;
+	}
+}
@@ -236,6 +236,13 @@ int ubi_io_write(struct ubi_device *ubi, const void *buf, int pnum, int offset,
 		return -EROFS;
 	}
 
+#ifdef CONFIG_MTD_UBI_FASTMAP
+	/* The fastmap does not describe the device after this any more */
+	err = ubi_invalidate_fastmap(ubi);
+	if (err)
+		return err;
+#endif
+
 	/* The below has to be compiled out if paranoid checks are disabled */
 
 	err = paranoid_check_not_bad(ubi, pnum);
@@ -486,6 +493,13 @@ int ubi_io_sync_erase(struct ubi_device *ubi, int pnum, int torture)
 		return -EROFS;
 	}
 
+#ifdef CONFIG_MTD_UBI_FASTMAP
+	/* The fastmap does not describe the device after this any more */
+	err = ubi_invalidate_fastmap(ubi);
+	if (err)
+		return err;
+#endif
+
 	if (torture) {
 		ret = torture_peb(ubi, pnum);
 		if (ret < 0)
@@ -897,23 +897,18 @@ adjust_mean_ec:
 }
 
 /**
- * ubi_scan - scan an MTD device.
- * @ubi: UBI device description object
+ * alloc_si - allocate empty scanning information.
  *
- * This function does full scanning of an MTD device and returns complete
- * information about it. In case of failure, an error code is returned.
+ * This function returns a pointer to the scanning information or %NULL if
+ * there is no memory.
  */
-struct ubi_scan_info *ubi_scan(struct ubi_device *ubi)
+static struct ubi_scan_info *alloc_si(void)
 {
-	int err, pnum;
-	struct rb_node *rb1, *rb2;
-	struct ubi_scan_volume *sv;
-	struct ubi_scan_leb *seb;
 	struct ubi_scan_info *si;
 
 	si = kzalloc(sizeof(struct ubi_scan_info), GFP_KERNEL);
 	if (!si)
-		return ERR_PTR(-ENOMEM);
+		return NULL;
 
 	INIT_LIST_HEAD(&si->corr);
 	INIT_LIST_HEAD(&si->free);
@@ -921,15 +916,20 @@ struct ubi_scan_info *ubi_scan(struct ubi_device *ubi)
 	INIT_LIST_HEAD(&si->alien);
 	si->volumes = RB_ROOT;
 	si->is_empty = 1;
+	return si;
+}
 
-	err = -ENOMEM;
-	ech = kzalloc(ubi->ec_hdr_alsize, GFP_KERNEL);
-	if (!ech)
-		goto out_si;
-
-	vidh = ubi_zalloc_vid_hdr(ubi, GFP_KERNEL);
-	if (!vidh)
-		goto out_ech;
+/**
+ * scan_all - read the headers of all physical eraseblocks.
+ * @ubi: UBI device description object
+ * @si: scanning information to fill
+ *
+ * This function returns zero in case of success and a negative error code in
+ * case of failure.
+ */
+static int scan_all(struct ubi_device *ubi, struct ubi_scan_info *si)
+{
+	int err, pnum;
 
 	for (pnum = 0; pnum < ubi->peb_count; pnum++) {
 		cond_resched();
@@ -937,10 +937,62 @@ struct ubi_scan_info *ubi_scan(struct ubi_device *ubi)
 		dbg_msg("process PEB %d", pnum);
 		err = process_eb(ubi, si, pnum);
 		if (err < 0)
-			goto out_vidh;
+			return err;
 	}
 
 	dbg_msg("scanning is finished");
+	return 0;
+}
+
+/**
+ * ubi_scan - scan an MTD device.
+ * @ubi: UBI device description object
+ *
+ * This function does full scanning of an MTD device and returns complete
+ * information about it. With fastmap support, the information is taken from
+ * the on-flash fastmap instead, if there is a valid one. In case of failure,
+ * an error code is returned.
+ */
+struct ubi_scan_info *ubi_scan(struct ubi_device *ubi)
+{
+	int err;
+	struct rb_node *rb1, *rb2;
+	struct ubi_scan_volume *sv;
+	struct ubi_scan_leb *seb;
+	struct ubi_scan_info *si;
+
+	si = alloc_si();
+	if (!si)
+		return ERR_PTR(-ENOMEM);
+
+	err = -ENOMEM;
+	ech = kzalloc(ubi->ec_hdr_alsize, GFP_KERNEL);
+	if (!ech)
+		goto out_si;
+
+	vidh = ubi_zalloc_vid_hdr(ubi, GFP_KERNEL);
+	if (!vidh)
+		goto out_ech;
+
+#ifdef CONFIG_MTD_UBI_FASTMAP
+	err = ubi_scan_fastmap(ubi, si);
+	if (err == UBI_BAD_FASTMAP) {
+		/* Start over with empty scanning information */
+		ubi_scan_destroy_si(si);
+		si = alloc_si();
+		if (!si) {
+			ubi_free_vid_hdr(ubi, vidh);
+			kfree(ech);
+			return ERR_PTR(-ENOMEM);
+		}
+	}
+	if (err > 0)
+		err = scan_all(ubi, si);
+#else
+	err = scan_all(ubi, si);
+#endif
+	if (err < 0)
+		goto out_vidh;
 
 	/* Calculate mean erase counter */
 	if (si->ec_count) {
@@ -978,6 +1030,9 @@ struct ubi_scan_info *ubi_scan(struct ubi_device *ubi)
 	if (err) {
 		if (err > 0)
 			err = -EINVAL;
+#ifdef CONFIG_MTD_UBI_FASTMAP
+		ubi_free_fastmap(ubi);
+#endif
 		goto out_vidh;
 	}
 
@@ -142,6 +142,34 @@ struct ubi_ltree_entry {
 
 struct ubi_volume_desc;
 
+#ifdef CONFIG_MTD_UBI_FASTMAP
+/*
+ * Return codes of the fastmap code.
+ *
+ * UBI_NO_FASTMAP: no fastmap super block was found
+ * UBI_BAD_FASTMAP: the fastmap is damaged or stale, the device has to be
+ * scanned
+ */
+enum {
+	UBI_NO_FASTMAP = 1,
+	UBI_BAD_FASTMAP,
+};
+
+/**
+ * struct ubi_fastmap_layout - the fastmap of an UBI device.
+ * @e: the wear-leveling entries of the physical eraseblocks holding the
+ *     fastmap, the super block first
+ * @used_blocks: how many physical eraseblocks the fastmap uses
+ *
+ * The physical eraseblocks of a valid on-flash fastmap are kept out of the
+ * WL unit. They are handed to it when the fastmap is invalidated.
+ */
+struct ubi_fastmap_layout {
+	struct ubi_wl_entry *e[UBI_FM_MAX_BLOCKS];
+	int used_blocks;
+};
+#endif
+
 /**
  * struct ubi_volume - UBI volume description data structure.
  * @dev: device object to make use of the the Linux device model
@@ -337,6 +365,8 @@ struct ubi_wl_entry;
  *               not
  * @mtd: MTD device descriptor
  *
+ * @fm: the on-flash fastmap matching the device, %NULL if there is none
+ *
  * @peb_buf1: a buffer of PEB size used for different purposes
  * @peb_buf2: another buffer of PEB size used for different purposes
  * @buf_mutex: proptects @peb_buf1 and @peb_buf2
@@ -416,6 +446,10 @@ struct ubi_device {
 	int bad_allowed;
 	struct mtd_info *mtd;
 
+#ifdef CONFIG_MTD_UBI_FASTMAP
+	struct ubi_fastmap_layout *fm;
+#endif
+
 	void *peb_buf1;
 	void *peb_buf2;
 	struct mutex buf_mutex;
@@ -496,6 +530,16 @@ int ubi_wl_scrub_peb(struct ubi_device *ubi, int pnum);
 int ubi_wl_init_scan(struct ubi_device *ubi, struct ubi_scan_info *si);
 void ubi_wl_close(struct ubi_device *ubi);
 int ubi_thread(void *u);
+#ifdef CONFIG_MTD_UBI_FASTMAP
+struct ubi_wl_entry *ubi_wl_get_fm_peb(struct ubi_device *ubi, int max_pnum);
+void ubi_wl_put_fm_peb(struct ubi_device *ubi, struct ubi_wl_entry *e);
+
+/* fastmap.c */
+int ubi_scan_fastmap(struct ubi_device *ubi, struct ubi_scan_info *si);
+int ubi_update_fastmap(struct ubi_device *ubi);
+int ubi_invalidate_fastmap(struct ubi_device *ubi);
+void ubi_free_fastmap(struct ubi_device *ubi);
+#endif
 
 /* io.c */
 int ubi_io_read(const struct ubi_device *ubi, void *buf, int pnum, int offset,
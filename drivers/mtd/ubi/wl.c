@@ -459,6 +459,18 @@ int ubi_wl_get_peb(struct ubi_device *ubi, int dtype)
 retry:
 	spin_lock(&ubi->wl_lock);
 	if (!ubi->free.rb_node) {
+#ifdef CONFIG_MTD_UBI_FASTMAP
+		if (ubi->fm) {
+			/* Give up the fastmap to get its eraseblocks back */
+			spin_unlock(&ubi->wl_lock);
+			err = ubi_invalidate_fastmap(ubi);
+			if (err) {
+				kfree(pe);
+				return err;
+			}
+			goto retry;
+		}
+#endif
 		if (ubi->works_count == 0) {
 			ubi_assert(list_empty(&ubi->works));
 			ubi_err("no free eraseblocks");
@@ -539,6 +551,53 @@ retry:
 	return e->pnum;
 }
 
+#ifdef CONFIG_MTD_UBI_FASTMAP
+/**
+ * ubi_wl_get_fm_peb - get a physical eraseblock for the fastmap.
+ * @ubi: UBI device description object
+ * @max_pnum: the physical eraseblock number has to be lower than this
+ *
+ * This function takes the least worn out free physical eraseblock below
+ * @max_pnum out of the WL unit and returns its wear-leveling entry, or %NULL
+ * if there is none. The physical eraseblock stays outside of the WL unit
+ * until it is given back by 'ubi_wl_put_fm_peb()'.
+ */
+struct ubi_wl_entry *ubi_wl_get_fm_peb(struct ubi_device *ubi, int max_pnum)
+{
+	struct rb_node *rb;
+	struct ubi_wl_entry *e;
+
+	spin_lock(&ubi->wl_lock);
+	ubi_rb_for_each_entry(rb, e, &ubi->free, rb) {
+		if (e->pnum < max_pnum) {
+			rb_erase(&e->rb, &ubi->free);
+			ubi->lookuptbl[e->pnum] = NULL;
+			spin_unlock(&ubi->wl_lock);
+			return e;
+		}
+	}
+	spin_unlock(&ubi->wl_lock);
+
+	return NULL;
+}
+
+/**
+ * ubi_wl_put_fm_peb - give a fastmap physical eraseblock back.
+ * @ubi: UBI device description object
+ * @e: the wear-leveling entry of the physical eraseblock
+ *
+ * The physical eraseblock has to be erased and to have an erase counter
+ * header already, it is added to the free tree.
+ */
+void ubi_wl_put_fm_peb(struct ubi_device *ubi, struct ubi_wl_entry *e)
+{
+	spin_lock(&ubi->wl_lock);
+	ubi->lookuptbl[e->pnum] = e;
+	wl_tree_add(e, &ubi->free);
+	spin_unlock(&ubi->wl_lock);
+}
+#endif
+
 /**
  * prot_tree_del - remove a physical eraseblock from the protection trees
  * @ubi: UBI device description object
@@ -1132,6 +1191,7 @@ static int erase_worker(struct ubi_device *ubi, struct ubi_work *wl_wrk,
 	ubi->beb_rsvd_pebs -= 1;
 	ubi->bad_peb_count += 1;
 	ubi->good_peb_count -= 1;
+	ubi->lookuptbl[pnum] = NULL;
 	ubi_calculate_reserved(ubi);
 	if (ubi->beb_rsvd_pebs == 0)
 		ubi_warn("last PEB from the reserved pool was used");
@@ -44,6 +44,56 @@ struct cramfs_super super;
 extern flash_info_t flash_info[];
 #define PART_OFFSET(x)	(x->offset + flash_info[x->dev->id->num].start[0])
 
+/*
+ * Name lookups are remembered per directory, so that loading files from
+ * the same directories again and again doesn't scan the directories on
+ * flash each time. Symlink targets (the only compressed metadata) are
+ * kept decompressed in a small page cache. Both caches are dropped when
+ * a different superblock is found.
+ */
+#ifndef CONFIG_CRAMFS_DENTRY_CACHE_ENTRIES
+#define CONFIG_CRAMFS_DENTRY_CACHE_ENTRIES	16
+#endif
+#ifndef CONFIG_CRAMFS_PAGE_CACHE_ENTRIES
+#define CONFIG_CRAMFS_PAGE_CACHE_ENTRIES	2
+#endif
+
+/* Longer names are not cached */
+#define CRAMFS_DENTRY_NAME_LEN	32
+
+static struct {
+	unsigned long	dir;		/* Offset of the directory entries */
+	unsigned long	inode;		/* Offset of the inode found */
+	unsigned int	used;		/* LRU stamp, 0 if unused */
+	char		name[CRAMFS_DENTRY_NAME_LEN];
+} dentry_cache[CONFIG_CRAMFS_DENTRY_CACHE_ENTRIES];
+
+static struct {
+	unsigned long	start;		/* Offset of the compressed block */
+	int		len;		/* Decompressed length */
+	unsigned int	used;		/* LRU stamp, 0 if unused */
+	char		data[2 * CRAMFS_BLKSIZE];
+} page_cache[CONFIG_CRAMFS_PAGE_CACHE_ENTRIES];
+
+/* Holes have no stored block to key a cache entry on */
+static const char zero_page[CRAMFS_BLKSIZE];
+
+static unsigned int cache_clock;
+static unsigned long cache_begin;
+static struct cramfs_super cache_super;
+
+static void cramfs_cache_check (unsigned long begin)
+{
+	if (begin == cache_begin &&
+	    memcmp (&super, &cache_super, sizeof (super)) == 0)
+		return;
+
+	memset (dentry_cache, 0, sizeof (dentry_cache));
+	memset (page_cache, 0, sizeof (page_cache));
+	cache_begin = begin;
+	memcpy (&cache_super, &super, sizeof (super));
+}
+
 static int cramfs_read_super (struct part_info *info)
 {
 	unsigned long root_offset;
@@ -86,22 +136,156 @@ static int cramfs_read_super (struct part_info *info)
 		return -1;
 	}
 
+	cramfs_cache_check (PART_OFFSET(info));
 	return 0;
 }
 
-static unsigned long cramfs_resolve (unsigned long begin, unsigned long offset,
-				     unsigned long size, int raw,
-				     char *filename)
+/*
+ * Locate block 'i' of the file 'inode': set 'start' to its offset in
+ * the image at 'begin' and 'len' to its stored length (0 for a hole).
+ * Return 1 if it is stored uncompressed, 0 if compressed, -1 on errors.
+ */
+static int cramfs_block (unsigned long begin, struct cramfs_inode *inode,
+			 unsigned long i, unsigned long *start,
+			 unsigned long *len)
 {
-	unsigned long inodeoffset = 0, nextoffset;
+	u32 *block_ptrs = (u32 *) (begin + (CRAMFS_GET_OFFSET (inode) << 2));
+	unsigned long size = CRAMFS_24 (inode->size);
+	unsigned long nblocks = (size + CRAMFS_BLKSIZE - 1) / CRAMFS_BLKSIZE;
+	u32 ptr = CRAMFS_32 (block_ptrs[i]);
+	u32 prev;
+
+	if (!(super.flags & CRAMFS_FLAG_EXT_BLOCK_POINTERS)) {
+		/* Block pointers hold the end of each block */
+		if (i == 0)
+			*start = (CRAMFS_GET_OFFSET (inode) << 2) + nblocks * 4;
+		else
+			*start = CRAMFS_32 (block_ptrs[i - 1]);
+		*len = ptr - *start;
+		return *len > 2 * CRAMFS_BLKSIZE ? -1 : 0;
+	}
+
+	if (ptr & CRAMFS_BLK_FLAG_DIRECT_PTR) {
+		*start = (ptr & ~CRAMFS_BLK_FLAGS) << CRAMFS_BLK_DIRECT_PTR_SHIFT;
+		if (ptr & CRAMFS_BLK_FLAG_UNCOMPRESSED) {
+			*len = min (size - i * CRAMFS_BLKSIZE,
+				    (unsigned long) CRAMFS_BLKSIZE);
+			return 1;
+		}
+		*len = CRAMFS_16 (*(u16 *) (begin + *start));
+		*start += 2;
+		return *len > 2 * CRAMFS_BLKSIZE ? -1 : 0;
+	}
+
+	/* The block starts where the previous one ends */
+	if (i == 0) {
+		*start = (CRAMFS_GET_OFFSET (inode) << 2) + nblocks * 4;
+	} else {
+		prev = CRAMFS_32 (block_ptrs[i - 1]);
+		if (prev & CRAMFS_BLK_FLAG_DIRECT_PTR) {
+			*start = (prev & ~CRAMFS_BLK_FLAGS) <<
+				CRAMFS_BLK_DIRECT_PTR_SHIFT;
+			if (prev & CRAMFS_BLK_FLAG_UNCOMPRESSED)
+				*start += CRAMFS_BLKSIZE;
+			else
+				*start += 2 + CRAMFS_16 (*(u16 *)
+							 (begin + *start));
+		} else {
+			*start = prev & ~CRAMFS_BLK_FLAGS;
+		}
+	}
+	*len = (ptr & ~CRAMFS_BLK_FLAGS) - *start;
+	if (ptr & CRAMFS_BLK_FLAG_UNCOMPRESSED)
+		return *len > CRAMFS_BLKSIZE ? -1 : 1;
+	return *len > 2 * CRAMFS_BLKSIZE ? -1 : 0;
+}
+
+/*
+ * Return block 'i' of the file 'inode' decompressed and set 'len' to
+ * its length. Uncompressed blocks are returned in place, holes as
+ * zero_page, compressed blocks through the page cache. NULL on errors.
+ */
+static char *cramfs_read_page (unsigned long begin,
+			       struct cramfs_inode *inode, unsigned long i,
+			       int *len)
+{
+	unsigned long start, slen;
+	int j, victim = 0;
+
+	switch (cramfs_block (begin, inode, i, &start, &slen)) {
+	case 1:
+		*len = slen;
+		return (char *) (begin + start);
+	case 0:
+		break;
+	default:
+		return NULL;
+	}
+
+	if (slen == 0) {
+		*len = min (CRAMFS_24 (inode->size) - i * CRAMFS_BLKSIZE,
+			    (unsigned long) CRAMFS_BLKSIZE);
+		return (char *) zero_page;
+	}
+
+	for (j = 0; j < CONFIG_CRAMFS_PAGE_CACHE_ENTRIES; j++) {
+		if (page_cache[j].used && page_cache[j].start == start) {
+			page_cache[j].used = ++cache_clock;
+			*len = page_cache[j].len;
+			return page_cache[j].data;
+		}
+		if (page_cache[j].used < page_cache[victim].used)
+			victim = j;
+	}
+
+	if (cramfs_uncompress_init ())
+		return NULL;
+	*len = cramfs_uncompress_block (page_cache[victim].data,
+					(void *) (begin + start), slen);
+	cramfs_uncompress_exit ();
+	if (*len < 0) {
+		page_cache[victim].used = 0;
+		return NULL;
+	}
+	page_cache[victim].start = start;
+	page_cache[victim].len = *len;
+	page_cache[victim].used = ++cache_clock;
+	return page_cache[victim].data;
+}
+
+/*
+ * Find 'name' in the directory whose entries are at 'offset' (length
+ * 'size') in the image at 'begin'. Return the offset of its inode, 0
+ * if there is no such entry.
+ */
+static unsigned long cramfs_lookup (unsigned long begin, unsigned long offset,
+				    unsigned long size, const char *name)
+{
+	unsigned long inodeoffset = 0, found;
+	int len = strlen (name);
+	int i, victim = 0, cmp;
+
+	if (len < CRAMFS_DENTRY_NAME_LEN) {
+		for (i = 0; i < CONFIG_CRAMFS_DENTRY_CACHE_ENTRIES; i++) {
+			if (dentry_cache[i].used &&
+			    dentry_cache[i].dir == offset &&
+			    !strcmp (dentry_cache[i].name, name)) {
+				dentry_cache[i].used = ++cache_clock;
+				return dentry_cache[i].inode;
+			}
+			if (dentry_cache[i].used < dentry_cache[victim].used)
+				victim = i;
+		}
+	}
 
 	while (inodeoffset < size) {
 		struct cramfs_inode *inode;
-		char *name;
+		char *ename;
 		int namelen;
 
 		inode = (struct cramfs_inode *) (begin + offset +
 						 inodeoffset);
+		found = offset + inodeoffset;
 
 		/*
 		 * Namelengths on disk are shifted by two
@@ -109,43 +293,66 @@ static unsigned long cramfs_resolve (unsigned long begin, unsigned long offset,
 		 * with zeroes.
 		 */
 		namelen = CRAMFS_GET_NAMELEN (inode) << 2;
-		name = (char *) inode + sizeof (struct cramfs_inode);
+		ename = (char *) inode + sizeof (struct cramfs_inode);
 
-		nextoffset =
-			inodeoffset + sizeof (struct cramfs_inode) + namelen;
+		inodeoffset += sizeof (struct cramfs_inode) + namelen;
 
 		for (;;) {
 			if (!namelen)
-				return -1;
-			if (name[namelen - 1])
+				return 0;
+			if (ename[namelen - 1])
 				break;
 			namelen--;
 		}
 
-		if (!strncmp (filename, name, namelen)) {
-			char *p = strtok (NULL, "/");
-
-			if (raw && (p == NULL || *p == '\0'))
-				return offset + inodeoffset;
-
-			if (S_ISDIR (CRAMFS_16 (inode->mode))) {
-				return cramfs_resolve (begin,
-						       CRAMFS_GET_OFFSET
-						       (inode) << 2,
-						       CRAMFS_24 (inode->
-								  size), raw,
-						       p);
-			} else if (S_ISREG (CRAMFS_16 (inode->mode))) {
-				return offset + inodeoffset;
-			} else {
-				printf ("%*.*s: unsupported file type (%x)\n",
-					namelen, namelen, name,
-					CRAMFS_16 (inode->mode));
-				return 0;
+		cmp = strncmp (name, ename, namelen);
+		if (cmp == 0 && len == namelen) {
+			if (len < CRAMFS_DENTRY_NAME_LEN) {
+				dentry_cache[victim].dir = offset;
+				dentry_cache[victim].inode = found;
+				strcpy (dentry_cache[victim].name, name);
+				dentry_cache[victim].used = ++cache_clock;
 			}
+			return found;
 		}
+		/* Sorted directories can stop at the first larger name */
+		if (cmp < 0 && (super.flags & CRAMFS_FLAG_SORTED_DIRS))
+			break;
+	}
 
-		inodeoffset = nextoffset;
+	return 0;
+}
+
+static unsigned long cramfs_resolve (unsigned long begin, unsigned long offset,
+				     unsigned long size, int raw,
+				     char *filename)
+{
+	unsigned long inodeoffset;
+	struct cramfs_inode *inode;
+	char *p;
+
+	while (filename != NULL) {
+		inodeoffset = cramfs_lookup (begin, offset, size, filename);
+		if (inodeoffset == 0)
+			break;
+
+		inode = (struct cramfs_inode *) (begin + inodeoffset);
+		p = strtok (NULL, "/");
+
+		if (raw && (p == NULL || *p == '\0'))
+			return inodeoffset;
+
+		if (S_ISDIR (CRAMFS_16 (inode->mode)) && p != NULL) {
+			offset = CRAMFS_GET_OFFSET (inode) << 2;
+			size = CRAMFS_24 (inode->size);
+			filename = p;
+		} else if (S_ISREG (CRAMFS_16 (inode->mode))) {
+			return inodeoffset;
+		} else {
+			printf ("%s: unsupported file type (%x)\n",
+				filename, CRAMFS_16 (inode->mode));
+			return 0;
+		}
 	}
 
 	printf ("can't find corresponding entry\n");
@@ -156,30 +363,54 @@ static int cramfs_uncompress (unsigned long begin, unsigned long offset,
 			      unsigned long loadoffset)
 {
 	struct cramfs_inode *inode = (struct cramfs_inode *) (begin + offset);
-	unsigned long *block_ptrs = (unsigned long *)
-		(begin + (CRAMFS_GET_OFFSET (inode) << 2));
-	unsigned long curr_block = (CRAMFS_GET_OFFSET (inode) +
-				    (((CRAMFS_24 (inode->size)) +
-				      4095) >> 12)) << 2;
-	int size, total_size = 0;
-	int i;
-
-	cramfs_uncompress_init ();
-
-	for (i = 0; i < ((CRAMFS_24 (inode->size) + 4095) >> 12); i++) {
-		size = cramfs_uncompress_block ((void *) loadoffset,
-						(void *) (begin + curr_block),
-						(CRAMFS_32 (block_ptrs[i]) -
-						 curr_block));
-		if (size < 0)
-			return size;
-		loadoffset += size;
-		total_size += size;
-		curr_block = CRAMFS_32 (block_ptrs[i]);
+	unsigned long size = CRAMFS_24 (inode->size);
+	unsigned long nblocks = (size + CRAMFS_BLKSIZE - 1) / CRAMFS_BLKSIZE;
+	unsigned long i, j, start, len, next, nlen;
+	int type, total_size = 0, zinit = 0;
+	int ret = -1;
+
+	for (i = 0; i < nblocks; i = j) {
+		j = i + 1;
+		type = cramfs_block (begin, inode, i, &start, &len);
+		if (type < 0)
+			goto out;
+
+		if (len == 0) {
+			/* A hole */
+			len = min (size - i * CRAMFS_BLKSIZE,
+				   (unsigned long) CRAMFS_BLKSIZE);
+			memset ((void *) loadoffset, 0, len);
+		} else if (type == 1) {
+			/* Copy runs of uncompressed blocks in one go */
+			while (j < nblocks &&
+			       cramfs_block (begin, inode, j, &next, &nlen) == 1 &&
+			       nlen != 0 && next == start + len) {
+				len += nlen;
+				j++;
+			}
+			memcpy ((void *) loadoffset, (void *) (begin + start),
+				len);
+		} else {
+			if (!zinit) {
+				if (cramfs_uncompress_init ())
+					return -1;
+				zinit = 1;
+			}
+			len = cramfs_uncompress_block ((void *) loadoffset,
+						       (void *) (begin + start),
+						       len);
+			if ((long) len < 0)
+				goto out;
+		}
+		loadoffset += len;
+		total_size += len;
 	}
+	ret = total_size;
 
-	cramfs_uncompress_exit ();
-	return total_size;
+out:
+	if (zinit)
+		cramfs_uncompress_exit ();
+	return ret;
 }
 
 int cramfs_load (char *loadoffset, struct part_info *info, char *filename)
@@ -201,6 +432,43 @@ int cramfs_load (char *loadoffset, struct part_info *info, char *filename)
 				  (unsigned long) loadoffset);
 }
 
+/*
+ * Find where 'filename' is in flash if it is stored uncompressed and in
+ * one piece, so that it can be used in place (XIP) instead of loading
+ * it. Set 'addr' and return its size, or -1 if it can't be mapped.
+ */
+int cramfs_map (struct part_info *info, char *filename, ulong *addr)
+{
+	struct cramfs_inode *inode;
+	unsigned long offset, size, nblocks, i, start, first = 0, len;
+
+	if (cramfs_read_super (info))
+		return -1;
+
+	offset = cramfs_resolve (PART_OFFSET(info),
+				 CRAMFS_GET_OFFSET (&(super.root)) << 2,
+				 CRAMFS_24 (super.root.size), 0,
+				 strtok (filename, "/"));
+	if (offset <= 0)
+		return -1;
+
+	inode = (struct cramfs_inode *) (PART_OFFSET(info) + offset);
+	size = CRAMFS_24 (inode->size);
+	nblocks = (size + CRAMFS_BLKSIZE - 1) / CRAMFS_BLKSIZE;
+	for (i = 0; i < nblocks; i++) {
+		if (cramfs_block (PART_OFFSET(info), inode, i, &start,
+				  &len) != 1 || len == 0)
+			return -1;
+		if (i == 0)
+			first = start;
+		else if (start != first + i * CRAMFS_BLKSIZE)
+			return -1;
+	}
+
+	*addr = PART_OFFSET(info) + first;
+	return size;
+}
+
 static int cramfs_list_inode (struct part_info *info, unsigned long offset)
 {
 	struct cramfs_inode *inode = (struct cramfs_inode *)
@@ -232,17 +500,15 @@ static int cramfs_list_inode (struct part_info *info, unsigned long offset)
 		/* symbolic link.
 		 * Unpack the link target, trusting in the inode's size field.
 		 */
-		unsigned long size = CRAMFS_24 (inode->size);
-		char *link = malloc (size);
+		int size = CRAMFS_24 (inode->size);
+		int len;
+		char *link = cramfs_read_page (PART_OFFSET(info), inode, 0,
+					       &len);
 
-		if (link != NULL && cramfs_uncompress (PART_OFFSET(info), offset,
-						       (unsigned long) link)
-		    == size)
-			printf (" -> %*.*s\n", (int) size, (int) size, link);
+		if (link != NULL && len == size)
+			printf (" -> %*.*s\n", size, size, link);
 		else
 			printf (" [Error reading link]\n");
-		if (link)
-			free (link);
 	} else
 		printf ("\n");
 
@@ -30,10 +30,17 @@
 
 static block_dev_desc_t *ext2fs_block_dev_desc;
 static disk_partition_t part_info;
+static int ext2fs_part;
 
 int ext2fs_set_blk_dev (block_dev_desc_t * rbdd, int part)
 {
 	ext2fs_block_dev_desc = rbdd;
+	ext2fs_part = part;
+
+	/* A mounted partition needs no partition table read */
+	if (ext2fs_mounted_part (rbdd, part, &part_info)) {
+		return (part_info.size);
+	}
 
 	if (part == 0) {
 		/* disk doesn't use partition table */
@@ -50,6 +57,16 @@ int ext2fs_set_blk_dev (block_dev_desc_t * rbdd, int part)
 }
 
 
+/* Return the device, partition number and partition information set by
+   ext2fs_set_blk_dev() */
+block_dev_desc_t *ext2fs_get_blk_dev (int *part, disk_partition_t *info)
+{
+	*part = ext2fs_part;
+	memcpy (info, &part_info, sizeof (disk_partition_t));
+	return (ext2fs_block_dev_desc);
+}
+
+
 int ext2fs_devread (int sector, int byte_offset, int byte_len, char *buf) {
 	char sec_buf[SECTOR_SIZE];
 	unsigned block_len;
@@ -80,10 +97,9 @@ int ext2fs_devread (int sector, int byte_offset, int byte_len, char *buf) {
 
 	if (byte_offset != 0) {
 		/* read first part which isn't aligned with start of sector */
-		if (ext2fs_block_dev_desc->
-		    block_read (ext2fs_block_dev_desc->dev,
-				part_info.start + sector, 1,
-				(unsigned long *) sec_buf) != 1) {
+		if (blk_dread (ext2fs_block_dev_desc,
+			       part_info.start + sector, 1,
+			       (unsigned long *) sec_buf) != 1) {
 			printf (" ** ext2fs_devread() read error **\n");
 			return (0);
 		}
@@ -104,17 +120,16 @@ int ext2fs_devread (int sector, int byte_offset, int byte_len, char *buf) {
 		u8 p[SECTOR_SIZE];
 
 		block_len = SECTOR_SIZE;
-		ext2fs_block_dev_desc->block_read(ext2fs_block_dev_desc->dev,
-						  part_info.start + sector,
-						  1, (unsigned long *)p);
+		blk_dread(ext2fs_block_dev_desc, part_info.start + sector,
+			  1, (unsigned long *)p);
 		memcpy(buf, p, byte_len);
 		return 1;
 	}
 
-	if (ext2fs_block_dev_desc->block_read (ext2fs_block_dev_desc->dev,
-					       part_info.start + sector,
-					       block_len / SECTOR_SIZE,
-					       (unsigned long *) buf) !=
+	if (blk_dread (ext2fs_block_dev_desc,
+		       part_info.start + sector,
+		       block_len / SECTOR_SIZE,
+		       (unsigned long *) buf) !=
 	    block_len / SECTOR_SIZE) {
 		printf (" ** ext2fs_devread() read error - block\n");
 		return (0);
@@ -126,10 +141,9 @@ int ext2fs_devread (int sector, int byte_offset, int byte_len, char *buf) {
 
 	if (byte_len != 0) {
 		/* read rest of data which are not in whole sector */
-		if (ext2fs_block_dev_desc->
-		    block_read (ext2fs_block_dev_desc->dev,
-				part_info.start + sector, 1,
-				(unsigned long *) sec_buf) != 1) {
+		if (blk_dread (ext2fs_block_dev_desc,
+			       part_info.start + sector, 1,
+			       (unsigned long *) sec_buf) != 1) {
 			printf (" ** ext2fs_devread() read error - last part\n");
 			return (0);
 		}
@@ -0,0 +1,223 @@
+/*
+ * Directory index (htree) hash functions for the ext2/3/4 filesystem
+ *
+ * Based on fs/ext3/hash.c from the Linux kernel:
+ *  Copyright (C) 2002 by Theodore Ts'o
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#include <common.h>
+
+/* Hash versions, as stored in the dx_root of a directory.  The unsigned
+   variants are selected by the superblock flags.  */
+#define DX_HASH_LEGACY			0
+#define DX_HASH_HALF_MD4		1
+#define DX_HASH_TEA			2
+#define DX_HASH_LEGACY_UNSIGNED		3
+#define DX_HASH_HALF_MD4_UNSIGNED	4
+#define DX_HASH_TEA_UNSIGNED		5
+
+#define DELTA 0x9E3779B9
+
+static void tea_transform (uint32_t buf[2], const uint32_t in[4])
+{
+	uint32_t sum = 0;
+	uint32_t b0 = buf[0], b1 = buf[1];
+	uint32_t a = in[0], b = in[1], c = in[2], d = in[3];
+	int n = 16;
+
+	do {
+		sum += DELTA;
+		b0 += ((b1 << 4) + a) ^ (b1 + sum) ^ ((b1 >> 5) + b);
+		b1 += ((b0 << 4) + c) ^ (b0 + sum) ^ ((b0 >> 5) + d);
+	} while (--n);
+
+	buf[0] += b0;
+	buf[1] += b1;
+}
+
+/* F, G and H are basic MD4 functions: selection, majority, parity */
+#define F(x, y, z) ((z) ^ ((x) & ((y) ^ (z))))
+#define G(x, y, z) (((x) & (y)) + (((x) ^ (y)) & (z)))
+#define H(x, y, z) ((x) ^ (y) ^ (z))
+
+#define ROL32(x, s) (((x) << (s)) | ((x) >> (32 - (s))))
+#define MD4_ROUND(f, a, b, c, d, x, s)	\
+	(a += f(b, c, d) + x, a = ROL32(a, s))
+#define K1 0
+#define K2 013240474631UL
+#define K3 015666365641UL
+
+/* Basic cut-down MD4 transform */
+static void half_md4_transform (uint32_t buf[4], const uint32_t in[8])
+{
+	uint32_t a = buf[0], b = buf[1], c = buf[2], d = buf[3];
+
+	/* Round 1 */
+	MD4_ROUND(F, a, b, c, d, in[0] + K1,  3);
+	MD4_ROUND(F, d, a, b, c, in[1] + K1,  7);
+	MD4_ROUND(F, c, d, a, b, in[2] + K1, 11);
+	MD4_ROUND(F, b, c, d, a, in[3] + K1, 19);
+	MD4_ROUND(F, a, b, c, d, in[4] + K1,  3);
+	MD4_ROUND(F, d, a, b, c, in[5] + K1,  7);
+	MD4_ROUND(F, c, d, a, b, in[6] + K1, 11);
+	MD4_ROUND(F, b, c, d, a, in[7] + K1, 19);
+
+	/* Round 2 */
+	MD4_ROUND(G, a, b, c, d, in[1] + K2,  3);
+	MD4_ROUND(G, d, a, b, c, in[3] + K2,  5);
+	MD4_ROUND(G, c, d, a, b, in[5] + K2,  9);
+	MD4_ROUND(G, b, c, d, a, in[7] + K2, 13);
+	MD4_ROUND(G, a, b, c, d, in[0] + K2,  3);
+	MD4_ROUND(G, d, a, b, c, in[2] + K2,  5);
+	MD4_ROUND(G, c, d, a, b, in[4] + K2,  9);
+	MD4_ROUND(G, b, c, d, a, in[6] + K2, 13);
+
+	/* Round 3 */
+	MD4_ROUND(H, a, b, c, d, in[3] + K3,  3);
+	MD4_ROUND(H, d, a, b, c, in[7] + K3,  9);
+	MD4_ROUND(H, c, d, a, b, in[2] + K3, 11);
+	MD4_ROUND(H, b, c, d, a, in[6] + K3, 15);
+	MD4_ROUND(H, a, b, c, d, in[1] + K3,  3);
+	MD4_ROUND(H, d, a, b, c, in[5] + K3,  9);
+	MD4_ROUND(H, c, d, a, b, in[0] + K3, 11);
+	MD4_ROUND(H, b, c, d, a, in[4] + K3, 15);
+
+	buf[0] += a;
+	buf[1] += b;
+	buf[2] += c;
+	buf[3] += d;
+}
+
+/* The old legacy hash */
+static uint32_t dx_hack_hash (const char *name, int len, int unsigned_char)
+{
+	uint32_t hash, hash0 = 0x12a3fe2d, hash1 = 0x37abe8f9;
+	int c;
+
+	while (len--) {
+		if (unsigned_char)
+			c = (unsigned char) *name++;
+		else
+			c = (signed char) *name++;
+		hash = hash1 + (hash0 ^ (c * 7152373));
+
+		if (hash & 0x80000000)
+			hash -= 0x7fffffff;
+		hash1 = hash0;
+		hash0 = hash;
+	}
+	return hash0 << 1;
+}
+
+static void str2hashbuf (const char *msg, int len, uint32_t *buf, int num,
+			 int unsigned_char)
+{
+	uint32_t pad, val;
+	int i, c;
+
+	pad = (uint32_t)len | ((uint32_t)len << 8);
+	pad |= pad << 16;
+
+	val = pad;
+	if (len > num * 4)
+		len = num * 4;
+	for (i = 0; i < len; i++) {
+		if (unsigned_char)
+			c = (unsigned char) msg[i];
+		else
+			c = (signed char) msg[i];
+		val = c + (val << 8);
+		if ((i % 4) == 3) {
+			*buf++ = val;
+			val = pad;
+			num--;
+		}
+	}
+	if (--num >= 0)
+		*buf++ = val;
+	while (--num >= 0)
+		*buf++ = pad;
+}
+
+/*
+ * Return the major hash of 'name' for directory index lookups.
+ * 'seed' is the superblock hash seed in CPU byte order; an all zero
+ * seed selects the default one. Returns 0 for unknown hash versions.
+ */
+uint32_t ext2fs_dirhash (const char *name, int len, int version,
+			 const uint32_t *seed)
+{
+	uint32_t hash;
+	uint32_t buf[4];
+	uint32_t in[8];
+	int unsigned_char = 0;
+	int i;
+
+	/* Initialize the default seed for the hash checksum functions */
+	buf[0] = 0x67452301;
+	buf[1] = 0xefcdab89;
+	buf[2] = 0x98badcfe;
+	buf[3] = 0x10325476;
+
+	for (i = 0; i < 4; i++) {
+		if (seed[i])
+			break;
+	}
+	if (i < 4)
+		memcpy(buf, seed, sizeof(buf));
+
+	switch (version) {
+	case DX_HASH_LEGACY_UNSIGNED:
+		unsigned_char = 1;
+		/* Fall through */
+	case DX_HASH_LEGACY:
+		hash = dx_hack_hash(name, len, unsigned_char);
+		break;
+	case DX_HASH_HALF_MD4_UNSIGNED:
+		unsigned_char = 1;
+		/* Fall through */
+	case DX_HASH_HALF_MD4:
+		while (len > 0) {
+			str2hashbuf(name, len, in, 8, unsigned_char);
+			half_md4_transform(buf, in);
+			len -= 32;
+			name += 32;
+		}
+		hash = buf[1];
+		break;
+	case DX_HASH_TEA_UNSIGNED:
+		unsigned_char = 1;
+		/* Fall through */
+	case DX_HASH_TEA:
+		while (len > 0) {
+			str2hashbuf(name, len, in, 4, unsigned_char);
+			tea_transform(buf, in);
+			len -= 16;
+			name += 16;
+		}
+		hash = buf[0];
+		break;
+	default:
+		return 0;
+	}
+
+	hash &= ~1;
+	if (hash == (0x7fffffffU << 1))
+		hash = (0x7fffffffU - 1) << 1;
+
+	return hash;
+}
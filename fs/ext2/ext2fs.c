@@ -30,6 +30,10 @@
 
 extern int ext2fs_devread (int sector, int byte_offset, int byte_len,
 			   char *buf);
+extern block_dev_desc_t *ext2fs_get_blk_dev (int *part,
+					     disk_partition_t *info);
+extern uint32_t ext2fs_dirhash (const char *name, int len, int version,
+				const uint32_t *seed);
 
 /* Magic value used to identify an ext2 filesystem.  */
 #define	EXT2_MAGIC		0xEF53
@@ -101,8 +105,42 @@ struct ext2_sblock {
 	char volume_name[16];
 	char last_mounted_on[64];
 	uint32_t compression_info;
+	uint8_t prealloc_blocks;
+	uint8_t prealloc_dir_blocks;
+	uint16_t reserved_gdt_blocks;
+	uint8_t journal_uuid[16];
+	uint32_t journal_inode;
+	uint32_t journal_dev;
+	uint32_t last_orphan;
+	uint32_t hash_seed[4];
+	uint8_t default_hash_version;
+	uint8_t journal_backup_type;
+	uint16_t descriptor_size;
+	uint32_t default_mount_options;
+	uint32_t first_meta_block_group;
+	uint32_t mkfs_time;
+	uint32_t journal_blocks[17];
+	uint32_t total_blocks_high;
+	uint32_t reserved_blocks_high;
+	uint32_t free_blocks_high;
+	uint16_t min_extra_inode_size;
+	uint16_t want_extra_inode_size;
+	uint32_t flags;
 };
 
+/* Compatible feature flags.  */
+#define EXT2_FEATURE_COMPAT_DIR_INDEX	0x0020
+
+/* Superblock flags.  */
+#define EXT2_FLAGS_UNSIGNED_HASH	0x0002
+
+/* Incompatible feature flags.  */
+#define EXT4_FEATURE_INCOMPAT_EXTENTS	0x0040
+#define EXT4_FEATURE_INCOMPAT_64BIT	0x0080
+
+/* Size of a group descriptor without the 64bit feature.  */
+#define EXT2_MIN_DESC_SIZE		32
+
 /* The ext2 blockgroup.  */
 struct ext2_block_group {
 	uint32_t block_id;
@@ -144,6 +182,42 @@ struct ext2_inode {
 	uint32_t osd2[3];
 };
 
+/* Inode flag: the directory has a hashed index (htree).  */
+#define EXT2_INDEX_FL			0x00001000
+
+/* Inode flag: the block map is an ext4 extent tree.  */
+#define EXT4_EXTENTS_FL			0x00080000
+
+/* Extent tree, stored in place of the block map (inode.b).  */
+#define EXT4_EXT_MAGIC			0xF30A
+#define EXT4_EXT_MAX_DEPTH		5
+/* Extents longer than this are allocated but not written yet.  */
+#define EXT4_EXT_INIT_MAX_LEN		32768
+
+struct ext4_extent_header {
+	uint16_t magic;
+	uint16_t entries;
+	uint16_t max;
+	uint16_t depth;		/* 0 for leaf nodes */
+	uint32_t generation;
+};
+
+/* Leaf node entry: a run of blocks.  */
+struct ext4_extent {
+	uint32_t block;		/* First logical block */
+	uint16_t len;
+	uint16_t start_hi;
+	uint32_t start;		/* First physical block */
+};
+
+/* Index node entry: points to the next level of the tree.  */
+struct ext4_extent_idx {
+	uint32_t block;		/* First logical block covered */
+	uint32_t leaf;		/* Physical block of the child node */
+	uint16_t leaf_hi;
+	uint16_t unused;
+};
+
 /* The header of an ext2 directory entry.  */
 struct ext2_dirent {
 	uint32_t inode;
@@ -152,6 +226,44 @@ struct ext2_dirent {
 	uint8_t filetype;
 };
 
+/* Hashed directory index.  Block 0 of an indexed directory holds the
+   "." and ".." entries, the latter covering the rest of the block, and
+   behind them the root info and the first level of index entries.
+   Lower index levels are blocks with a single empty directory entry
+   covering the whole block, followed by the index entries.  */
+#define EXT2_DX_ROOT_INFO_OFFSET	24
+#define EXT2_DX_NODE_OFFSET		8
+#define EXT2_DX_MAX_LEVELS		2
+/* The top bits of an index entry block number are reserved.  */
+#define EXT2_DX_BLOCK(blk)		(__le32_to_cpu (blk) & 0x0fffffff)
+
+/* Directory index hash versions, see dirhash.c.  The unsigned variants
+   follow the signed ones.  */
+#define DX_HASH_TEA			2
+#define DX_HASH_UNSIGNED		3
+
+struct ext2_dx_root_info {
+	uint32_t reserved;
+	uint8_t hash_version;
+	uint8_t info_length;
+	uint8_t indirect_levels;
+	uint8_t unused_flags;
+};
+
+/* Index entry.  The hash of the first entry of a node is replaced by
+   the count and limit of the entries in that node.  The low bit of a
+   hash marks a leaf that continues the hash collisions of the leaf
+   before it.  */
+struct ext2_dx_entry {
+	uint32_t hash;
+	uint32_t block;		/* Logical block of the directory */
+};
+
+struct ext2_dx_countlimit {
+	uint16_t limit;
+	uint16_t count;
+};
+
 struct ext2fs_node {
 	struct ext2_data *data;
 	struct ext2_inode inode;
@@ -164,6 +276,8 @@ struct ext2_data {
 	struct ext2_sblock sblock;
 	struct ext2_inode *inode;
 	struct ext2fs_node diropen;
+	char *gdt;		/* Group descriptor table, NULL if not loaded */
+	unsigned int groups;
 };
 
 
@@ -172,13 +286,77 @@ typedef struct ext2fs_node *ext2fs_node_t;
 struct ext2_data *ext2fs_root = NULL;
 ext2fs_node_t ext2fs_file = NULL;
 int symlinknest = 0;
-uint32_t *indir1_block = NULL;
-int indir1_size = 0;
-int indir1_blkno = -1;
-uint32_t *indir2_block = NULL;
-int indir2_size = 0;
-int indir2_blkno = -1;
 static unsigned int inode_size;
+static unsigned int desc_size;
+static int read_runs;
+
+/* Mounted filesystems, so that a repeated command on the same device
+   and partition needs no partition table, superblock, group descriptor
+   or root inode reads.  An entry is only valid for the media generation
+   of the device it was mounted from, init_part() starts a new one.  */
+#ifndef CONFIG_EXT2_MOUNT_TABLE_ENTRIES
+#define CONFIG_EXT2_MOUNT_TABLE_ENTRIES	2
+#endif
+
+static struct ext2_mount {
+	block_dev_desc_t *dev;	/* NULL if unused */
+	unsigned long media_gen;
+	int part;
+	disk_partition_t part_info;
+	struct ext2_data *data;
+	unsigned int inode_size;
+	unsigned int desc_size;
+	unsigned int used;	/* LRU stamp */
+} mount_table[CONFIG_EXT2_MOUNT_TABLE_ENTRIES];
+static unsigned int mount_clock;
+/* Mount the block map and path component caches belong to.  */
+static struct ext2_mount *cur_mount;
+
+/* Small LRU cache of block map metadata blocks (indirect blocks and
+   extent tree nodes), shared by all files, so that walking the map of
+   a file does not re-read them.  Indirect blocks are also expanded into
+   a run list when they are loaded: runs[i] is the number of entries
+   from i on that point to physically contiguous blocks (or are all
+   zero), which lets ext2fs_read_file() skip over whole runs.  */
+#ifndef CONFIG_EXT2_MAP_CACHE_BLOCKS
+#define CONFIG_EXT2_MAP_CACHE_BLOCKS	8
+#endif
+
+static struct {
+	int blkno;
+	int size;		/* Allocated size of buf, 0 if unused */
+	unsigned int used;	/* LRU stamp */
+	char *buf;
+	uint16_t *runs;		/* Run list, NULL if not expanded */
+} map_cache[CONFIG_EXT2_MAP_CACHE_BLOCKS];
+static unsigned int map_cache_clock;
+
+/* The extent the last extent tree lookup ended in.  Sequential reads
+   stay inside it and skip the tree walk.  */
+static struct {
+	struct ext2_data *data;
+	int ino;
+	uint32_t block;		/* First logical block */
+	uint32_t len;		/* Length in blocks, 0 if empty */
+	uint32_t start;		/* First physical block, 0 if unwritten */
+} extent_cache;
+
+/* Small LRU cache of resolved path components of the mounted
+   filesystem: (directory inode, name) to inode and file type.  Names
+   longer than EXT2_DENTRY_NAME_LEN - 1 are not cached.  */
+#ifndef CONFIG_EXT2_DENTRY_CACHE_ENTRIES
+#define CONFIG_EXT2_DENTRY_CACHE_ENTRIES	32
+#endif
+#define EXT2_DENTRY_NAME_LEN		32
+
+static struct {
+	int dir;		/* Inode of the directory, 0 if unused */
+	int ino;
+	int type;
+	unsigned int used;	/* LRU stamp */
+	char name[EXT2_DENTRY_NAME_LEN];
+} dentry_cache[CONFIG_EXT2_DENTRY_CACHE_ENTRIES];
+static unsigned int dentry_cache_clock;
 
 
 static int ext2fs_blockgroup
@@ -187,11 +365,17 @@ static int ext2fs_blockgroup
 	unsigned int blkoff;
 	unsigned int desc_per_blk;
 
-	desc_per_blk = EXT2_BLOCK_SIZE(data) / sizeof(struct ext2_block_group);
+	if (data->gdt != NULL && group < data->groups) {
+		memcpy (blkgrp, data->gdt + group * desc_size,
+			sizeof (struct ext2_block_group));
+		return (1);
+	}
+
+	desc_per_blk = EXT2_BLOCK_SIZE(data) / desc_size;
 
 	blkno = __le32_to_cpu(data->sblock.first_data_block) + 1 +
 	group / desc_per_blk;
-	blkoff = (group % desc_per_blk) * sizeof(struct ext2_block_group);
+	blkoff = (group % desc_per_blk) * desc_size;
 #ifdef DEBUG
 	printf ("ext2fs read %d group descriptor (blkno %d blkoff %d)\n",
 		group, blkno, blkoff);
@@ -250,138 +434,285 @@ void ext2fs_free_node (ext2fs_node_t node, ext2fs_node_t currroot) {
 }
 
 
-static int ext2fs_read_block (ext2fs_node_t node, int fileblock) {
-	struct ext2_data *data = node->data;
-	struct ext2_inode *inode = &node->inode;
-	int blknr;
+static void ext2fs_map_cache_flush (void) {
+	int i;
+
+	for (i = 0; i < CONFIG_EXT2_MAP_CACHE_BLOCKS; i++) {
+		free (map_cache[i].buf);
+		map_cache[i].buf = NULL;
+		map_cache[i].runs = NULL;
+		map_cache[i].size = 0;
+		map_cache[i].used = 0;
+	}
+	map_cache_clock = 0;
+	extent_cache.len = 0;
+}
+
+
+/* Compute the run list of an indirect block, see map_cache.  */
+static void ext2fs_expand_runs (uint32_t *map, uint16_t *runs, int n) {
+	int i;
+
+	runs[n - 1] = 1;
+	for (i = n - 2; i >= 0; i--) {
+		uint32_t blk = __le32_to_cpu (map[i]);
+		uint32_t nxt = __le32_to_cpu (map[i + 1]);
+
+		if (blk ? (nxt == blk + 1) : (nxt == 0)) {
+			runs[i] = runs[i + 1] + 1;
+		} else {
+			runs[i] = 1;
+		}
+	}
+}
+
+
+/* Return the contents of block map block 'blkno', reading it into the
+   least recently used cache slot if needed.  If 'runs' is not NULL the
+   block is an indirect block and its run list is returned there.
+   NULL on errors.  */
+static char *ext2fs_map_block (struct ext2_data *data, int blkno,
+			       uint16_t **runs) {
 	int blksz = EXT2_BLOCK_SIZE (data);
-	int log2_blksz = LOG2_EXT2_BLOCK_SIZE (data);
-	int status;
+	int n = blksz / sizeof (uint32_t);
+	int i, victim = 0;
 
-	/* Direct blocks.  */
-	if (fileblock < INDIRECT_BLOCKS) {
-		blknr = __le32_to_cpu (inode->b.blocks.dir_blocks[fileblock]);
-	}
-	/* Indirect.  */
-	else if (fileblock < (INDIRECT_BLOCKS + (blksz / 4))) {
-		if (indir1_block == NULL) {
-			indir1_block = (uint32_t *) malloc (blksz);
-			if (indir1_block == NULL) {
-				printf ("** ext2fs read block (indir 1) malloc failed. **\n");
-				return (-1);
-			}
-			indir1_size = blksz;
-			indir1_blkno = -1;
-		}
-		if (blksz != indir1_size) {
-			free (indir1_block);
-			indir1_block = NULL;
-			indir1_size = 0;
-			indir1_blkno = -1;
-			indir1_block = (uint32_t *) malloc (blksz);
-			if (indir1_block == NULL) {
-				printf ("** ext2fs read block (indir 1) malloc failed. **\n");
-				return (-1);
-			}
-			indir1_size = blksz;
+	for (i = 0; i < CONFIG_EXT2_MAP_CACHE_BLOCKS; i++) {
+		if (map_cache[i].size == blksz && map_cache[i].blkno == blkno) {
+			victim = i;
+			goto found;
 		}
-		if ((__le32_to_cpu (inode->b.blocks.indir_block) <<
-		     log2_blksz) != indir1_blkno) {
-			status = ext2fs_devread (__le32_to_cpu(inode->b.blocks.indir_block) << log2_blksz,
-						 0, blksz,
-						 (char *) indir1_block);
-			if (status == 0) {
-				printf ("** ext2fs read block (indir 1) failed. **\n");
+		if (map_cache[i].used < map_cache[victim].used) {
+			victim = i;
+		}
+	}
+
+	if (map_cache[victim].size != blksz) {
+		free (map_cache[victim].buf);
+		map_cache[victim].used = 0;
+		map_cache[victim].size = 0;
+		map_cache[victim].runs = NULL;
+		/* Room for the run list behind the data.  */
+		map_cache[victim].buf = malloc (blksz + n * sizeof (uint16_t));
+		if (map_cache[victim].buf == NULL) {
+			printf ("** ext2fs map block malloc failed. **\n");
+			return (NULL);
+		}
+		map_cache[victim].size = blksz;
+	}
+	map_cache[victim].runs = NULL;
+	if (ext2fs_devread (blkno << LOG2_EXT2_BLOCK_SIZE (data), 0, blksz,
+			    map_cache[victim].buf) == 0) {
+		printf ("** ext2fs read map block %d failed. **\n", blkno);
+		map_cache[victim].used = 0;
+		map_cache[victim].blkno = 0;
+		return (NULL);
+	}
+	map_cache[victim].blkno = blkno;
+
+found:
+	map_cache[victim].used = ++map_cache_clock;
+	if (runs != NULL) {
+		if (map_cache[victim].runs == NULL) {
+			map_cache[victim].runs = (uint16_t *)
+				(map_cache[victim].buf + blksz);
+			ext2fs_expand_runs ((uint32_t *) map_cache[victim].buf,
+					    map_cache[victim].runs, n);
+		}
+		*runs = map_cache[victim].runs;
+	}
+	return (map_cache[victim].buf);
+}
+
+
+/* Map 'fileblock' of an extent mapped (ext4) inode.  Returns the
+   physical block, 0 for holes and unwritten extents, -1 on errors.  */
+static int ext4fs_read_extent_block (ext2fs_node_t node, int fileblock) {
+	struct ext4_extent_header *eh;
+	uint32_t blk = fileblock;
+	int depth = EXT4_EXT_MAX_DEPTH + 1;
+	/* The root node lives in the 60 bytes of inode.b.  */
+	int max = (sizeof (node->inode.b) - sizeof (*eh)) /
+		sizeof (struct ext4_extent);
+
+	if (extent_cache.len && extent_cache.data == node->data &&
+	    extent_cache.ino == node->ino &&
+	    blk - extent_cache.block < extent_cache.len) {
+		if (!extent_cache.start) {
+			return (0);
+		}
+		return (extent_cache.start + (blk - extent_cache.block));
+	}
+
+	eh = (struct ext4_extent_header *) &node->inode.b;
+	while (1) {
+		int entries = __le16_to_cpu (eh->entries);
+		int i;
+
+		if (__le16_to_cpu (eh->magic) != EXT4_EXT_MAGIC ||
+		    __le16_to_cpu (eh->depth) >= depth ||
+		    __le16_to_cpu (eh->max) > max ||
+		    entries > __le16_to_cpu (eh->max)) {
+			printf ("** ext4fs bad extent tree (inode %d). **\n",
+				node->ino);
+			return (-1);
+		}
+		depth = __le16_to_cpu (eh->depth);
+
+		if (depth == 0) {
+			struct ext4_extent *ex = (struct ext4_extent *) (eh + 1);
+			uint32_t len, start;
+
+			for (i = entries - 1; i >= 0; i--) {
+				if (__le32_to_cpu (ex[i].block) <= blk) {
+					break;
+				}
+			}
+			if (i < 0) {
 				return (0);
 			}
-			indir1_blkno =
-				__le32_to_cpu (inode->b.blocks.
-					       indir_block) << log2_blksz;
-		}
-		blknr = __le32_to_cpu (indir1_block
-				       [fileblock - INDIRECT_BLOCKS]);
-	}
-	/* Double indirect.  */
-	else if (fileblock <
-		 (INDIRECT_BLOCKS + (blksz / 4 * (blksz / 4 + 1)))) {
-		unsigned int perblock = blksz / 4;
-		unsigned int rblock = fileblock - (INDIRECT_BLOCKS
-						   + blksz / 4);
-
-		if (indir1_block == NULL) {
-			indir1_block = (uint32_t *) malloc (blksz);
-			if (indir1_block == NULL) {
-				printf ("** ext2fs read block (indir 2 1) malloc failed. **\n");
+			ex += i;
+			if (ex->start_hi) {
+				/* Not addressable with 32 bit block numbers.  */
+				printf ("** ext4fs extent beyond 2^32 blocks "
+					"(inode %d). **\n", node->ino);
 				return (-1);
 			}
-			indir1_size = blksz;
-			indir1_blkno = -1;
-		}
-		if (blksz != indir1_size) {
-			free (indir1_block);
-			indir1_block = NULL;
-			indir1_size = 0;
-			indir1_blkno = -1;
-			indir1_block = (uint32_t *) malloc (blksz);
-			if (indir1_block == NULL) {
-				printf ("** ext2fs read block (indir 2 1) malloc failed. **\n");
-				return (-1);
+			len = __le16_to_cpu (ex->len);
+			start = __le32_to_cpu (ex->start);
+			if (len > EXT4_EXT_INIT_MAX_LEN) {
+				len -= EXT4_EXT_INIT_MAX_LEN;
+				start = 0;
 			}
-			indir1_size = blksz;
-		}
-		if ((__le32_to_cpu (inode->b.blocks.double_indir_block) <<
-		     log2_blksz) != indir1_blkno) {
-			status = ext2fs_devread (__le32_to_cpu(inode->b.blocks.double_indir_block) << log2_blksz,
-						0, blksz,
-						(char *) indir1_block);
-			if (status == 0) {
-				printf ("** ext2fs read block (indir 2 1) failed. **\n");
-				return (-1);
+			if (blk - __le32_to_cpu (ex->block) >= len) {
+				/* Hole after the extent.  */
+				return (0);
 			}
-			indir1_blkno =
-				__le32_to_cpu (inode->b.blocks.double_indir_block) << log2_blksz;
-		}
+			extent_cache.data = node->data;
+			extent_cache.ino = node->ino;
+			extent_cache.block = __le32_to_cpu (ex->block);
+			extent_cache.start = start;
+			extent_cache.len = len;
+			if (!start) {
+				return (0);
+			}
+			return (start + (blk - extent_cache.block));
+		} else {
+			struct ext4_extent_idx *ix =
+				(struct ext4_extent_idx *) (eh + 1);
 
-		if (indir2_block == NULL) {
-			indir2_block = (uint32_t *) malloc (blksz);
-			if (indir2_block == NULL) {
-				printf ("** ext2fs read block (indir 2 2) malloc failed. **\n");
-				return (-1);
+			for (i = entries - 1; i >= 0; i--) {
+				if (__le32_to_cpu (ix[i].block) <= blk) {
+					break;
+				}
 			}
-			indir2_size = blksz;
-			indir2_blkno = -1;
-		}
-		if (blksz != indir2_size) {
-			free (indir2_block);
-			indir2_block = NULL;
-			indir2_size = 0;
-			indir2_blkno = -1;
-			indir2_block = (uint32_t *) malloc (blksz);
-			if (indir2_block == NULL) {
-				printf ("** ext2fs read block (indir 2 2) malloc failed. **\n");
+			if (i < 0) {
+				return (0);
+			}
+			if (ix[i].leaf_hi) {
+				printf ("** ext4fs extent beyond 2^32 blocks "
+					"(inode %d). **\n", node->ino);
 				return (-1);
 			}
-			indir2_size = blksz;
-		}
-		if ((__le32_to_cpu (indir1_block[rblock / perblock]) <<
-		     log2_blksz) != indir2_blkno) {
-			status = ext2fs_devread (__le32_to_cpu(indir1_block[rblock / perblock]) << log2_blksz,
-						 0, blksz,
-						 (char *) indir2_block);
-			if (status == 0) {
-				printf ("** ext2fs read block (indir 2 2) failed. **\n");
+			eh = (struct ext4_extent_header *)
+				ext2fs_map_block (node->data,
+						  __le32_to_cpu (ix[i].leaf),
+						  NULL);
+			if (eh == NULL) {
 				return (-1);
 			}
-			indir2_blkno =
-				__le32_to_cpu (indir1_block[rblock / perblock]) << log2_blksz;
+			max = (EXT2_BLOCK_SIZE (node->data) - sizeof (*eh)) /
+				sizeof (struct ext4_extent);
+		}
+	}
+}
+
+
+/* Map logical block 'fileblock' of 'node' to its physical block.  The
+   number of blocks from 'fileblock' on that are physically contiguous
+   (or all sparse) is returned in 'count'; it is at least 1.  Returns 0
+   for sparse blocks and -1 on errors.  */
+static int ext2fs_read_block (ext2fs_node_t node, int fileblock, int *count) {
+	struct ext2_data *data = node->data;
+	struct ext2_inode *inode = &node->inode;
+	int blknr;
+	int blksz = EXT2_BLOCK_SIZE (data);
+	unsigned int perblock = blksz / 4;
+	unsigned int rblock;
+	uint32_t *map;
+	uint16_t *runs = NULL;
+	int levels, idx = 0;
+
+	*count = 1;
+
+	/* Extent mapped (ext4) inode.  */
+	if (__le32_to_cpu (inode->flags) & EXT4_EXTENTS_FL) {
+		blknr = ext4fs_read_extent_block (node, fileblock);
+		if (blknr >= 0 && extent_cache.len &&
+		    extent_cache.data == data &&
+		    extent_cache.ino == node->ino &&
+		    fileblock - extent_cache.block < extent_cache.len) {
+			*count = extent_cache.len -
+				(fileblock - extent_cache.block);
+		}
+		return (blknr);
+	}
+
+	/* Direct blocks.  */
+	if (fileblock < INDIRECT_BLOCKS) {
+		uint32_t *dir = inode->b.blocks.dir_blocks;
+
+		blknr = __le32_to_cpu (dir[fileblock]);
+		while (fileblock + *count < INDIRECT_BLOCKS &&
+		       __le32_to_cpu (dir[fileblock + *count]) ==
+		       (blknr ? blknr + *count : 0)) {
+			(*count)++;
 		}
-		blknr = __le32_to_cpu (indir2_block[rblock % perblock]);
+		return (blknr);
 	}
-	/* Tripple indirect.  */
-	else {
-		printf ("** ext2fs doesn't support tripple indirect blocks. **\n");
+
+	/* Find the level of indirection and the root of the map.  */
+	rblock = fileblock - INDIRECT_BLOCKS;
+	if (rblock < perblock) {
+		levels = 1;
+		blknr = __le32_to_cpu (inode->b.blocks.indir_block);
+	} else if ((rblock -= perblock) / perblock < perblock) {
+		levels = 2;
+		blknr = __le32_to_cpu (inode->b.blocks.double_indir_block);
+	} else if ((rblock -= perblock * perblock) / perblock / perblock
+		   < perblock) {
+		levels = 3;
+		blknr = __le32_to_cpu (inode->b.blocks.tripple_indir_block);
+	} else {
+		printf ("** ext2fs block %d beyond the block map. **\n",
+			fileblock);
 		return (-1);
 	}
+
+	/* Walk down, one cached map block per level.  */
+	while (levels > 0) {
+		unsigned int span = 1;
+		int l;
+
+		if (blknr == 0) {
+			/* Sparse part of the map.  */
+			return (0);
+		}
+		for (l = 1; l < levels; l++) {
+			span *= perblock;
+		}
+		map = (uint32_t *) ext2fs_map_block (data, blknr,
+						     levels == 1 ? &runs : NULL);
+		if (map == NULL) {
+			return (-1);
+		}
+		idx = rblock / span;
+		rblock %= span;
+		blknr = __le32_to_cpu (map[idx]);
+		levels--;
+	}
+	*count = runs[idx];
+
 #ifdef DEBUG
 	printf ("ext2fs_read_block %08x\n", blknr);
 #endif
@@ -393,67 +724,227 @@ int ext2fs_read_file
 	(ext2fs_node_t node, int pos, unsigned int len, char *buf) {
 	int i;
 	int blockcnt;
+	int blknr, next;
 	int log2blocksize = LOG2_EXT2_BLOCK_SIZE (node->data);
 	int blocksize = 1 << (log2blocksize + DISK_SECTOR_BITS);
 	unsigned int filesize = __le32_to_cpu(node->inode.size);
 
+	read_runs = 0;
+
 	/* Adjust len so it we can't read past the end of the file.  */
-	if (len > filesize) {
-		len = filesize;
+	if (pos >= filesize) {
+		return (0);
+	}
+	if (len > filesize - pos) {
+		len = filesize - pos;
 	}
 	blockcnt = ((len + pos) + blocksize - 1) / blocksize;
 
-	for (i = pos / blocksize; i < blockcnt; i++) {
-		int blknr;
-		int blockoff = pos % blocksize;
-		int blockend = blocksize;
-
-		int skipfirst = 0;
+	i = pos / blocksize;
+	while (i < blockcnt) {
+		int runlen, n;
+		unsigned int start, end;
 
-		blknr = ext2fs_read_block (node, i);
+		blknr = ext2fs_read_block (node, i, &runlen);
 		if (blknr < 0) {
 			return (-1);
 		}
-		blknr = blknr << log2blocksize;
 
-		/* Last block.  */
-		if (i == blockcnt - 1) {
-			blockend = (len + pos) % blocksize;
-
-			/* The last portion is exactly blocksize.  */
-			if (!blockend) {
-				blockend = blocksize;
+		/* Extend the run as long as the following blocks continue it
+		   physically (or are all sparse).  */
+		while (i + runlen < blockcnt) {
+			next = ext2fs_read_block (node, i + runlen, &n);
+			if (next < 0) {
+				return (-1);
 			}
+			if (blknr ? (next != blknr + runlen) : (next != 0)) {
+				break;
+			}
+			runlen += n;
 		}
-
-		/* First block.  */
-		if (i == pos / blocksize) {
-			skipfirst = blockoff;
-			blockend -= skipfirst;
+		if (runlen > blockcnt - i) {
+			runlen = blockcnt - i;
 		}
 
+		/* Byte range of the file covered by this run.  */
+		start = max ((unsigned int) pos, (unsigned int) i * blocksize);
+		end = min (pos + len, (unsigned int) (i + runlen) * blocksize);
+
 		/* If the block number is 0 this block is not stored on disk but
 		   is zero filled instead.  */
 		if (blknr) {
 			int status;
 
-			status = ext2fs_devread (blknr, skipfirst, blockend, buf);
+			status = ext2fs_devread (blknr << log2blocksize,
+						 start - i * blocksize,
+						 end - start, buf);
 			if (status == 0) {
 				return (-1);
 			}
+			read_runs++;
 		} else {
-			memset (buf, 0, blocksize - skipfirst);
+			memset (buf, 0, end - start);
 		}
-		buf += blocksize - skipfirst;
+		buf += end - start;
+
+		i += runlen;
 	}
 	return (len);
 }
 
 
+/* Number of device reads (runs of contiguous blocks) the last
+   ext2fs_read_file() needed.  */
+int ext2fs_read_runs (void) {
+	return (read_runs);
+}
+
+
+/* Allocate the node a directory entry of 'diro' refers to and return
+   its file type in 'ftype'.  NULL on errors.  */
+static ext2fs_node_t ext2fs_dirent_node
+	(ext2fs_node_t diro, struct ext2_dirent *dirent, int *ftype) {
+	ext2fs_node_t fdiro;
+	int type = FILETYPE_UNKNOWN;
+	int status;
+
+	fdiro = malloc (sizeof (struct ext2fs_node));
+	if (!fdiro) {
+		return (NULL);
+	}
+
+	fdiro->data = diro->data;
+	fdiro->ino = __le32_to_cpu (dirent->inode);
+
+	if (dirent->filetype != FILETYPE_UNKNOWN) {
+		fdiro->inode_read = 0;
+
+		if (dirent->filetype == FILETYPE_DIRECTORY) {
+			type = FILETYPE_DIRECTORY;
+		} else if (dirent->filetype == FILETYPE_SYMLINK) {
+			type = FILETYPE_SYMLINK;
+		} else if (dirent->filetype == FILETYPE_REG) {
+			type = FILETYPE_REG;
+		}
+	} else {
+		/* The filetype can not be read from the dirent, get it from inode */
+
+		status = ext2fs_read_inode (diro->data, fdiro->ino,
+					    &fdiro->inode);
+		if (status == 0) {
+			free (fdiro);
+			return (NULL);
+		}
+		fdiro->inode_read = 1;
+
+		if ((__le16_to_cpu (fdiro->inode.mode) &
+		     FILETYPE_INO_MASK) == FILETYPE_INO_DIRECTORY) {
+			type = FILETYPE_DIRECTORY;
+		} else if ((__le16_to_cpu (fdiro->inode.mode) &
+			    FILETYPE_INO_MASK) == FILETYPE_INO_SYMLINK) {
+			type = FILETYPE_SYMLINK;
+		} else if ((__le16_to_cpu (fdiro->inode.mode) &
+			    FILETYPE_INO_MASK) == FILETYPE_INO_REG) {
+			type = FILETYPE_REG;
+		}
+	}
+	*ftype = type;
+	return (fdiro);
+}
+
+
+/* Walk the directory entries in 'len' bytes of directory data at
+   'block'.  With a 'name' the matching entry is returned in 'fnode'
+   and 'ftype', otherwise all entries are listed.  Returns 1 if the
+   name was found, 0 if not and -1 on errors.  */
+static int ext2fs_iterate_block (ext2fs_node_t diro, char *block, int len,
+				 char *name, ext2fs_node_t * fnode,
+				 int *ftype)
+{
+	int namelen = name ? strlen (name) : 0;
+	int off = 0;
+	int status;
+
+	while (off + (int) sizeof (struct ext2_dirent) <= len) {
+		struct ext2_dirent *dirent = (struct ext2_dirent *)
+			(block + off);
+		int direntlen = __le16_to_cpu (dirent->direntlen);
+		char *filename = block + off + sizeof (struct ext2_dirent);
+		ext2fs_node_t fdiro;
+		int type;
+
+		if (direntlen < (int) sizeof (struct ext2_dirent) ||
+		    off + direntlen > len ||
+		    (int) sizeof (struct ext2_dirent) + dirent->namelen >
+		    direntlen) {
+			printf ("** ext2fs bad directory entry (inode %d). **\n",
+				diro->ino);
+			return (-1);
+		}
+		off += direntlen;
+
+		if (dirent->namelen == 0 || dirent->inode == 0) {
+			continue;
+		}
+#ifdef DEBUG
+		printf ("iterate >%.*s<\n", dirent->namelen, filename);
+#endif /* of DEBUG */
+		if (name != NULL) {
+			if (dirent->namelen != namelen ||
+			    memcmp (filename, name, namelen) != 0) {
+				continue;
+			}
+			fdiro = ext2fs_dirent_node (diro, dirent, &type);
+			if (fdiro == NULL) {
+				return (-1);
+			}
+			*ftype = type;
+			*fnode = fdiro;
+			return (1);
+		}
+
+		fdiro = ext2fs_dirent_node (diro, dirent, &type);
+		if (fdiro == NULL) {
+			return (-1);
+		}
+		if (fdiro->inode_read == 0) {
+			status = ext2fs_read_inode (diro->data, fdiro->ino,
+						    &fdiro->inode);
+			if (status == 0) {
+				free (fdiro);
+				return (-1);
+			}
+			fdiro->inode_read = 1;
+		}
+		switch (type) {
+		case FILETYPE_DIRECTORY:
+			printf ("<DIR> ");
+			break;
+		case FILETYPE_SYMLINK:
+			printf ("<SYM> ");
+			break;
+		case FILETYPE_REG:
+			printf ("      ");
+			break;
+		default:
+			printf ("< ? > ");
+			break;
+		}
+		printf ("%10d %.*s\n", __le32_to_cpu (fdiro->inode.size),
+			dirent->namelen, filename);
+		free (fdiro);
+	}
+	return (0);
+}
+
+
 static int ext2fs_iterate_dir (ext2fs_node_t dir, char *name, ext2fs_node_t * fnode, int *ftype)
 {
 	unsigned int fpos = 0;
+	unsigned int dirsize;
+	int blksz;
 	int status;
+	char *block;
 	struct ext2fs_node *diro = (struct ext2fs_node *) dir;
 
 #ifdef DEBUG
@@ -466,119 +957,225 @@ static int ext2fs_iterate_dir (ext2fs_node_t dir, char *name, ext2fs_node_t * fn
 		if (status == 0) {
 			return (0);
 		}
+		diro->inode_read = 1;
+	}
+	blksz = EXT2_BLOCK_SIZE (diro->data);
+	block = malloc (blksz);
+	if (!block) {
+		return (0);
 	}
-	/* Search the file.  */
-	while (fpos < __le32_to_cpu (diro->inode.size)) {
-		struct ext2_dirent dirent;
+	/* Search the file, one directory block at a time; entries never
+	   cross block boundaries.  */
+	dirsize = __le32_to_cpu (diro->inode.size);
+	status = 0;
+	while (fpos < dirsize) {
+		int len = min (dirsize - fpos, (unsigned int) blksz);
+
+		if (ext2fs_read_file (diro, fpos, len, block) != len) {
+			status = 0;
+			break;
+		}
+		status = ext2fs_iterate_block (diro, block, len, name, fnode,
+					       ftype);
+		if (status != 0) {
+			break;
+		}
+		fpos += len;
+	}
+	free (block);
+	return (status == 1);
+}
 
-		status = ext2fs_read_file (diro, fpos,
-					   sizeof (struct ext2_dirent),
-					   (char *) &dirent);
-		if (status < 1) {
-			return (0);
+
+/* Look 'name' up through the hashed index of the directory 'diro': hash
+   it, walk the index down to the leaf block covering the hash and search
+   only that block (and the ones continuing a hash collision).  Returns 1
+   if the name was found, 0 if it does not exist and -1 if the index can
+   not be used, in which case the caller scans the directory linearly.  */
+static int ext2fs_htree_lookup (ext2fs_node_t diro, char *name,
+				ext2fs_node_t * fnode, int *ftype)
+{
+	struct ext2_data *data = diro->data;
+	int blksz = EXT2_BLOCK_SIZE (data);
+	struct ext2_dx_root_info *info;
+	struct ext2_dx_countlimit *cl;
+	struct ext2_dx_entry *entries;
+	uint32_t seed[4];
+	uint32_t hash;
+	char *node, *leaf;
+	int version, depth, levels, count = 0;
+	int i = 0, lo, hi;
+	int status = -1;
+
+	node = malloc (2 * blksz);
+	if (!node) {
+		return (-1);
+	}
+	leaf = node + blksz;
+
+	if (ext2fs_read_file (diro, 0, blksz, node) != blksz) {
+		goto out;
+	}
+	info = (struct ext2_dx_root_info *) (node + EXT2_DX_ROOT_INFO_OFFSET);
+	version = info->hash_version;
+	depth = levels = info->indirect_levels;
+	if (info->reserved != 0 || version > DX_HASH_TEA ||
+	    levels >= EXT2_DX_MAX_LEVELS ||
+	    info->info_length < sizeof (struct ext2_dx_root_info)) {
+		goto out;
+	}
+	if (__le32_to_cpu (data->sblock.flags) & EXT2_FLAGS_UNSIGNED_HASH) {
+		version += DX_HASH_UNSIGNED;
+	}
+	for (i = 0; i < 4; i++) {
+		seed[i] = __le32_to_cpu (data->sblock.hash_seed[i]);
+	}
+	hash = ext2fs_dirhash (name, strlen (name), version, seed);
+	entries = (struct ext2_dx_entry *) ((char *) info + info->info_length);
+
+	/* Walk down the index.  */
+	while (1) {
+		cl = (struct ext2_dx_countlimit *) entries;
+		count = __le16_to_cpu (cl->count);
+		if (count == 0 || count > __le16_to_cpu (cl->limit) ||
+		    (char *) (entries + count) > node + blksz) {
+			printf ("** ext2fs bad directory index (inode %d). **\n",
+				diro->ino);
+			goto out;
 		}
-		if (dirent.namelen != 0) {
-			char filename[dirent.namelen + 1];
-			ext2fs_node_t fdiro;
-			int type = FILETYPE_UNKNOWN;
 
-			status = ext2fs_read_file (diro,
-						   fpos + sizeof (struct ext2_dirent),
-						   dirent.namelen, filename);
-			if (status < 1) {
-				return (0);
+		/* Last entry whose hash is not above ours.  Entry 0 has no
+		   hash and covers everything below the hash of entry 1.  */
+		i = 0;
+		lo = 1;
+		hi = count - 1;
+		while (lo <= hi) {
+			int mid = (lo + hi) / 2;
+
+			if (__le32_to_cpu (entries[mid].hash) > hash) {
+				hi = mid - 1;
+			} else {
+				i = mid;
+				lo = mid + 1;
 			}
-			fdiro = malloc (sizeof (struct ext2fs_node));
-			if (!fdiro) {
-				return (0);
+		}
+		if (levels-- == 0) {
+			break;
+		}
+		if (ext2fs_read_file (diro, EXT2_DX_BLOCK (entries[i].block) *
+				      blksz, blksz, node) != blksz) {
+			goto out;
+		}
+		entries = (struct ext2_dx_entry *) (node + EXT2_DX_NODE_OFFSET);
+	}
+
+	/* Search the leaf, and the following leaves as long as they
+	   continue a collision on our hash.  */
+	while (1) {
+		uint32_t next;
+
+		if (ext2fs_read_file (diro, EXT2_DX_BLOCK (entries[i].block) *
+				      blksz, blksz, leaf) != blksz) {
+			goto out;
+		}
+		status = ext2fs_iterate_block (diro, leaf, blksz, name, fnode,
+					       ftype);
+		if (status != 0) {
+			goto out;
+		}
+		if (++i == count) {
+			/* A collision chain may go on in the next index
+			   node, leave that to the linear scan.  */
+			if (depth != 0) {
+				status = -1;
 			}
+			goto out;
+		}
+		next = __le32_to_cpu (entries[i].hash);
+		if (!(next & 1) || (next & ~1) != hash) {
+			goto out;
+		}
+	}
 
-			fdiro->data = diro->data;
-			fdiro->ino = __le32_to_cpu (dirent.inode);
+out:
+	free (node);
+	return (status);
+}
 
-			filename[dirent.namelen] = '\0';
 
-			if (dirent.filetype != FILETYPE_UNKNOWN) {
-				fdiro->inode_read = 0;
+static void ext2fs_dentry_cache_flush (void) {
+	int i;
+
+	for (i = 0; i < CONFIG_EXT2_DENTRY_CACHE_ENTRIES; i++) {
+		dentry_cache[i].dir = 0;
+		dentry_cache[i].used = 0;
+	}
+	dentry_cache_clock = 0;
+}
 
-				if (dirent.filetype == FILETYPE_DIRECTORY) {
-					type = FILETYPE_DIRECTORY;
-				} else if (dirent.filetype ==
-					   FILETYPE_SYMLINK) {
-					type = FILETYPE_SYMLINK;
-				} else if (dirent.filetype == FILETYPE_REG) {
-					type = FILETYPE_REG;
-				}
-			} else {
-				/* The filetype can not be read from the dirent, get it from inode */
 
-				status = ext2fs_read_inode (diro->data,
-							    __le32_to_cpu(dirent.inode),
-							    &fdiro->inode);
-				if (status == 0) {
-					free (fdiro);
+/* Find 'name' in the directory 'dir', through the path component
+   cache, the hashed index of the directory if it has one, or else a
+   linear scan.  Returns 1 and the node and its type if found, 0 if
+   not.  */
+static int ext2fs_lookup (ext2fs_node_t dir, char *name,
+			  ext2fs_node_t * fnode, int *ftype)
+{
+	struct ext2_data *data = dir->data;
+	int namelen = strlen (name);
+	int i, victim = 0;
+	int status;
+
+	if (namelen < EXT2_DENTRY_NAME_LEN) {
+		for (i = 0; i < CONFIG_EXT2_DENTRY_CACHE_ENTRIES; i++) {
+			if (dentry_cache[i].dir == dir->ino &&
+			    strcmp (dentry_cache[i].name, name) == 0) {
+				ext2fs_node_t fdiro;
+
+				fdiro = malloc (sizeof (struct ext2fs_node));
+				if (!fdiro) {
 					return (0);
 				}
-				fdiro->inode_read = 1;
-
-				if ((__le16_to_cpu (fdiro->inode.mode) &
-				     FILETYPE_INO_MASK) ==
-				    FILETYPE_INO_DIRECTORY) {
-					type = FILETYPE_DIRECTORY;
-				} else if ((__le16_to_cpu (fdiro->inode.mode)
-					    & FILETYPE_INO_MASK) ==
-					   FILETYPE_INO_SYMLINK) {
-					type = FILETYPE_SYMLINK;
-				} else if ((__le16_to_cpu (fdiro->inode.mode)
-					    & FILETYPE_INO_MASK) ==
-					   FILETYPE_INO_REG) {
-					type = FILETYPE_REG;
-				}
+				fdiro->data = data;
+				fdiro->ino = dentry_cache[i].ino;
+				fdiro->inode_read = 0;
+				dentry_cache[i].used = ++dentry_cache_clock;
+				*fnode = fdiro;
+				*ftype = dentry_cache[i].type;
+				return (1);
 			}
-#ifdef DEBUG
-			printf ("iterate >%s<\n", filename);
-#endif /* of DEBUG */
-			if ((name != NULL) && (fnode != NULL)
-			    && (ftype != NULL)) {
-				if (strcmp (filename, name) == 0) {
-					*ftype = type;
-					*fnode = fdiro;
-					return (1);
-				}
-			} else {
-				if (fdiro->inode_read == 0) {
-					status = ext2fs_read_inode (diro->data,
-							    __le32_to_cpu (dirent.inode),
-							    &fdiro->inode);
-					if (status == 0) {
-						free (fdiro);
-						return (0);
-					}
-					fdiro->inode_read = 1;
-				}
-				switch (type) {
-				case FILETYPE_DIRECTORY:
-					printf ("<DIR> ");
-					break;
-				case FILETYPE_SYMLINK:
-					printf ("<SYM> ");
-					break;
-				case FILETYPE_REG:
-					printf ("      ");
-					break;
-				default:
-					printf ("< ? > ");
-					break;
-				}
-				printf ("%10d %s\n",
-					__le32_to_cpu (fdiro->inode.size),
-					filename);
+			if (dentry_cache[i].used < dentry_cache[victim].used) {
+				victim = i;
 			}
-			free (fdiro);
 		}
-		fpos += __le16_to_cpu (dirent.direntlen);
 	}
-	return (0);
+
+	if (!dir->inode_read) {
+		status = ext2fs_read_inode (data, dir->ino, &dir->inode);
+		if (status == 0) {
+			return (0);
+		}
+		dir->inode_read = 1;
+	}
+
+	status = -1;
+	if ((__le32_to_cpu (data->sblock.feature_compatibility) &
+	     EXT2_FEATURE_COMPAT_DIR_INDEX) &&
+	    (__le32_to_cpu (dir->inode.flags) & EXT2_INDEX_FL)) {
+		status = ext2fs_htree_lookup (dir, name, fnode, ftype);
+	}
+	if (status < 0) {
+		status = ext2fs_iterate_dir (dir, name, fnode, ftype);
+	}
+
+	if (status == 1 && namelen < EXT2_DENTRY_NAME_LEN) {
+		dentry_cache[victim].dir = dir->ino;
+		dentry_cache[victim].ino = (*fnode)->ino;
+		dentry_cache[victim].type = *ftype;
+		dentry_cache[victim].used = ++dentry_cache_clock;
+		strcpy (dentry_cache[victim].name, name);
+	}
+	return (status);
 }
 
 
@@ -661,7 +1258,7 @@ int ext2fs_find_file1
 		oldnode = currnode;
 
 		/* Iterate over the directory.  */
-		found = ext2fs_iterate_dir (currnode, name, &currnode, &type);
+		found = ext2fs_lookup (currnode, name, &currnode, &type);
 		if (found == 0) {
 			return (0);
 		}
@@ -806,27 +1403,20 @@ int ext2fs_close (void
 		ext2fs_free_node (ext2fs_file, &ext2fs_root->diropen);
 		ext2fs_file = NULL;
 	}
-	if (ext2fs_root != NULL) {
-		free (ext2fs_root);
-		ext2fs_root = NULL;
-	}
-	if (indir1_block != NULL) {
-		free (indir1_block);
-		indir1_block = NULL;
-		indir1_size = 0;
-		indir1_blkno = -1;
-	}
-	if (indir2_block != NULL) {
-		free (indir2_block);
-		indir2_block = NULL;
-		indir2_size = 0;
-		indir2_blkno = -1;
-	}
+	/* The filesystem stays in the mount table.  */
+	ext2fs_root = NULL;
 	return (0);
 }
 
 
 int ext2fs_read (char *buf, unsigned len) {
+	return (ext2fs_read_at (buf, 0, len));
+}
+
+
+/* Read 'len' bytes from offset 'pos' of the open file.  Only the block
+   map is walked to get to 'pos', the skipped data is not read.  */
+int ext2fs_read_at (char *buf, unsigned pos, unsigned len) {
 	int status;
 
 	if (ext2fs_root == NULL) {
@@ -837,19 +1427,106 @@ int ext2fs_read (char *buf, unsigned len) {
 		return (0);
 	}
 
-	status = ext2fs_read_file (ext2fs_file, 0, len, buf);
+	status = ext2fs_read_file (ext2fs_file, pos, len, buf);
 	return (status);
 }
 
 
+/* Look 'part' of 'dev' up in the mount table and return its partition
+   information in 'info'.  Returns 1 if it is mounted, 0 if not.  */
+int ext2fs_mounted_part (block_dev_desc_t *dev, int part,
+			 disk_partition_t *info) {
+	int i;
+
+	for (i = 0; i < CONFIG_EXT2_MOUNT_TABLE_ENTRIES; i++) {
+		if (mount_table[i].dev == dev &&
+		    mount_table[i].media_gen == dev->media_gen &&
+		    mount_table[i].part == part) {
+			memcpy (info, &mount_table[i].part_info,
+				sizeof (disk_partition_t));
+			return (1);
+		}
+	}
+	return (0);
+}
+
+
+static void ext2fs_mount_release (struct ext2_mount *m) {
+	if (m->data != NULL) {
+		free (m->data->gdt);
+		free (m->data);
+		m->data = NULL;
+	}
+	m->dev = NULL;
+	m->used = 0;
+	if (m == cur_mount) {
+		cur_mount = NULL;
+	}
+}
+
+
+/* Read the whole group descriptor table of 'data' into memory.  Without
+   it (no memory) ext2fs_blockgroup() reads the descriptors one by one.  */
+static void ext2fs_read_gdt (struct ext2_data *data) {
+	uint32_t blocks = __le32_to_cpu (data->sblock.total_blocks) -
+		__le32_to_cpu (data->sblock.first_data_block);
+	uint32_t per_group = __le32_to_cpu (data->sblock.blocks_per_group);
+	unsigned int blkno = __le32_to_cpu (data->sblock.first_data_block) + 1;
+
+	data->gdt = NULL;
+	data->groups = 0;
+	if (per_group == 0) {
+		return;
+	}
+	data->groups = (blocks + per_group - 1) / per_group;
+	data->gdt = malloc (data->groups * desc_size);
+	if (data->gdt == NULL) {
+		return;
+	}
+	if (ext2fs_devread (blkno << LOG2_EXT2_BLOCK_SIZE (data), 0,
+			    data->groups * desc_size, data->gdt) == 0) {
+		free (data->gdt);
+		data->gdt = NULL;
+	}
+}
+
+
 int ext2fs_mount (unsigned part_length) {
 	struct ext2_data *data;
+	struct ext2_mount *m = NULL;
+	block_dev_desc_t *dev;
+	disk_partition_t info;
+	int part;
 	int status;
+	int i;
+
+	dev = ext2fs_get_blk_dev (&part, &info);
+	if (dev == NULL) {
+		return (0);
+	}
+
+	/* Still mounted from an earlier command?  Otherwise take the slot
+	   of an older media generation of the same partition, or the least
+	   recently used one.  */
+	for (i = 0; i < CONFIG_EXT2_MOUNT_TABLE_ENTRIES; i++) {
+		if (mount_table[i].dev == dev && mount_table[i].part == part) {
+			m = &mount_table[i];
+			if (m->media_gen == dev->media_gen) {
+				goto mounted;
+			}
+			break;
+		}
+		if (m == NULL || mount_table[i].used < m->used) {
+			m = &mount_table[i];
+		}
+	}
+	ext2fs_mount_release (m);
 
 	data = malloc (sizeof (struct ext2_data));
 	if (!data) {
 		return (0);
 	}
+	data->gdt = NULL;
 	/* Read the superblock.  */
 	status = ext2fs_devread (1 * 2, 0, sizeof (struct ext2_sblock),
 				 (char *) &data->sblock);
@@ -865,6 +1542,14 @@ int ext2fs_mount (unsigned part_length) {
 	} else {
 		inode_size = __le16_to_cpu(data->sblock.inode_size);
 	}
+	if (__le32_to_cpu(data->sblock.feature_incompat) &
+	    EXT4_FEATURE_INCOMPAT_64BIT) {
+		desc_size = __le16_to_cpu(data->sblock.descriptor_size);
+		if (desc_size < EXT2_MIN_DESC_SIZE)
+			desc_size = EXT2_MIN_DESC_SIZE;
+	} else {
+		desc_size = EXT2_MIN_DESC_SIZE;
+	}
 #ifdef DEBUG
 	printf("EXT2 rev %d, inode_size %d\n",
 			__le32_to_cpu(data->sblock.revision_level), inode_size);
@@ -873,18 +1558,37 @@ int ext2fs_mount (unsigned part_length) {
 	data->diropen.ino = 2;
 	data->diropen.inode_read = 1;
 	data->inode = &data->diropen.inode;
+	ext2fs_read_gdt (data);
 
 	status = ext2fs_read_inode (data, 2, data->inode);
 	if (status == 0) {
 		goto fail;
 	}
 
-	ext2fs_root = data;
+	m->dev = dev;
+	m->media_gen = dev->media_gen;
+	m->part = part;
+	memcpy (&m->part_info, &info, sizeof (disk_partition_t));
+	m->data = data;
+	m->inode_size = inode_size;
+	m->desc_size = desc_size;
+
+mounted:
+	if (m != cur_mount) {
+		ext2fs_map_cache_flush ();
+		ext2fs_dentry_cache_flush ();
+		cur_mount = m;
+	}
+	inode_size = m->inode_size;
+	desc_size = m->desc_size;
+	m->used = ++mount_clock;
+	ext2fs_root = m->data;
 
 	return (1);
 
 fail:
 	printf ("Failed to mount ext2 filesystem...\n");
+	free (data->gdt);
 	free (data);
 	ext2fs_root = NULL;
 	return (0);
@@ -28,6 +28,7 @@
 #include <common.h>
 #include <config.h>
 #include <fat.h>
+#include <malloc.h>
 #include <asm/byteorder.h>
 #include <part.h>
 
@@ -48,6 +49,45 @@ static unsigned long part_offset = 0;
 
 static int cur_part = 1;
 
+/* Partition number asked for by the last fat_register_device() */
+static int cur_part_no = 1;
+
+/*
+ * Mounted filesystem. The boot sector is parsed only once per device,
+ * partition and media generation; later commands reuse the geometry.
+ */
+static struct {
+	int		valid;
+	block_dev_desc_t *dev;
+	unsigned long	media_gen;
+	unsigned long	part_offset;
+	int		part_no;	/* As passed to fat_register_device */
+	int		cur_part;
+	fsdata		data;
+	int		root_cluster;
+	volume_info	volinfo;
+} fatmnt;
+
+/*
+ * Path lookup cache: maps the lowercased path of a file to its
+ * directory entry, so repeated loads from the same directories do not
+ * walk and re-read the directory clusters. It is flushed whenever the
+ * filesystem is (re)mounted.
+ */
+#ifndef CONFIG_FAT_PATH_CACHE_ENTRIES
+#define CONFIG_FAT_PATH_CACHE_ENTRIES	8
+#endif
+#define FAT_PATH_CACHE_NAMELEN		128
+
+static struct {
+	char		path[FAT_PATH_CACHE_NAMELEN];
+	dir_entry	dent;
+	unsigned int	used;		/* LRU stamp, 0 if the slot is free */
+} fatpath[CONFIG_FAT_PATH_CACHE_ENTRIES];
+
+static unsigned int fatpath_clock;
+static unsigned long fatpath_lookups, fatpath_hits;
+
 #define DOS_PART_TBL_OFFSET	0x1be
 #define DOS_PART_MAGIC_OFFSET	0x1fe
 #define DOS_FS_TYPE_OFFSET	0x36
@@ -61,8 +101,8 @@ static int disk_read (__u32 startblock, __u32 getsize, __u8 * bufptr)
 	startblock += part_offset;
 
 	if (cur_dev->block_read) {
-		return cur_dev->block_read(cur_dev->dev, startblock, getsize,
-					   (unsigned long *) bufptr);
+		return blk_dread(cur_dev, startblock, getsize,
+				 (unsigned long *) bufptr);
 	}
 	return -1;
 }
@@ -76,9 +116,21 @@ int fat_register_device (block_dev_desc_t * dev_desc, int part_no)
 	if (!dev_desc->block_read)
 		return -1;
 
+	/* Still mounted from an earlier command? */
+	if (fatmnt.valid && fatmnt.dev == dev_desc &&
+	    fatmnt.media_gen == dev_desc->media_gen &&
+	    fatmnt.part_no == part_no) {
+		cur_dev = dev_desc;
+		part_offset = fatmnt.part_offset;
+		cur_part = fatmnt.cur_part;
+		cur_part_no = part_no;
+		return 0;
+	}
+
 	cur_dev = dev_desc;
+	cur_part_no = part_no;
 	/* check if we have a MBR (on floppies we have only a PBR) */
-	if (dev_desc->block_read(dev_desc->dev, 0, 1, (ulong *)buffer) != 1) {
+	if (blk_dread(dev_desc, 0, 1, (ulong *)buffer) != 1) {
 		printf("** Can't read from device %d **\n",
 			dev_desc->dev);
 		return -1;
@@ -174,6 +226,160 @@ static void get_name (dir_entry *dirent, char *s_name)
 	downcase(s_name);
 }
 
+/*
+ * Extent map of the file read last. The cluster chain is walked once
+ * and merged into runs of contiguous sectors; the data is then read run
+ * by run straight into the destination. The map is extended on demand
+ * and kept until another file is read or the FAT cache is flushed, so
+ * reads at an offset into the same file can reuse it.
+ */
+#define FAT_EXTENTS_MIN		32
+
+static struct {
+	__u32		start;		/* First cluster, 0 if no map */
+	__u32		last;		/* Last cluster mapped */
+	unsigned long	size;		/* Bytes mapped so far */
+	int		count;		/* Extents mapped */
+	int		alloc;		/* Extents allocated */
+	int		used;		/* Extents touched by the last read */
+	fat_extent	*ext;
+} fatmap;
+
+/* Size of the file the last read looked up, -1 if none */
+static long fat_file_size = -1;
+
+static void fat_map_reset (void)
+{
+	fatmap.start = 0;
+	fatmap.size = 0;
+	fatmap.count = 0;
+	fatmap.used = 0;
+}
+
+/*
+ * FAT table cache. get_fatent() looks entries up in FATBUFSIZE windows
+ * of the FAT, of which CONFIG_FAT_CACHE_SLOTS are kept and replaced in
+ * LRU order, so following a fragmented chain does not keep re-reading
+ * the same FAT sectors. With CONFIG_FAT_PRELOAD_MAX a FAT of up to that
+ * many bytes is read completely in one go when the filesystem is
+ * mounted. The cache stays valid across commands as long as the same
+ * filesystem on the same medium is accessed.
+ */
+#ifndef CONFIG_FAT_CACHE_SLOTS
+#define CONFIG_FAT_CACHE_SLOTS	4
+#endif
+
+static struct {
+	block_dev_desc_t *dev;		/* Device the cache belongs to */
+	unsigned long	media_gen;	/* ... and its media generation */
+	unsigned long	part_offset;
+	__u32		fat_sect;
+	__u32		fatlength;
+	__u8		*fat;		/* Preloaded FAT, or NULL */
+	int		bufnum[CONFIG_FAT_CACHE_SLOTS];
+	unsigned int	used[CONFIG_FAT_CACHE_SLOTS];
+	unsigned int	clock;
+	unsigned long	lookups;	/* get_fatent() calls */
+	unsigned long	hits;		/* ... served without disk I/O */
+	__u8		buf[CONFIG_FAT_CACHE_SLOTS][FATBUFSIZE]
+			__attribute__ ((__aligned__ (4)));
+} fatcache;
+
+/*
+ * Make the FAT cache track the filesystem described by 'mydata',
+ * flushing it if it holds data of a different one.
+ */
+static void fat_cache_setup (fsdata *mydata)
+{
+	int i;
+
+	mydata->fatbufnum = -1;
+
+	if (fatcache.dev == cur_dev &&
+	    fatcache.media_gen == cur_dev->media_gen &&
+	    fatcache.part_offset == part_offset &&
+	    fatcache.fat_sect == mydata->fat_sect &&
+	    fatcache.fatlength == mydata->fatlength)
+		return;
+
+	free(fatcache.fat);
+	fatcache.fat = NULL;
+	for (i = 0; i < CONFIG_FAT_CACHE_SLOTS; i++) {
+		fatcache.bufnum[i] = -1;
+		fatcache.used[i] = 0;
+	}
+	fatcache.clock = 0;
+	fatcache.lookups = 0;
+	fat_map_reset();
+	fatcache.hits = 0;
+
+	fatcache.dev = cur_dev;
+	fatcache.media_gen = cur_dev->media_gen;
+	fatcache.part_offset = part_offset;
+	fatcache.fat_sect = mydata->fat_sect;
+	fatcache.fatlength = mydata->fatlength;
+
+#ifdef CONFIG_FAT_PRELOAD_MAX
+	if (mydata->fatlength * SECTOR_SIZE <= CONFIG_FAT_PRELOAD_MAX) {
+		/* Whole windows, so get_fatent() never runs off the end */
+		fatcache.fat = malloc(roundup(mydata->fatlength, FATBUFBLOCKS)
+				      * SECTOR_SIZE);
+		if (fatcache.fat == NULL)
+			return;
+		if (disk_read(mydata->fat_sect, mydata->fatlength,
+			      fatcache.fat) != mydata->fatlength) {
+			debug("Error preloading FAT\n");
+			free(fatcache.fat);
+			fatcache.fat = NULL;
+		}
+	}
+#endif
+}
+
+/*
+ * Return the FAT window 'bufnum', reading it into the least recently
+ * used slot if it is not cached. Return NULL on failure.
+ */
+static __u8 *fat_cache_window (fsdata *mydata, __u32 bufnum)
+{
+	__u32 startblock = bufnum * FATBUFBLOCKS;
+	__u32 getsize = FATBUFBLOCKS;
+	int i, victim = 0;
+
+	if (startblock >= mydata->fatlength)
+		return NULL;
+
+	if (fatcache.fat) {
+		fatcache.hits++;
+		return fatcache.fat + startblock * SECTOR_SIZE;
+	}
+
+	for (i = 0; i < CONFIG_FAT_CACHE_SLOTS; i++) {
+		if (fatcache.bufnum[i] == (int)bufnum) {
+			fatcache.used[i] = ++fatcache.clock;
+			fatcache.hits++;
+			return fatcache.buf[i];
+		}
+		if (fatcache.used[i] < fatcache.used[victim])
+			victim = i;
+	}
+
+	if (getsize > mydata->fatlength - startblock)
+		getsize = mydata->fatlength - startblock;
+
+	/* A short read must not be cached as a valid window */
+	if (disk_read(mydata->fat_sect + startblock, getsize,
+		      fatcache.buf[victim]) != getsize) {
+		fatcache.bufnum[victim] = -1;
+		fatcache.used[victim] = 0;
+		return NULL;
+	}
+	fatcache.bufnum[victim] = bufnum;
+	fatcache.used[victim] = ++fatcache.clock;
+
+	return fatcache.buf[victim];
+}
+
 /*
  * Get the entry at index 'entry' in a FAT (12/16/32) table.
  * On failure 0x00 is returned.
@@ -207,23 +413,19 @@ static __u32 get_fatent (fsdata *mydata, __u32 entry)
 	debug("FAT%d: entry: 0x%04x = %d, offset: 0x%04x = %d\n",
 	       mydata->fatsize, entry, entry, offset, offset);
 
-	/* Read a new block of FAT entries into the cache. */
+	/* Switch to the FAT window holding the entry. */
+	fatcache.lookups++;
 	if (bufnum != mydata->fatbufnum) {
-		int getsize = FATBUFSIZE / FS_BLOCK_SIZE;
-		__u8 *bufptr = mydata->fatbuf;
-		__u32 fatlength = mydata->fatlength;
-		__u32 startblock = bufnum * FATBUFBLOCKS;
+		__u8 *bufptr = fat_cache_window(mydata, bufnum);
 
-		fatlength *= SECTOR_SIZE;	/* We want it in bytes now */
-		startblock += mydata->fat_sect;	/* Offset from start of disk */
-
-		if (getsize > fatlength)
-			getsize = fatlength;
-		if (disk_read(startblock, getsize, bufptr) < 0) {
+		if (bufptr == NULL) {
 			debug("Error reading FAT blocks\n");
 			return ret;
 		}
+		mydata->fatbuf = bufptr;
 		mydata->fatbufnum = bufnum;
+	} else {
+		fatcache.hits++;
 	}
 
 	/* Get the actual entry from the table */
@@ -313,83 +515,160 @@ get_cluster (fsdata *mydata, __u32 clustnum, __u8 *buffer,
 }
 
 /*
- * Read at most 'maxsize' bytes from the file associated with 'dentptr'
- * into 'buffer'.
- * Return the number of bytes read or -1 on fatal errors.
+ * Make the extent map of the file starting at cluster 'start' cover at
+ * least 'bytes' bytes, or the whole chain if that is shorter.
+ * Return 0 on success, -1 if out of memory.
  */
-static long
-get_contents (fsdata *mydata, dir_entry *dentptr, __u8 *buffer,
-	      unsigned long maxsize)
+static int fat_map_file (fsdata *mydata, __u32 start, unsigned long bytes)
 {
-	unsigned long filesize = FAT2CPU32(dentptr->size), gotsize = 0;
 	unsigned int bytesperclust = mydata->clust_size * SECTOR_SIZE;
-	__u32 curclust = START(dentptr);
-	__u32 endclust, newclust;
-	unsigned long actsize;
-
-	debug("Filesize: %ld bytes\n", filesize);
+	fat_extent *ext;
+	__u32 clust, sect;
 
-	if (maxsize > 0 && filesize > maxsize)
-		filesize = maxsize;
-
-	debug("%ld bytes\n", filesize);
+	if (fatmap.start != start) {
+		fat_map_reset();
+		fatmap.start = start;
+	}
 
-	actsize = bytesperclust;
-	endclust = curclust;
+	while (fatmap.size < bytes) {
+		if (fatmap.count == 0)
+			clust = start;
+		else
+			clust = get_fatent(mydata, fatmap.last);
+		if (CHECK_CLUST(clust, mydata->fatsize)) {
+			debug("curclust: 0x%x\n", clust);
+			printf("Invalid FAT entry\n");
+			break;
+		}
 
-	do {
-		/* search for consecutive clusters */
-		while (actsize < filesize) {
-			newclust = get_fatent(mydata, endclust);
-			if ((newclust - 1) != endclust)
-				goto getit;
-			if (CHECK_CLUST(newclust, mydata->fatsize)) {
-				debug("curclust: 0x%x\n", newclust);
-				debug("Invalid FAT entry\n");
-				return gotsize;
+		sect = mydata->data_begin + clust * mydata->clust_size;
+		ext = fatmap.count ? &fatmap.ext[fatmap.count - 1] : NULL;
+		if (ext && ext->sect + ext->nsect == sect) {
+			ext->nsect += mydata->clust_size;
+		} else {
+			if (fatmap.count == fatmap.alloc) {
+				int n = fatmap.alloc ?
+					fatmap.alloc * 2 : FAT_EXTENTS_MIN;
+
+				ext = realloc(fatmap.ext, n * sizeof(*ext));
+				if (ext == NULL) {
+					printf("Out of memory for extent map\n");
+					fat_map_reset();
+					return -1;
+				}
+				fatmap.ext = ext;
+				fatmap.alloc = n;
 			}
-			endclust = newclust;
-			actsize += bytesperclust;
+			ext = &fatmap.ext[fatmap.count++];
+			ext->sect = sect;
+			ext->nsect = mydata->clust_size;
 		}
+		fatmap.last = clust;
+		fatmap.size += bytesperclust;
+	}
 
-		/* actsize >= file size */
-		actsize -= bytesperclust;
+	return 0;
+}
 
-		/* get remaining clusters */
-		if (get_cluster(mydata, curclust, buffer, (int)actsize) != 0) {
-			printf("Error reading cluster\n");
-			return -1;
-		}
+/*
+ * Read 'len' bytes at 'pos' of the mapped file into 'buffer', one
+ * disk_read() per extent. Only partial sectors at either end go through
+ * a bounce buffer. Return the number of bytes read or -1 on errors.
+ */
+static long
+fat_read_map (unsigned long pos, __u8 *buffer, unsigned long len)
+{
+	__u8 tmpbuf[SECTOR_SIZE] __attribute__ ((__aligned__ (4)));
+	unsigned long done = 0;
+	int i;
 
-		/* get remaining bytes */
-		gotsize += (int)actsize;
-		filesize -= actsize;
-		buffer += actsize;
-		actsize = filesize;
-		if (get_cluster(mydata, endclust, buffer, (int)actsize) != 0) {
-			printf("Error reading cluster\n");
-			return -1;
+	fatmap.used = 0;
+	for (i = 0; i < fatmap.count && done < len; i++) {
+		unsigned long extbytes = fatmap.ext[i].nsect * SECTOR_SIZE;
+		unsigned long off, n;
+		__u32 sect;
+
+		if (pos >= extbytes) {
+			pos -= extbytes;
+			continue;
 		}
-		gotsize += actsize;
-		return gotsize;
-getit:
-		if (get_cluster(mydata, curclust, buffer, (int)actsize) != 0) {
-			printf("Error reading cluster\n");
-			return -1;
+		fatmap.used++;
+
+		sect = fatmap.ext[i].sect + pos / SECTOR_SIZE;
+		extbytes -= pos - pos % SECTOR_SIZE;
+		off = pos % SECTOR_SIZE;
+		pos = 0;
+
+		/* Unaligned start: bounce the first sector */
+		if (off) {
+			if (disk_read(sect, 1, tmpbuf) != 1)
+				goto err;
+			n = min(SECTOR_SIZE - off, len - done);
+			memcpy(buffer + done, tmpbuf + off, n);
+			done += n;
+			sect++;
+			extbytes -= SECTOR_SIZE;
 		}
-		gotsize += (int)actsize;
-		filesize -= actsize;
-		buffer += actsize;
 
-		curclust = get_fatent(mydata, endclust);
-		if (CHECK_CLUST(curclust, mydata->fatsize)) {
-			debug("curclust: 0x%x\n", curclust);
-			printf("Invalid FAT entry\n");
-			return gotsize;
+		/* Whole sectors go straight to the destination */
+		n = min(extbytes, len - done) / SECTOR_SIZE;
+		if (n) {
+			if (disk_read(sect, n, buffer + done) != n)
+				goto err;
+			done += n * SECTOR_SIZE;
+			sect += n;
+			extbytes -= n * SECTOR_SIZE;
+		}
+
+		/* Partial last sector */
+		if (done < len && extbytes) {
+			if (disk_read(sect, 1, tmpbuf) != 1)
+				goto err;
+			n = min(SECTOR_SIZE, len - done);
+			memcpy(buffer + done, tmpbuf, n);
+			done += n;
 		}
-		actsize = bytesperclust;
-		endclust = curclust;
-	} while (1);
+	}
+
+	return done;
+
+err:
+	printf("Error reading cluster\n");
+	return -1;
+}
+
+/*
+ * Read at most 'maxsize' bytes from offset 'pos' of the file associated
+ * with 'dentptr' into 'buffer'. Only the FAT is consulted to get to
+ * 'pos', none of the skipped data is read.
+ * Return the number of bytes read or -1 on fatal errors.
+ */
+static long
+get_contents (fsdata *mydata, dir_entry *dentptr, unsigned long pos,
+	      __u8 *buffer, unsigned long maxsize)
+{
+	unsigned long filesize = FAT2CPU32(dentptr->size);
+
+	debug("Filesize: %ld bytes\n", filesize);
+	fat_file_size = filesize;
+
+	if (pos >= filesize) {
+		fatmap.used = 0;
+		return 0;
+	}
+	filesize -= pos;
+
+	if (maxsize > 0 && filesize > maxsize)
+		filesize = maxsize;
+
+	debug("%ld bytes at %ld\n", filesize, pos);
+
+	if (fat_map_file(mydata, START(dentptr), pos + filesize) < 0)
+		return -1;
+
+	debug("%d extents\n", fatmap.count);
+
+	return fat_read_map(pos, buffer, filesize);
 }
 
 #ifdef CONFIG_SUPPORT_VFAT
@@ -738,35 +1017,85 @@ read_bootsectandvi (boot_sector *bs, volume_info *volinfo, int *fatsize)
 	return -1;
 }
 
-__attribute__ ((__aligned__ (__alignof__ (dir_entry))))
-__u8 do_fat_read_block[MAX_CLUSTSIZE];
+static void fat_path_flush (void)
+{
+	int i;
 
-long
-do_fat_read (const char *filename, void *buffer, unsigned long maxsize,
-	     int dols)
+	for (i = 0; i < CONFIG_FAT_PATH_CACHE_ENTRIES; i++)
+		fatpath[i].used = 0;
+	fatpath_clock = 0;
+	fatpath_lookups = 0;
+	fatpath_hits = 0;
+}
+
+/*
+ * Look up the lowercased 'path' in the path cache and copy its
+ * directory entry to 'dent'. Return 0 on a hit, -1 otherwise.
+ */
+static int fat_path_lookup (const char *path, dir_entry *dent)
 {
-	char fnamecopy[2048];
+	int i;
+
+	fatpath_lookups++;
+	for (i = 0; i < CONFIG_FAT_PATH_CACHE_ENTRIES; i++) {
+		if (fatpath[i].used && !strcmp(fatpath[i].path, path)) {
+			fatpath[i].used = ++fatpath_clock;
+			memcpy(dent, &fatpath[i].dent, sizeof(dir_entry));
+			fatpath_hits++;
+			return 0;
+		}
+	}
+
+	return -1;
+}
+
+static void fat_path_insert (const char *path, dir_entry *dent)
+{
+	int i, victim = 0;
+
+	if (strlen(path) >= FAT_PATH_CACHE_NAMELEN)
+		return;
+
+	for (i = 0; i < CONFIG_FAT_PATH_CACHE_ENTRIES; i++) {
+		if (fatpath[i].used < fatpath[victim].used)
+			victim = i;
+	}
+
+	strcpy(fatpath[victim].path, path);
+	downcase(fatpath[victim].path);
+	memcpy(&fatpath[victim].dent, dent, sizeof(dir_entry));
+	fatpath[victim].used = ++fatpath_clock;
+}
+
+/*
+ * Return the filesystem parameters of the current device and partition,
+ * reading and parsing the boot sector only if it is not mounted yet.
+ * Return NULL if there is no valid FAT filesystem.
+ */
+static fsdata *fat_mount (void)
+{
+	fsdata *mydata = &fatmnt.data;
 	boot_sector bs;
-	volume_info volinfo;
-	fsdata datablock;
-	fsdata *mydata = &datablock;
-	dir_entry *dentptr;
-	__u16 prevcksum = 0xffff;
-	char *subname = "";
-	int cursect;
-	int idx, isdir = 0;
-	int files = 0, dirs = 0;
-	long ret = 0;
-	int firsttime;
-	int root_cluster;
-	int j;
 
-	if (read_bootsectandvi(&bs, &volinfo, &mydata->fatsize)) {
+	if (cur_dev == NULL)
+		return NULL;
+
+	if (fatmnt.valid && fatmnt.dev == cur_dev &&
+	    fatmnt.media_gen == cur_dev->media_gen &&
+	    fatmnt.part_offset == part_offset) {
+		mydata->fatbufnum = -1;
+		return mydata;
+	}
+
+	fatmnt.valid = 0;
+	fat_path_flush();
+
+	if (read_bootsectandvi(&bs, &fatmnt.volinfo, &mydata->fatsize)) {
 		debug("Error: reading boot sector\n");
-		return -1;
+		return NULL;
 	}
 
-	root_cluster = bs.root_cluster;
+	fatmnt.root_cluster = bs.root_cluster;
 
 	if (mydata->fatsize == 32)
 		mydata->fatlength = bs.fat32_length;
@@ -775,8 +1104,7 @@ do_fat_read (const char *filename, void *buffer, unsigned long maxsize,
 
 	mydata->fat_sect = bs.reserved;
 
-	cursect = mydata->rootdir_sect
-		= mydata->fat_sect + mydata->fatlength * bs.fats;
+	mydata->rootdir_sect = mydata->fat_sect + mydata->fatlength * bs.fats;
 
 	mydata->clust_size = bs.cluster_size;
 
@@ -795,7 +1123,47 @@ do_fat_read (const char *filename, void *buffer, unsigned long maxsize,
 					(mydata->clust_size * 2);
 	}
 
-	mydata->fatbufnum = -1;
+	fat_cache_setup(mydata);
+
+	fatmnt.dev = cur_dev;
+	fatmnt.media_gen = cur_dev->media_gen;
+	fatmnt.part_offset = part_offset;
+	fatmnt.part_no = cur_part_no;
+	fatmnt.cur_part = cur_part;
+	fatmnt.valid = 1;
+
+	return mydata;
+}
+
+__attribute__ ((__aligned__ (__alignof__ (dir_entry))))
+__u8 do_fat_read_block[MAX_CLUSTSIZE];
+
+long
+do_fat_read_at (const char *filename, unsigned long pos, void *buffer,
+		unsigned long maxsize, int dols)
+{
+	char fnamecopy[2048];
+	fsdata *mydata;
+	dir_entry *dentptr;
+	dir_entry cached;
+	__u16 prevcksum = 0xffff;
+	char *subname = "";
+	int cursect;
+	int idx, isdir = 0;
+	int files = 0, dirs = 0;
+	long ret = 0;
+	int firsttime;
+	int root_cluster;
+	int j;
+
+	mydata = fat_mount();
+	if (mydata == NULL) {
+		debug("Error: reading boot sector\n");
+		return -1;
+	}
+
+	root_cluster = fatmnt.root_cluster;
+	cursect = mydata->rootdir_sect;
 
 #ifdef CONFIG_SUPPORT_VFAT
 	debug("VFAT Support enabled\n");
@@ -817,6 +1185,12 @@ do_fat_read (const char *filename, void *buffer, unsigned long maxsize,
 	strcpy(fnamecopy, filename);
 	downcase(fnamecopy);
 
+	if (!dols && fat_path_lookup(fnamecopy, &cached) == 0) {
+		debug("Path cache hit: %s\n", fnamecopy);
+		dentptr = &cached;
+		goto lookup_done;
+	}
+
 	if (*fnamecopy == '\0') {
 		if (!dols)
 			return -1;
@@ -1048,17 +1422,26 @@ rootdir_done:
 		}
 	}
 
-	ret = get_contents(mydata, dentptr, buffer, maxsize);
+	if (!dols)
+		fat_path_insert(filename, dentptr);
+
+lookup_done:
+	ret = get_contents(mydata, dentptr, pos, buffer, maxsize);
 	debug("Size: %d, got: %ld\n", FAT2CPU32(dentptr->size), ret);
 
 	return ret;
 }
 
+long
+do_fat_read (const char *filename, void *buffer, unsigned long maxsize,
+	     int dols)
+{
+	return do_fat_read_at(filename, 0, buffer, maxsize, dols);
+}
+
 int file_fat_detectfs (void)
 {
-	boot_sector bs;
 	volume_info volinfo;
-	int fatsize;
 	char vol_label[12];
 
 	if (cur_dev == NULL) {
@@ -1103,10 +1486,11 @@ int file_fat_detectfs (void)
 	dev_print(cur_dev);
 #endif
 
-	if (read_bootsectandvi(&bs, &volinfo, &fatsize)) {
+	if (fat_mount() == NULL) {
 		printf("\nNo valid FAT fs found\n");
 		return 1;
 	}
+	volinfo = fatmnt.volinfo;
 
 	memcpy(vol_label, volinfo.volume_label, 11);
 	vol_label[11] = '\0';
@@ -1115,6 +1499,12 @@ int file_fat_detectfs (void)
 	printf("Partition %d: Filesystem: %s \"%s\"\n", cur_part,
 		volinfo.fs_type, vol_label);
 
+	printf("FAT cache:  %lu of %lu lookups served from cache%s\n",
+		fatcache.hits, fatcache.lookups,
+		fatcache.fat ? " (FAT preloaded)" : "");
+	printf("Path cache: %lu of %lu lookups served from cache\n",
+		fatpath_hits, fatpath_lookups);
+
 	return 0;
 }
 
@@ -1128,3 +1518,40 @@ long file_fat_read (const char *filename, void *buffer, unsigned long maxsize)
 	printf("reading %s\n", filename);
 	return do_fat_read(filename, buffer, maxsize, LS_NO);
 }
+
+long file_fat_read_at (const char *filename, unsigned long pos, void *buffer,
+		       unsigned long maxsize)
+{
+	printf("reading %s at offset %lu\n", filename, pos);
+	return do_fat_read_at(filename, pos, buffer, maxsize, LS_NO);
+}
+
+/*
+ * Check quietly whether the current device and partition hold a FAT
+ * filesystem, mounting it. Return 0 if so, -1 otherwise.
+ */
+int file_fat_probe (void)
+{
+	return fat_mount() ? 0 : -1;
+}
+
+/*
+ * Return the size of 'filename' without reading any of its data, or -1
+ * if it does not exist.
+ */
+long file_fat_size (const char *filename)
+{
+	fat_file_size = -1;
+	/* Reading at the largest offset only looks the file up */
+	if (do_fat_read_at(filename, ~0UL, NULL, 0, LS_NO) < 0)
+		return -1;
+	return fat_file_size;
+}
+
+/*
+ * Number of extents (contiguous runs) the last file_fat_read() touched.
+ */
+int file_fat_extents (void)
+{
+	return fatmap.used;
+}
@@ -0,0 +1,339 @@
+/*
+ * Generic filesystem layer for block devices
+ *
+ * See file CREDITS for list of people who contributed to this
+ * project.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston,
+ * MA 02111-1307 USA
+ */
+
+#include <common.h>
+#include <malloc.h>
+#include <part.h>
+#include <fs.h>
+#ifdef CONFIG_CMD_FAT
+#include <fat.h>
+#endif
+#ifdef CONFIG_CMD_EXT2
+#include <ext2fs.h>
+#endif
+#ifdef CONFIG_CMD_SQUASHFS
+#include <squashfs.h>
+#endif
+
+/*
+ * Filesystem driver. probe() mounts the filesystem on a partition and
+ * returns 0 if it is of this type; the drivers keep their own mount
+ * state, so probing a partition that is still mounted does no I/O.
+ */
+struct fstype_info {
+	int		fstype;
+	const char	*name;
+	int		(*probe)(block_dev_desc_t *dev_desc, int part);
+	int		(*ls)(const char *dirname);
+	long		(*size)(const char *filename);
+	long		(*read)(const char *filename, ulong addr, ulong pos,
+				ulong len);
+};
+
+#ifdef CONFIG_CMD_FAT
+static int fs_probe_fat (block_dev_desc_t *dev_desc, int part)
+{
+	if (fat_register_device(dev_desc, part) != 0)
+		return -1;
+	return file_fat_probe();
+}
+
+static long fs_read_fat (const char *filename, ulong addr, ulong pos,
+			 ulong len)
+{
+	return file_fat_read_at(filename, pos, (void *)addr, len);
+}
+#endif
+
+#ifdef CONFIG_CMD_EXT2
+static int fs_probe_ext2 (block_dev_desc_t *dev_desc, int part)
+{
+	int part_length;
+
+	part_length = ext2fs_set_blk_dev(dev_desc, part);
+	if (part_length == 0 || !ext2fs_mount(part_length)) {
+		ext2fs_close();
+		return -1;
+	}
+	return 0;
+}
+
+static int fs_ls_ext2 (const char *dirname)
+{
+	int ret;
+
+	ret = ext2fs_ls((char *)dirname);
+	ext2fs_close();
+	return ret ? -1 : 0;
+}
+
+static long fs_size_ext2 (const char *filename)
+{
+	long size;
+
+	size = ext2fs_open((char *)filename);
+	ext2fs_close();
+	return size;
+}
+
+static long fs_read_ext2 (const char *filename, ulong addr, ulong pos,
+			  ulong len)
+{
+	long size;
+
+	size = ext2fs_open((char *)filename);
+	if (size < 0)
+		goto out;
+	if (pos > size) {
+		size = 0;
+		goto out;
+	}
+	size -= pos;
+	if (len != 0 && len < size)
+		size = len;
+	if (ext2fs_read_at((char *)addr, pos, size) != size)
+		size = -1;
+out:
+	ext2fs_close();
+	return size;
+}
+#endif
+
+#ifdef CONFIG_CMD_SQUASHFS
+static int fs_probe_sqfs (block_dev_desc_t *dev_desc, int part)
+{
+	if (sqfs_set_blk_dev(dev_desc, part) != 0)
+		return -1;
+	return sqfs_mount();
+}
+
+static long fs_read_sqfs (const char *filename, ulong addr, ulong pos,
+			  ulong len)
+{
+	return sqfs_read(filename, (void *)addr, pos, len);
+}
+#endif
+
+/* Probed in this order */
+static struct fstype_info fstypes[] = {
+#ifdef CONFIG_CMD_FAT
+	{
+		.fstype = FS_TYPE_FAT,
+		.name = "fat",
+		.probe = fs_probe_fat,
+		.ls = file_fat_ls,
+		.size = file_fat_size,
+		.read = fs_read_fat,
+	},
+#endif
+#ifdef CONFIG_CMD_EXT2
+	{
+		.fstype = FS_TYPE_EXT2,
+		.name = "ext2",
+		.probe = fs_probe_ext2,
+		.ls = fs_ls_ext2,
+		.size = fs_size_ext2,
+		.read = fs_read_ext2,
+	},
+#endif
+#ifdef CONFIG_CMD_SQUASHFS
+	{
+		.fstype = FS_TYPE_SQUASHFS,
+		.name = "squashfs",
+		.probe = fs_probe_sqfs,
+		.ls = sqfs_ls,
+		.size = sqfs_size,
+		.read = fs_read_sqfs,
+	},
+#endif
+};
+
+#define FS_NUM_TYPES	(sizeof(fstypes) / sizeof(fstypes[0]))
+
+/*
+ * Probe results per device, partition and media generation, so that
+ * only the matching driver is tried on later commands. Partitions
+ * without a known filesystem are remembered too (fs == NULL).
+ */
+#ifndef CONFIG_FS_PROBE_CACHE_ENTRIES
+#define CONFIG_FS_PROBE_CACHE_ENTRIES	4
+#endif
+
+static struct {
+	block_dev_desc_t	*dev;		/* NULL if unused */
+	unsigned long		media_gen;
+	int			part;
+	struct fstype_info	*fs;
+	unsigned int		used;		/* LRU stamp */
+} fsprobe[CONFIG_FS_PROBE_CACHE_ENTRIES];
+
+static unsigned int fsprobe_clock;
+
+static struct fstype_info *cur_fs;
+
+int fs_set_blk_dev (const char *ifname, const char *dev_part_str, int fstype)
+{
+	block_dev_desc_t *dev_desc;
+	struct fstype_info *fs;
+	int dev, part = 1;
+	int i, victim = 0;
+	char *ep;
+
+	cur_fs = NULL;
+
+	dev = (int)simple_strtoul(dev_part_str, &ep, 16);
+	dev_desc = get_dev((char *)ifname, dev);
+	if (dev_desc == NULL) {
+		printf("** Block device %s %d not supported **\n", ifname, dev);
+		return -1;
+	}
+	if (*ep) {
+		if (*ep != ':') {
+			puts("** Invalid boot device, use `dev[:part]' **\n");
+			return -1;
+		}
+		part = (int)simple_strtoul(++ep, NULL, 16);
+	}
+
+	for (i = 0; i < CONFIG_FS_PROBE_CACHE_ENTRIES; i++) {
+		if (fsprobe[i].dev == dev_desc &&
+		    fsprobe[i].media_gen == dev_desc->media_gen &&
+		    fsprobe[i].part == part) {
+			victim = i;
+			fs = fsprobe[i].fs;
+			fsprobe[i].used = ++fsprobe_clock;
+			if (fs == NULL)
+				goto unknown;
+			if (fstype != FS_TYPE_ANY && fs->fstype != fstype)
+				goto mismatch;
+			if (fs->probe(dev_desc, part) == 0)
+				goto found;
+			/* Changed under our feet, probe again */
+			fsprobe[i].dev = NULL;
+			break;
+		}
+		if (fsprobe[i].used < fsprobe[victim].used)
+			victim = i;
+	}
+
+	for (fs = fstypes; fs < fstypes + FS_NUM_TYPES; fs++) {
+		if (fstype != FS_TYPE_ANY && fs->fstype != fstype)
+			continue;
+		if (fs->probe(dev_desc, part) == 0)
+			break;
+	}
+	if (fs == fstypes + FS_NUM_TYPES) {
+		/* Only a full probe proves there is no known filesystem */
+		if (fstype != FS_TYPE_ANY)
+			goto mismatch;
+		fs = NULL;
+	}
+
+	fsprobe[victim].dev = dev_desc;
+	fsprobe[victim].media_gen = dev_desc->media_gen;
+	fsprobe[victim].part = part;
+	fsprobe[victim].fs = fs;
+	fsprobe[victim].used = ++fsprobe_clock;
+	if (fs == NULL)
+		goto unknown;
+
+found:
+	debug("%s %d:%d: %s\n", ifname, dev, part, fs->name);
+	cur_fs = fs;
+	return 0;
+
+mismatch:
+	printf("** No filesystem of the requested type on %s %d:%d **\n",
+		ifname, dev, part);
+	return -1;
+
+unknown:
+	printf("** Unrecognized filesystem type on %s %d:%d **\n",
+		ifname, dev, part);
+	return -1;
+}
+
+const char *fs_type_name (void)
+{
+	return cur_fs ? cur_fs->name : "none";
+}
+
+int fs_ls (const char *dirname)
+{
+	if (cur_fs == NULL)
+		return -1;
+	return cur_fs->ls(dirname);
+}
+
+long fs_size (const char *filename)
+{
+	if (cur_fs == NULL)
+		return -1;
+	return cur_fs->size(filename);
+}
+
+long fs_read (const char *filename, ulong addr, ulong pos, ulong len)
+{
+	if (cur_fs == NULL)
+		return -1;
+	return cur_fs->read(filename, addr, pos, len);
+}
+
+#ifndef CONFIG_FS_STREAM_CHUNK
+#define CONFIG_FS_STREAM_CHUNK	(128 * 1024)
+#endif
+
+long fs_read_stream (const char *filename,
+		     int (*fn)(void *priv, const void *buf, ulong len),
+		     void *priv)
+{
+	void *buf;
+	long size, n;
+	ulong pos, chunk;
+	int ret = 0;
+
+	if (cur_fs == NULL)
+		return -1;
+
+	size = cur_fs->size(filename);
+	if (size < 0)
+		return -1;
+
+	buf = malloc(CONFIG_FS_STREAM_CHUNK);
+	if (buf == NULL) {
+		puts("** Out of memory for the read buffer **\n");
+		return -1;
+	}
+
+	for (pos = 0; pos < size && ret == 0; pos += n) {
+		chunk = min(size - pos, CONFIG_FS_STREAM_CHUNK);
+		n = cur_fs->read(filename, (ulong)buf, pos, chunk);
+		if (n <= 0) {
+			ret = -1;
+			break;
+		}
+		ret = fn(priv, buf, n);
+	}
+
+	free(buf);
+	return ret < 0 ? -1 : (long)pos;
+}
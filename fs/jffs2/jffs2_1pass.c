@@ -93,9 +93,10 @@
  *   if there are multiple copies of fragments for a certain file offset.
  *
  * The fragment sorting feature must be enabled by CONFIG_SYS_JFFS2_SORT_FRAGMENTS.
- * Sorting is done while adding fragments to the lists, which is more or less a
- * bubble sort. This takes a lot of time, and is most probably not an issue if
- * the boot filesystem is always mounted readonly.
+ * Directory entries are sorted while adding them to the lists, which is more
+ * or less a bubble sort; the fragments of a file are sorted by version when
+ * the file is read. This takes some time, and is most probably not an issue
+ * if the boot filesystem is always mounted readonly.
  *
  * You should define it if the boot filesystem is mounted writable, and updates
  * to the boot files are done by copying files to that filesystem.
@@ -541,7 +542,7 @@ add_node(struct b_list *list)
 }
 
 static struct b_node *
-insert_node(struct b_list *list, u32 offset)
+insert_node(struct b_list *list, u32 offset, u32 ino)
 {
 	struct b_node *new;
 #ifdef CONFIG_SYS_JFFS2_SORT_FRAGMENTS
@@ -553,22 +554,29 @@ insert_node(struct b_list *list, u32 offset)
 		return NULL;
 	}
 	new->offset = offset;
+	new->ino = ino;
+	new->datacrc = CRC_UNKNOWN;
 
 #ifdef CONFIG_SYS_JFFS2_SORT_FRAGMENTS
-	if (list->listTail != NULL && list->listCompare(new, list->listTail))
-		prev = list->listTail;
-	else if (list->listLast != NULL && list->listCompare(new, list->listLast))
-		prev = list->listLast;
-	else
-		prev = NULL;
+	b = NULL;
+	if (list->listCompare != NULL) {
+		if (list->listTail != NULL &&
+		    list->listCompare(new, list->listTail))
+			prev = list->listTail;
+		else if (list->listLast != NULL &&
+			 list->listCompare(new, list->listLast))
+			prev = list->listLast;
+		else
+			prev = NULL;
 
-	for (b = (prev ? prev->next : list->listHead);
-	     b != NULL && list->listCompare(new, b);
-	     prev = b, b = b->next) {
-		list->listLoops++;
+		for (b = (prev ? prev->next : list->listHead);
+		     b != NULL && list->listCompare(new, b);
+		     prev = b, b = b->next) {
+			list->listLoops++;
+		}
+		if (b != NULL)
+			list->listLast = prev;
 	}
-	if (b != NULL)
-		list->listLast = prev;
 
 	if (b != NULL) {
 		new->next = b;
@@ -592,21 +600,6 @@ insert_node(struct b_list *list, u32 offset)
 }
 
 #ifdef CONFIG_SYS_JFFS2_SORT_FRAGMENTS
-/* Sort data entries with the latest version last, so that if there
- * is overlapping data the latest version will be used.
- */
-static int compare_inodes(struct b_node *new, struct b_node *old)
-{
-	struct jffs2_raw_inode ojNew;
-	struct jffs2_raw_inode ojOld;
-	struct jffs2_raw_inode *jNew =
-		(struct jffs2_raw_inode *)get_fl_mem(new->offset, sizeof(ojNew), &ojNew);
-	struct jffs2_raw_inode *jOld =
-		(struct jffs2_raw_inode *)get_fl_mem(old->offset, sizeof(ojOld), &ojOld);
-
-	return jNew->version > jOld->version;
-}
-
 /* Sort directory entries so all entries in the same directory
  * with the same name are grouped together, with the latest version
  * last. This makes it easy to eliminate all but the latest version
@@ -663,7 +656,11 @@ jffs2_free_cache(struct part_info *part)
 		free_nodes(&pL->frag);
 		free_nodes(&pL->dir);
 		free(pL->readbuf);
+#ifdef CONFIG_JFFS2_SCAN_CACHE
+		free(pL->sector_used);
+#endif
 		free(pL);
+		part->jffs2_priv = NULL;
 	}
 }
 
@@ -680,145 +677,189 @@ jffs_init_1pass_list(struct part_info *part)
 		memset(pL, 0, sizeof(*pL));
 #ifdef CONFIG_SYS_JFFS2_SORT_FRAGMENTS
 		pL->dir.listCompare = compare_dirents;
-		pL->frag.listCompare = compare_inodes;
 #endif
 	}
 	return 0;
 }
 
-/* find the inode from the slashless name given a parent */
+/* The first node whose ino hashes like 'ino', see jffs2_index_list() */
+static inline struct b_node *
+ino_chain(struct b_list *list, u32 ino)
+{
+	return list->hash[ino & (JFFS2_INO_HASH_SIZE - 1)];
+}
+
+/*
+ * Chain the nodes of 'list' by inode number (parent inode for dirents),
+ * keeping their list order, so that resolving a path or reading a file
+ * only visits the nodes of the directories and the inode involved, not
+ * every node of the partition.
+ */
+static void
+jffs2_index_list(struct b_list *list)
+{
+	struct b_node *tail[JFFS2_INO_HASH_SIZE];
+	struct b_node *b;
+	u32 h;
+
+	memset(list->hash, 0, sizeof(list->hash));
+	memset(tail, 0, sizeof(tail));
+	for (b = list->listHead; b != NULL; b = b->next) {
+		h = b->ino & (JFFS2_INO_HASH_SIZE - 1);
+		b->hnext = NULL;
+		if (tail[h] != NULL)
+			tail[h]->hnext = b;
+		else
+			list->hash[h] = b;
+		tail[h] = b;
+	}
+}
+
+/*
+ * Inode nodes are not CRC checked while scanning, but when they are
+ * first used. Return 1 if the node 'b' with header 'jNode' is good.
+ */
+static int
+inode_node_ok(struct b_node *b, struct jffs2_raw_inode *jNode)
+{
+	if (b->datacrc == CRC_UNKNOWN)
+		b->datacrc = inode_crc(jNode) ? CRC_NODE_OK : CRC_BAD;
+	return b->datacrc != CRC_BAD;
+}
+
+/* read the data of inode to dest, return its size */
 static long
 jffs2_1pass_read_inode(struct b_lists *pL, u32 inode, char *dest)
 {
 	struct b_node *b;
+	struct b_node **nodes;
+	struct jffs2_raw_inode ojNode;
 	struct jffs2_raw_inode *jNode;
 	u32 totalSize = 0;
 	u32 latestVersion = 0;
+	u32 *versions;
+	u32 count = 0;
+	u32 n, j;
 	uchar *lDest;
 	uchar *src;
-	long ret;
+	long ret = 0;
 	int i;
-	u32 counter = 0;
-#ifdef CONFIG_SYS_JFFS2_SORT_FRAGMENTS
+
+	/* Only the nodes of this inode are read from flash */
+	for (b = ino_chain(&pL->frag, inode); b != NULL; b = b->hnext)
+		if (b->ino == inode)
+			count++;
+	if (count == 0)
+		return 0;
+
+	nodes = malloc(count * (sizeof(*nodes) + sizeof(*versions)));
+	if (nodes == NULL) {
+		putstr("read_inode: malloc failed\n");
+		return -1;
+	}
+	versions = (u32 *)(nodes + count);
+
 	/* Find file size before loading any data, so fragments that
 	 * start past the end of file can be ignored. A fragment
 	 * that is partially in the file is loaded, so extra data may
 	 * be loaded up to the next 4K boundary above the file size.
 	 * This shouldn't cause trouble when loading kernel images, so
 	 * we will live with it.
+	 * With CONFIG_SYS_JFFS2_SORT_FRAGMENTS the nodes are sorted by
+	 * version on the way, so that if there is overlapping data the
+	 * latest version will be used.
 	 */
-	for (b = pL->frag.listHead; b != NULL; b = b->next) {
+	n = 0;
+	for (b = ino_chain(&pL->frag, inode); b != NULL; b = b->hnext) {
+		if (b->ino != inode)
+			continue;
 		jNode = (struct jffs2_raw_inode *) get_fl_mem(b->offset,
-			sizeof(struct jffs2_raw_inode), pL->readbuf);
-		if ((inode == jNode->ino)) {
+			sizeof(ojNode), &ojNode);
+		if (inode_node_ok(b, jNode)) {
 			/* get actual file length from the newest node */
 			if (jNode->version >= latestVersion) {
 				totalSize = jNode->isize;
 				latestVersion = jNode->version;
 			}
+			j = n++;
+#ifdef CONFIG_SYS_JFFS2_SORT_FRAGMENTS
+			/* versions are mostly ascending already */
+			for (; j > 0 && versions[j - 1] > jNode->version; j--) {
+				nodes[j] = nodes[j - 1];
+				versions[j] = versions[j - 1];
+			}
+#endif
+			nodes[j] = b;
+			versions[j] = jNode->version;
 		}
-		put_fl_mem(jNode, pL->readbuf);
+		put_fl_mem(jNode, &ojNode);
 	}
-#endif
 
-	for (b = pL->frag.listHead; b != NULL; b = b->next) {
+	for (j = 0; dest && j < n; j++) {
+		b = nodes[j];
 		jNode = (struct jffs2_raw_inode *) get_node_mem(b->offset,
 								pL->readbuf);
-		if ((inode == jNode->ino)) {
-#if 0
-			putLabeledWord("\r\n\r\nread_inode: totlen = ", jNode->totlen);
-			putLabeledWord("read_inode: inode = ", jNode->ino);
-			putLabeledWord("read_inode: version = ", jNode->version);
-			putLabeledWord("read_inode: isize = ", jNode->isize);
-			putLabeledWord("read_inode: offset = ", jNode->offset);
-			putLabeledWord("read_inode: csize = ", jNode->csize);
-			putLabeledWord("read_inode: dsize = ", jNode->dsize);
-			putLabeledWord("read_inode: compr = ", jNode->compr);
-			putLabeledWord("read_inode: usercompr = ", jNode->usercompr);
-			putLabeledWord("read_inode: flags = ", jNode->flags);
-#endif
-
-#ifndef CONFIG_SYS_JFFS2_SORT_FRAGMENTS
-			/* get actual file length from the newest node */
-			if (jNode->version >= latestVersion) {
-				totalSize = jNode->isize;
-				latestVersion = jNode->version;
-			}
-#endif
-
-			if(dest) {
-				src = ((uchar *) jNode) + sizeof(struct jffs2_raw_inode);
-				/* ignore data behind latest known EOF */
-				if (jNode->offset > totalSize) {
-					put_fl_mem(jNode, pL->readbuf);
-					continue;
-				}
-				if (b->datacrc == CRC_UNKNOWN)
-					b->datacrc = data_crc(jNode) ?
-						CRC_OK : CRC_BAD;
-				if (b->datacrc == CRC_BAD) {
-					put_fl_mem(jNode, pL->readbuf);
-					continue;
-				}
+		src = ((uchar *) jNode) + sizeof(struct jffs2_raw_inode);
+		/* ignore data behind latest known EOF */
+		if (jNode->offset > totalSize) {
+			put_fl_mem(jNode, pL->readbuf);
+			continue;
+		}
+		if (b->datacrc == CRC_NODE_OK)
+			b->datacrc = data_crc(jNode) ? CRC_OK : CRC_BAD;
+		if (b->datacrc == CRC_BAD) {
+			put_fl_mem(jNode, pL->readbuf);
+			continue;
+		}
 
-				lDest = (uchar *) (dest + jNode->offset);
-#if 0
-				putLabeledWord("read_inode: src = ", src);
-				putLabeledWord("read_inode: dest = ", lDest);
-#endif
-				switch (jNode->compr) {
-				case JFFS2_COMPR_NONE:
-					ret = (unsigned long) ldr_memcpy(lDest, src, jNode->dsize);
-					break;
-				case JFFS2_COMPR_ZERO:
-					ret = 0;
-					for (i = 0; i < jNode->dsize; i++)
-						*(lDest++) = 0;
-					break;
-				case JFFS2_COMPR_RTIME:
-					ret = 0;
-					rtime_decompress(src, lDest, jNode->csize, jNode->dsize);
-					break;
-				case JFFS2_COMPR_DYNRUBIN:
-					/* this is slow but it works */
-					ret = 0;
-					dynrubin_decompress(src, lDest, jNode->csize, jNode->dsize);
-					break;
-				case JFFS2_COMPR_ZLIB:
-					ret = zlib_decompress(src, lDest, jNode->csize, jNode->dsize);
-					break;
+		lDest = (uchar *) (dest + jNode->offset);
+		switch (jNode->compr) {
+		case JFFS2_COMPR_NONE:
+			ret = (unsigned long) ldr_memcpy(lDest, src, jNode->dsize);
+			break;
+		case JFFS2_COMPR_ZERO:
+			ret = 0;
+			for (i = 0; i < jNode->dsize; i++)
+				*(lDest++) = 0;
+			break;
+		case JFFS2_COMPR_RTIME:
+			ret = 0;
+			rtime_decompress(src, lDest, jNode->csize, jNode->dsize);
+			break;
+		case JFFS2_COMPR_DYNRUBIN:
+			/* this is slow but it works */
+			ret = 0;
+			dynrubin_decompress(src, lDest, jNode->csize, jNode->dsize);
+			break;
+		case JFFS2_COMPR_ZLIB:
+			ret = zlib_decompress(src, lDest, jNode->csize, jNode->dsize);
+			break;
 #if defined(CONFIG_JFFS2_LZO)
-				case JFFS2_COMPR_LZO:
-					ret = lzo_decompress(src, lDest, jNode->csize, jNode->dsize);
-					break;
-#endif
-				default:
-					/* unknown */
-					putLabeledWord("UNKOWN COMPRESSION METHOD = ", jNode->compr);
-					put_fl_mem(jNode, pL->readbuf);
-					return -1;
-					break;
-				}
-			}
-
-#if 0
-			putLabeledWord("read_inode: totalSize = ", totalSize);
-			putLabeledWord("read_inode: compr ret = ", ret);
+		case JFFS2_COMPR_LZO:
+			ret = lzo_decompress(src, lDest, jNode->csize, jNode->dsize);
+			break;
 #endif
+		default:
+			/* unknown */
+			putLabeledWord("UNKOWN COMPRESSION METHOD = ", jNode->compr);
+			put_fl_mem(jNode, pL->readbuf);
+			free(nodes);
+			return -1;
 		}
-		counter++;
 		put_fl_mem(jNode, pL->readbuf);
 	}
 
-#if 0
-	putLabeledWord("read_inode: returning = ", totalSize);
-#endif
+	free(nodes);
 	return totalSize;
 }
 
-/* find the inode from the slashless name given a parent */
+/*
+ * find the inode from the slashless name given a parent, and the type of
+ * its directory entry in 'type' unless that is NULL
+ */
 static u32
-jffs2_1pass_find_inode(struct b_lists * pL, const char *name, u32 pino)
+jffs2_1pass_find_inode(struct b_lists * pL, const char *name, u32 pino,
+		       u8 *type)
 {
 	struct b_node *b;
 	struct jffs2_raw_dirent *jDir;
@@ -826,13 +867,16 @@ jffs2_1pass_find_inode(struct b_lists * pL, const char *name, u32 pino)
 	u32 counter;
 	u32 version = 0;
 	u32 inode = 0;
+	u8 dtype = 0;
 
 	/* name is assumed slash free */
 	len = strlen(name);
 
 	counter = 0;
 	/* we need to search all and return the inode with the highest version */
-	for(b = pL->dir.listHead; b; b = b->next, counter++) {
+	for (b = ino_chain(&pL->dir, pino); b; b = b->hnext, counter++) {
+		if (b->ino != pino)	/* pino of the dirent */
+			continue;
 		jDir = (struct jffs2_raw_dirent *) get_node_mem(b->offset,
 								pL->readbuf);
 		if ((pino == jDir->pino) && (len == jDir->nsize) &&
@@ -851,6 +895,7 @@ jffs2_1pass_find_inode(struct b_lists * pL, const char *name, u32 pino)
 			}
 			inode = jDir->ino;
 			version = jDir->version;
+			dtype = jDir->type;
 		}
 #if 0
 		putstr("\r\nfind_inode:p&l ->");
@@ -863,6 +908,8 @@ jffs2_1pass_find_inode(struct b_lists * pL, const char *name, u32 pino)
 #endif
 		put_fl_mem(jDir, pL->readbuf);
 	}
+	if (type)
+		*type = dtype;
 	return inode;
 }
 
@@ -954,19 +1001,24 @@ jffs2_1pass_list_inodes(struct b_lists * pL, u32 pino)
 	struct b_node *b;
 	struct jffs2_raw_dirent *jDir;
 
-	for (b = pL->dir.listHead; b; b = b->next) {
+	for (b = ino_chain(&pL->dir, pino); b; b = b->hnext) {
+		if (b->ino != pino)
+			continue;
 		jDir = (struct jffs2_raw_dirent *) get_node_mem(b->offset,
 								pL->readbuf);
 		if ((pino == jDir->pino) && (jDir->ino)) { /* ino=0 -> unlink */
 			u32 i_version = 0;
 			struct jffs2_raw_inode ojNode;
 			struct jffs2_raw_inode *jNode, *i = NULL;
-			struct b_node *b2 = pL->frag.listHead;
+			struct b_node *b2 = ino_chain(&pL->frag, jDir->ino);
 
-			while (b2) {
+			for (; b2; b2 = b2->hnext) {
+				if (b2->ino != jDir->ino)
+					continue;
 				jNode = (struct jffs2_raw_inode *)
 					get_fl_mem(b2->offset, sizeof(ojNode), &ojNode);
-				if (jNode->ino == jDir->ino && jNode->version >= i_version) {
+				if (inode_node_ok(b2, jNode) &&
+				    jNode->version >= i_version) {
 					i_version = jNode->version;
 					if (i)
 						put_fl_mem(i, NULL);
@@ -979,7 +1031,6 @@ jffs2_1pass_list_inodes(struct b_lists * pL, u32 pino)
 							       sizeof(*i),
 							       NULL);
 				}
-				b2 = b2->next;
 			}
 
 			dump_inode(pL, jDir, i);
@@ -990,8 +1041,14 @@ jffs2_1pass_list_inodes(struct b_lists * pL, u32 pino)
 	return pino;
 }
 
+/*
+ * Resolve the path 'fname' starting at directory 'pino'. Unless they are
+ * NULL, 'type' and 'dir' return the type of the last directory entry and
+ * the inode of the directory holding it.
+ */
 static u32
-jffs2_1pass_search_inode(struct b_lists * pL, const char *fname, u32 pino)
+jffs2_1pass_search_inode(struct b_lists * pL, const char *fname, u32 pino,
+			 u8 *type, u32 *dir)
 {
 	int i;
 	char tmp[256];
@@ -1028,15 +1085,18 @@ jffs2_1pass_search_inode(struct b_lists * pL, const char *fname, u32 pino)
 		putstr("\r\n");
 #endif
 
-		if (!(pino = jffs2_1pass_find_inode(pL, working_tmp, pino))) {
+		if (!(pino = jffs2_1pass_find_inode(pL, working_tmp, pino,
+						    NULL))) {
 			putstr("find_inode failed for name=");
 			putstr(working_tmp);
 			putstr("\r\n");
 			return 0;
 		}
 	}
+	if (dir)
+		*dir = pino;
 	/* this is for the bare filename, directories have already been mapped */
-	if (!(pino = jffs2_1pass_find_inode(pL, tmp, pino))) {
+	if (!(pino = jffs2_1pass_find_inode(pL, tmp, pino, type))) {
 		putstr("find_inode failed for name=");
 		putstr(tmp);
 		putstr("\r\n");
@@ -1046,56 +1106,29 @@ jffs2_1pass_search_inode(struct b_lists * pL, const char *fname, u32 pino)
 
 }
 
+/*
+ * Follow 'ino' if it is a symlink; 'type' is the type of the directory
+ * entry it was found by, in directory 'pino'.
+ */
 static u32
-jffs2_1pass_resolve_inode(struct b_lists * pL, u32 ino)
+jffs2_1pass_resolve_inode(struct b_lists * pL, u32 ino, u8 type, u32 pino)
 {
-	struct b_node *b;
 	struct b_node *b2;
-	struct jffs2_raw_dirent *jDir;
 	struct jffs2_raw_inode *jNode;
-	u8 jDirFoundType = 0;
-	u32 jDirFoundIno = 0;
-	u32 jDirFoundPino = 0;
 	char tmp[256];
-	u32 version = 0;
-	u32 pino;
 	unsigned char *src;
 
-	/* we need to search all and return the inode with the highest version */
-	for(b = pL->dir.listHead; b; b = b->next) {
-		jDir = (struct jffs2_raw_dirent *) get_node_mem(b->offset,
-								pL->readbuf);
-		if (ino == jDir->ino) {
-			if (jDir->version < version) {
-				put_fl_mem(jDir, pL->readbuf);
-				continue;
-			}
-
-			if (jDir->version == version && jDirFoundType) {
-				/* I'm pretty sure this isn't legal */
-				putstr(" ** ERROR ** ");
-				putnstr(jDir->name, jDir->nsize);
-				putLabeledWord(" has dup version (resolve) = ",
-					version);
-			}
-
-			jDirFoundType = jDir->type;
-			jDirFoundIno = jDir->ino;
-			jDirFoundPino = jDir->pino;
-			version = jDir->version;
-		}
-		put_fl_mem(jDir, pL->readbuf);
-	}
-	/* now we found the right entry again. (shoulda returned inode*) */
-	if (jDirFoundType != DT_LNK)
-		return jDirFoundIno;
+	if (type != DT_LNK)
+		return ino;
 
 	/* it's a soft link so we follow it again. */
-	b2 = pL->frag.listHead;
-	while (b2) {
+	tmp[0] = '\0';
+	for (b2 = ino_chain(&pL->frag, ino); b2; b2 = b2->hnext) {
+		if (b2->ino != ino)
+			continue;
 		jNode = (struct jffs2_raw_inode *) get_node_mem(b2->offset,
 								pL->readbuf);
-		if (jNode->ino == jDirFoundIno) {
+		if (inode_node_ok(b2, jNode)) {
 			src = (unsigned char *)jNode + sizeof(struct jffs2_raw_inode);
 
 #if 0
@@ -1109,17 +1142,14 @@ jffs2_1pass_resolve_inode(struct b_lists * pL, u32 ino)
 			put_fl_mem(jNode, pL->readbuf);
 			break;
 		}
-		b2 = b2->next;
 		put_fl_mem(jNode, pL->readbuf);
 	}
 	/* ok so the name of the new file to find is in tmp */
 	/* if it starts with a slash it is root based else shared dirs */
 	if (tmp[0] == '/')
 		pino = 1;
-	else
-		pino = jDirFoundPino;
 
-	return jffs2_1pass_search_inode(pL, tmp, pino);
+	return jffs2_1pass_search_inode(pL, tmp, pino, NULL, NULL);
 }
 
 static u32
@@ -1144,7 +1174,8 @@ jffs2_1pass_search_list_inodes(struct b_lists * pL, const char *fname, u32 pino)
 			tmp[i] = c[i + 1];
 		tmp[i] = '\0';
 		/* only a failure if we arent looking at top level */
-		if (!(pino = jffs2_1pass_find_inode(pL, working_tmp, pino)) &&
+		if (!(pino = jffs2_1pass_find_inode(pL, working_tmp, pino,
+						    NULL)) &&
 		    (working_tmp[0])) {
 			putstr("find_inode failed for name=");
 			putstr(working_tmp);
@@ -1153,7 +1184,7 @@ jffs2_1pass_search_list_inodes(struct b_lists * pL, const char *fname, u32 pino)
 		}
 	}
 
-	if (tmp[0] && !(pino = jffs2_1pass_find_inode(pL, tmp, pino))) {
+	if (tmp[0] && !(pino = jffs2_1pass_find_inode(pL, tmp, pino, NULL))) {
 		putstr("find_inode failed for name=");
 		putstr(tmp);
 		putstr("\r\n");
@@ -1256,7 +1287,9 @@ static int jffs2_sum_process_sum_data(struct part_info *part, uint32_t offset,
 							(u32)part->offset +
 							offset +
 							sum_get_unaligned32(
-								&spi->offset));
+								&spi->offset),
+							sum_get_unaligned32(
+								&spi->inode));
 						if (ret == NULL)
 							return -1;
 					}
@@ -1273,7 +1306,9 @@ static int jffs2_sum_process_sum_data(struct part_info *part, uint32_t offset,
 							(u32) part->offset +
 							offset +
 							sum_get_unaligned32(
-								&spd->offset));
+								&spd->offset),
+							sum_get_unaligned32(
+								&spd->pino));
 						if (ret == NULL)
 							return -1;
 					}
@@ -1430,6 +1465,17 @@ dump_dirents(struct b_lists *pL)
 
 #define DEFAULT_EMPTY_SCAN_SIZE	4096
 
+/* Remember where the free space of a sector starts, for the scan cache */
+#ifdef CONFIG_JFFS2_SCAN_CACHE
+#define SET_SECTOR_USED(pL, i, used)				\
+	do {							\
+		if ((pL)->sector_used != NULL)			\
+			(pL)->sector_used[i] = (used);		\
+	} while (0)
+#else
+#define SET_SECTOR_USED(pL, i, used)	do {} while (0)
+#endif
+
 static inline uint32_t EMPTY_SCAN_SIZE(uint32_t sector_size)
 {
 	if (sector_size < DEFAULT_EMPTY_SCAN_SIZE)
@@ -1460,6 +1506,9 @@ jffs2_1pass_build_lists(struct part_info * part)
 	/* if we are building a list we need to refresh the cache. */
 	jffs_init_1pass_list(part);
 	pL = (struct b_lists *)part->jffs2_priv;
+#ifdef CONFIG_JFFS2_SCAN_CACHE
+	pL->sector_used = malloc(nr_sectors * sizeof(u32));
+#endif
 	buf = malloc(buf_size);
 	puts ("Scanning JFFS2 FS:   ");
 
@@ -1477,6 +1526,7 @@ jffs2_1pass_build_lists(struct part_info * part)
 #endif
 
 		WATCHDOG_RESET();
+		SET_SECTOR_USED(pL, i, part->sector_size);
 
 #ifdef CONFIG_JFFS2_SUMMARY
 		buf_len = sizeof(*sm);
@@ -1545,8 +1595,10 @@ jffs2_1pass_build_lists(struct part_info * part)
 				*(uint32_t *)(&buf[ofs]) == 0xFFFFFFFF)
 			ofs += 4;
 
-		if (ofs == EMPTY_SCAN_SIZE(part->sector_size))
+		if (ofs == EMPTY_SCAN_SIZE(part->sector_size)) {
+			SET_SECTOR_USED(pL, i, 0);
 			continue;
+		}
 
 		ofs += sector_ofs;
 		prevofs = ofs - 1;
@@ -1606,6 +1658,8 @@ jffs2_1pass_build_lists(struct part_info * part)
 					 * empty space as dirty (because it's
 					 * not)
 					 */
+					SET_SECTOR_USED(pL, i,
+							empty_start - sector_ofs);
 					break;
 				}
 				scan_end = buf_len;
@@ -1636,11 +1690,10 @@ jffs2_1pass_build_lists(struct part_info * part)
 					buf_ofs = ofs;
 					node = (void *)buf;
 				}
-				if (!inode_crc((struct jffs2_raw_inode *) node))
-				       break;
-
+				/* the node CRC is checked when it is used */
 				if (insert_node(&pL->frag, (u32) part->offset +
-						ofs) == NULL) {
+						ofs, ((struct jffs2_raw_inode *)
+						      node)->ino) == NULL) {
 					free(buf);
 					jffs2_free_cache(part);
 					return 0;
@@ -1670,7 +1723,8 @@ jffs2_1pass_build_lists(struct part_info * part)
 				if (! (counterN%100))
 					puts ("\b\b.  ");
 				if (insert_node(&pL->dir, (u32) part->offset +
-						ofs) == NULL) {
+						ofs, ((struct jffs2_raw_dirent *)
+						      node)->pino) == NULL) {
 					free(buf);
 					jffs2_free_cache(part);
 					return 0;
@@ -1713,6 +1767,9 @@ jffs2_1pass_build_lists(struct part_info * part)
 	 * from flash (NOR).
 	 */
 	pL->readbuf = malloc(max_totlen);
+#ifdef CONFIG_JFFS2_SCAN_CACHE
+	pL->max_totlen = max_totlen;
+#endif
 
 	/* turn the lcd back on. */
 	/* splash(); */
@@ -1739,6 +1796,213 @@ jffs2_1pass_build_lists(struct part_info * part)
 }
 
 
+#ifdef CONFIG_JFFS2_SCAN_CACHE
+/*
+ * Scan cache
+ *
+ * The node lists built by a scan are saved, together with a fingerprint
+ * of the partition, in a RAM area that survives resets or in a NOR flash
+ * sector (CONFIG_JFFS2_SCAN_CACHE_FLASH), so that later boots don't have
+ * to scan the partition again. JFFS2 only ever appends nodes to the free
+ * space at the end of a sector or erases whole sectors, so it is enough
+ * to remember for each sector where its free space starts and a CRC of
+ * its first bytes, and check that these are unchanged.
+ */
+#ifndef CONFIG_JFFS2_SCAN_CACHE_SIZE
+#define CONFIG_JFFS2_SCAN_CACHE_SIZE	0x10000
+#endif
+
+#define JFFS2_SCAN_CACHE_MAGIC	0x4a325343	/* "J2SC" */
+#define JFFS2_SCAN_CACHE_HEAD	64	/* bytes of each sector in the CRC */
+
+struct jffs2_scan_cache {
+	u32	magic;
+	u32	crc;		/* of the rest, starting at length */
+	u32	length;		/* of the whole cache */
+	u32	dev_type;
+	u32	dev_num;
+	u32	part_offset;
+	u32	part_size;
+	u32	sector_size;
+	u32	dir_count;
+	u32	frag_count;
+	u32	max_totlen;
+	/*
+	 * Followed by the free space start and CRC of each sector, then
+	 * the offset and (parent) inode number of the dirent and of the
+	 * inode nodes
+	 */
+};
+
+/* Append a node, keeping the order of the saved list */
+static struct b_node *
+append_node(struct b_list *list, u32 offset, u32 ino)
+{
+	struct b_node *new;
+
+	if (!(new = add_node(list)))
+		return NULL;
+	new->offset = offset;
+	new->ino = ino;
+	new->datacrc = CRC_UNKNOWN;
+	new->next = NULL;
+	if (list->listTail != NULL)
+		list->listTail->next = new;
+	else
+		list->listHead = new;
+	list->listTail = new;
+	return new;
+}
+
+/*
+ * Check that sector 'i' has free space starting at 'used' and return
+ * the CRC of its first bytes in 'crc'. Return -1 if it has no such
+ * free space.
+ */
+static int
+jffs2_sector_fingerprint(struct part_info *part, u32 i, u32 used, u32 *crc)
+{
+	u32 sector = part->offset + i * part->sector_size;
+	u32 head[JFFS2_SCAN_CACHE_HEAD / 4];
+	u32 word;
+	u32 len;
+
+	if (used > part->sector_size)
+		return -1;
+	if (used < part->sector_size) {
+		get_fl_mem(sector + used, sizeof(word), &word);
+		if (word != 0xffffffff)
+			return -1;
+	}
+
+	len = min_t(u32, used, sizeof(head));
+	get_fl_mem(sector, len, head);
+	*crc = crc32_no_comp(0, (uchar *)head, len);
+	return 0;
+}
+
+static int
+jffs2_scan_cache_load(struct part_info *part)
+{
+	struct jffs2_scan_cache *sc =
+		(struct jffs2_scan_cache *)CONFIG_JFFS2_SCAN_CACHE_ADDR;
+	struct mtdids *id = part->dev->id;
+	u32 nr_sectors = part->size / part->sector_size;
+	struct b_lists *pL;
+	u32 *p, i, crc;
+
+	if (sc->magic != JFFS2_SCAN_CACHE_MAGIC ||
+	    sc->dev_type != id->type || sc->dev_num != id->num ||
+	    sc->part_offset != part->offset ||
+	    sc->part_size != part->size ||
+	    sc->sector_size != part->sector_size ||
+	    sc->length > CONFIG_JFFS2_SCAN_CACHE_SIZE ||
+	    sc->length != sizeof(*sc) + 2 * (nr_sectors + sc->dir_count +
+					     sc->frag_count) * sizeof(u32) ||
+	    sc->crc != crc32_no_comp(0, (uchar *)&sc->length,
+				     sc->length - 8))
+		return 0;
+
+	p = (u32 *)(sc + 1);
+	for (i = 0; i < nr_sectors; i++, p += 2) {
+		if (jffs2_sector_fingerprint(part, i, p[0], &crc) ||
+		    crc != p[1]) {
+			DEBUGF ("scan cache: sector %d changed\n", i);
+			return 0;
+		}
+	}
+
+	jffs_init_1pass_list(part);
+	if ((pL = (struct b_lists *)part->jffs2_priv) == NULL)
+		return 0;
+	for (i = 0; i < sc->dir_count; i++, p += 2)
+		if (append_node(&pL->dir, p[0], p[1]) == NULL)
+			goto fail;
+	for (i = 0; i < sc->frag_count; i++, p += 2)
+		if (append_node(&pL->frag, p[0], p[1]) == NULL)
+			goto fail;
+	pL->readbuf = malloc(sc->max_totlen);
+	pL->max_totlen = sc->max_totlen;
+
+	puts ("Using JFFS2 scan cache\n");
+	return 1;
+
+fail:
+	jffs2_free_cache(part);
+	return 0;
+}
+
+static void
+jffs2_scan_cache_save(struct part_info *part)
+{
+	struct b_lists *pL = (struct b_lists *)part->jffs2_priv;
+	struct mtdids *id = part->dev->id;
+	u32 nr_sectors = part->size / part->sector_size;
+	struct jffs2_scan_cache *sc;
+	struct b_node *b;
+	u32 len, i, *p;
+
+	if (pL->sector_used == NULL)
+		return;
+
+	len = sizeof(*sc) + 2 * (nr_sectors + pL->dir.listCount +
+				 pL->frag.listCount) * sizeof(u32);
+	if (len > CONFIG_JFFS2_SCAN_CACHE_SIZE) {
+		printf("JFFS2 scan cache too small, %u bytes needed\n", len);
+		return;
+	}
+
+#ifdef CONFIG_JFFS2_SCAN_CACHE_FLASH
+	if ((sc = malloc(len)) == NULL)
+		return;
+#else
+	sc = (struct jffs2_scan_cache *)CONFIG_JFFS2_SCAN_CACHE_ADDR;
+#endif
+	sc->magic = 0;
+
+	p = (u32 *)(sc + 1);
+	for (i = 0; i < nr_sectors; i++, p += 2) {
+		p[0] = pL->sector_used[i];
+		if (jffs2_sector_fingerprint(part, i, p[0], &p[1]))
+			goto out;
+	}
+	for (b = pL->dir.listHead; b != NULL; b = b->next, p += 2) {
+		p[0] = b->offset;
+		p[1] = b->ino;
+	}
+	for (b = pL->frag.listHead; b != NULL; b = b->next, p += 2) {
+		p[0] = b->offset;
+		p[1] = b->ino;
+	}
+
+	sc->length = len;
+	sc->dev_type = id->type;
+	sc->dev_num = id->num;
+	sc->part_offset = part->offset;
+	sc->part_size = part->size;
+	sc->sector_size = part->sector_size;
+	sc->dir_count = pL->dir.listCount;
+	sc->frag_count = pL->frag.listCount;
+	sc->max_totlen = pL->max_totlen;
+	sc->crc = crc32_no_comp(0, (uchar *)&sc->length, len - 8);
+	sc->magic = JFFS2_SCAN_CACHE_MAGIC;
+
+#ifdef CONFIG_JFFS2_SCAN_CACHE_FLASH
+	if (memcmp((void *)CONFIG_JFFS2_SCAN_CACHE_ADDR, sc, len) != 0 &&
+	    (flash_sect_erase(CONFIG_JFFS2_SCAN_CACHE_ADDR,
+			      CONFIG_JFFS2_SCAN_CACHE_ADDR +
+			      CONFIG_JFFS2_SCAN_CACHE_SIZE - 1) != 0 ||
+	     flash_write((char *)sc, CONFIG_JFFS2_SCAN_CACHE_ADDR, len) != 0))
+		puts ("JFFS2 scan cache: flash write failed\n");
+#endif
+out:
+#ifdef CONFIG_JFFS2_SCAN_CACHE_FLASH
+	free(sc);
+#endif
+	return;
+}
+#endif /* CONFIG_JFFS2_SCAN_CACHE */
+
 static u32
 jffs2_1pass_fill_info(struct b_lists * pL, struct b_jffs2_info * piL)
 {
@@ -1771,14 +2035,27 @@ jffs2_1pass_fill_info(struct b_lists * pL, struct b_jffs2_info * piL)
 static struct b_lists *
 jffs2_get_list(struct part_info * part, const char *who)
 {
+	struct b_lists *pL;
+
 	/* copy requested part_info struct pointer to global location */
 	current_part = part;
 
 	if (jffs2_1pass_rescan_needed(part)) {
+#ifdef CONFIG_JFFS2_SCAN_CACHE
+		if (jffs2_scan_cache_load(part))
+			goto index;
+#endif
 		if (!jffs2_1pass_build_lists(part)) {
 			printf("%s: Failed to scan JFFSv2 file structure\n", who);
 			return NULL;
 		}
+#ifdef CONFIG_JFFS2_SCAN_CACHE
+		jffs2_scan_cache_save(part);
+	index:
+#endif
+		pL = (struct b_lists *)part->jffs2_priv;
+		jffs2_index_list(&pL->dir);
+		jffs2_index_list(&pL->frag);
 	}
 	return (struct b_lists *)part->jffs2_priv;
 }
@@ -1818,17 +2095,19 @@ jffs2_1pass_load(char *dest, struct part_info * part, const char *fname)
 	struct b_lists *pl;
 	long ret = 1;
 	u32 inode;
+	u32 dir;
+	u8 type;
 
 	if (! (pl  = jffs2_get_list(part, "load")))
 		return 0;
 
-	if (! (inode = jffs2_1pass_search_inode(pl, fname, 1))) {
+	if (! (inode = jffs2_1pass_search_inode(pl, fname, 1, &type, &dir))) {
 		putstr("load: Failed to find inode\r\n");
 		return 0;
 	}
 
 	/* Resolve symlinks */
-	if (! (inode = jffs2_1pass_resolve_inode(pl, inode))) {
+	if (! (inode = jffs2_1pass_resolve_inode(pl, inode, type, dir))) {
 		putstr("load: Failed to resolve inode structure\r\n");
 		return 0;
 	}
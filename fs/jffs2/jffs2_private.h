@@ -4,10 +4,16 @@
 #include <jffs2/jffs2.h>
 
 
+/* Number of inode hash chains per list, a power of two */
+#define JFFS2_INO_HASH_SIZE	256
+
 struct b_node {
 	u32 offset;
+	u32 ino;		/* inode number, parent's for dirents */
 	struct b_node *next;
-	enum { CRC_UNKNOWN = 0, CRC_OK, CRC_BAD } datacrc;
+	struct b_node *hnext;	/* next node with the same ino hash */
+	/* inode nodes are CRC checked when first used */
+	enum { CRC_UNKNOWN = 0, CRC_OK, CRC_BAD, CRC_NODE_OK } datacrc;
 };
 
 struct b_list {
@@ -20,12 +26,18 @@ struct b_list {
 #endif
 	u32 listCount;
 	struct mem_block *listMemBase;
+	/* the nodes by ino, in list order; built by jffs2_index_list() */
+	struct b_node *hash[JFFS2_INO_HASH_SIZE];
 };
 
 struct b_lists {
 	struct b_list dir;
 	struct b_list frag;
 	void *readbuf;
+#ifdef CONFIG_JFFS2_SCAN_CACHE
+	u32 *sector_used;	/* start of the free space of each sector */
+	u32 max_totlen;
+#endif
 };
 
 struct b_compr_info {
@@ -0,0 +1,872 @@
+/*
+ * SquashFS 4.0 read-only filesystem
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston,
+ * MA 02111-1307 USA
+ *
+ * Reads images on a block device partition or mapped in memory (NOR).
+ * gzip and, with CONFIG_LZMA, lzma compressed images are supported.
+ */
+
+#include <common.h>
+#include <malloc.h>
+#include <watchdog.h>
+#include <part.h>
+#include <asm/byteorder.h>
+#include <squashfs.h>
+#include <squashfs/squashfs_fs.h>
+#ifdef CONFIG_LZMA
+#include <lzma/LzmaTypes.h>
+#include <lzma/LzmaDec.h>
+#include <lzma/LzmaTools.h>
+#endif
+
+#define SECTOR_SIZE		512
+
+/* Maximum nesting of symlinks, used to prevent a loop */
+#define SQFS_MAX_SYMLINKS	8
+/* Maximum depth of a path */
+#define SQFS_MAX_DEPTH		32
+
+/*
+ * Decompressed metadata blocks (inodes, directories, fragment table)
+ * and fragment blocks are kept in two small LRU caches, so that walking
+ * directories and reading the tails of small files does not decompress
+ * the same blocks again and again. Both are kept across commands as
+ * long as the same image is mounted.
+ */
+#ifndef CONFIG_SQUASHFS_METADATA_CACHE_BLOCKS
+#define CONFIG_SQUASHFS_METADATA_CACHE_BLOCKS	8
+#endif
+#ifndef CONFIG_SQUASHFS_FRAGMENT_CACHE_BLOCKS
+#define CONFIG_SQUASHFS_FRAGMENT_CACHE_BLOCKS	2
+#endif
+
+struct sqfs_cache_entry {
+	u64		block;		/* Disk offset of the block */
+	u64		next;		/* Disk offset of the next metadata block */
+	int		len;		/* Decompressed length */
+	unsigned int	used;		/* LRU stamp, 0 if the slot is free */
+	char		*data;
+};
+
+static struct sqfs_cache_entry meta_cache[CONFIG_SQUASHFS_METADATA_CACHE_BLOCKS];
+static struct sqfs_cache_entry frag_cache[CONFIG_SQUASHFS_FRAGMENT_CACHE_BLOCKS];
+static unsigned int sqfs_cache_clock;
+
+/* Where the image is read from */
+struct sqfs_source {
+	block_dev_desc_t	*dev;		/* NULL for an image in memory */
+	unsigned long		media_gen;
+	disk_partition_t	part;
+	ulong			addr;		/* Memory image */
+};
+
+static struct sqfs_source sqfs_src;
+
+/* The mounted image */
+static struct {
+	int			valid;
+	struct sqfs_source	src;
+	struct squashfs_super_block sb;
+	u32			block_size;
+	u64			*frag_index;	/* Fragment table index */
+	char			*cbuf;		/* Compressed data */
+	char			*dbuf;		/* Partially wanted blocks */
+} sqfs;
+
+/* A decoded inode */
+struct sqfs_inode {
+	int		type;		/* Basic type, long types folded in */
+	u64		size;
+	u64		start;		/* Data or directory start block */
+	u32		frag;
+	u32		frag_offset;
+	u32		dir_offset;
+	u64		mblock;		/* Block list or symlink target */
+	int		moffset;
+};
+
+static void sqfs_cache_flush (struct sqfs_cache_entry *cache, int n)
+{
+	int i;
+
+	for (i = 0; i < n; i++) {
+		free(cache[i].data);
+		cache[i].data = NULL;
+		cache[i].used = 0;
+	}
+}
+
+/*
+ * Return the entry of 'cache' holding 'block' and set '*hit', or else
+ * the least recently used entry, with room for 'size' bytes of data.
+ * NULL if no memory.
+ */
+static struct sqfs_cache_entry *sqfs_cache_get (struct sqfs_cache_entry *cache,
+						int n, u64 block, int size,
+						int *hit)
+{
+	int i, victim = 0;
+
+	for (i = 0; i < n; i++) {
+		if (cache[i].used && cache[i].block == block) {
+			cache[i].used = ++sqfs_cache_clock;
+			*hit = 1;
+			return &cache[i];
+		}
+		if (cache[i].used < cache[victim].used)
+			victim = i;
+	}
+
+	*hit = 0;
+	cache[victim].used = 0;
+	if (cache[victim].data == NULL) {
+		cache[victim].data = malloc(size);
+		if (cache[victim].data == NULL) {
+			printf("** squashfs: cache malloc failed **\n");
+			return NULL;
+		}
+	}
+	cache[victim].block = block;
+	return &cache[victim];
+}
+
+int sqfs_set_blk_dev (block_dev_desc_t *dev_desc, int part)
+{
+	sqfs_src.dev = dev_desc;
+	sqfs_src.media_gen = dev_desc->media_gen;
+	sqfs_src.addr = 0;
+
+	if (part == 0) {
+		/* disk doesn't use partition table */
+		sqfs_src.part.start = 0;
+		sqfs_src.part.size = dev_desc->lba;
+		sqfs_src.part.blksz = dev_desc->blksz;
+	} else if (get_partition_info(dev_desc, part, &sqfs_src.part)) {
+		return -1;
+	}
+	if (sqfs_src.part.blksz != SECTOR_SIZE)
+		return -1;
+	return 0;
+}
+
+void sqfs_set_mem (ulong addr)
+{
+	memset(&sqfs_src, 0, sizeof(sqfs_src));
+	sqfs_src.addr = addr;
+}
+
+/*
+ * Return a pointer to 'offset' in the image if it is mapped in memory,
+ * so that it can be decompressed in place. NULL otherwise.
+ */
+static void *sqfs_map (u64 offset)
+{
+	if (sqfs_src.dev != NULL)
+		return NULL;
+	return (void *)(sqfs_src.addr + (ulong)offset);
+}
+
+/*
+ * Read 'len' bytes at byte 'offset' of the image. Return 0 on success.
+ */
+static int sqfs_devread (u64 offset, u32 len, void *buf)
+{
+	char sec_buf[SECTOR_SIZE];
+	lbaint_t sector;
+	u32 skip, n;
+
+	if (sqfs_src.dev == NULL) {
+		memcpy(buf, sqfs_map(offset), len);
+		return 0;
+	}
+
+	sector = offset / SECTOR_SIZE;
+	skip = offset % SECTOR_SIZE;
+	if (sector + (skip + len + SECTOR_SIZE - 1) / SECTOR_SIZE >
+	    sqfs_src.part.size) {
+		printf("** squashfs: read outside partition **\n");
+		return -1;
+	}
+	sector += sqfs_src.part.start;
+
+	/* First part which isn't aligned with the start of a sector */
+	if (skip != 0) {
+		if (blk_dread(sqfs_src.dev, sector, 1,
+			      (ulong *)sec_buf) != 1)
+			goto err;
+		n = min(SECTOR_SIZE - skip, len);
+		memcpy(buf, sec_buf + skip, n);
+		buf += n;
+		len -= n;
+		sector++;
+	}
+
+	/* Whole sectors straight into the buffer */
+	n = len / SECTOR_SIZE;
+	if (n != 0) {
+		if (blk_dread(sqfs_src.dev, sector, n, (ulong *)buf) != n)
+			goto err;
+		buf += n * SECTOR_SIZE;
+		len -= n * SECTOR_SIZE;
+		sector += n;
+	}
+
+	/* Rest */
+	if (len != 0) {
+		if (blk_dread(sqfs_src.dev, sector, 1,
+			      (ulong *)sec_buf) != 1)
+			goto err;
+		memcpy(buf, sec_buf, len);
+	}
+	return 0;
+
+err:
+	printf("** squashfs: read error **\n");
+	return -1;
+}
+
+/*
+ * Decompress 'srclen' bytes at 'src' to at most 'dstlen' bytes at 'dst'.
+ * Return the decompressed length or -1 on errors.
+ */
+static int sqfs_decompress (void *dst, int dstlen, void *src, int srclen)
+{
+	switch (le16_to_cpu(sqfs.sb.compression)) {
+	case ZLIB_COMPRESSION: {
+		unsigned long len = srclen;
+
+		/* zlib stream: skip the two byte header, ignore the adler32 */
+		if (zunzip(dst, dstlen, src, &len, 1, 2) != 0)
+			return -1;
+		return len;
+	}
+#ifdef CONFIG_LZMA
+	case LZMA_COMPRESSION: {
+		unsigned char *hdr = src;
+		SizeT len;
+
+		/* lzma "alone" header: properties and 64-bit uncompressed size */
+		if (srclen < LZMA_PROPS_SIZE + 8)
+			return -1;
+		len = (SizeT)hdr[LZMA_PROPS_SIZE] |
+		      ((SizeT)hdr[LZMA_PROPS_SIZE + 1] << 8) |
+		      ((SizeT)hdr[LZMA_PROPS_SIZE + 2] << 16) |
+		      ((SizeT)hdr[LZMA_PROPS_SIZE + 3] << 24);
+		if (hdr[LZMA_PROPS_SIZE + 4] | hdr[LZMA_PROPS_SIZE + 5] |
+		    hdr[LZMA_PROPS_SIZE + 6] | hdr[LZMA_PROPS_SIZE + 7])
+			return -1;
+		if (len > (SizeT)dstlen)
+			return -1;
+		if (lzmaBuffToBuffDecompress(dst, &len, src, srclen) != SZ_OK)
+			return -1;
+		return len;
+	}
+#endif
+	default:
+		return -1;
+	}
+}
+
+/*
+ * Read the data or fragment block at disk offset 'start' whose size
+ * word is 'size' into 'dst', which has room for 'dstlen' bytes. Return
+ * the length of the block or -1 on errors.
+ */
+static int sqfs_read_block (u64 start, u32 size, char *dst, int dstlen)
+{
+	u32 csize = SQUASHFS_COMPRESSED_SIZE_BLOCK(size);
+	void *src;
+	int len;
+
+	if (csize > sqfs.block_size)
+		goto err;
+
+	if (!SQUASHFS_COMPRESSED_BLOCK(size)) {
+		if (csize > dstlen)
+			goto err;
+		if (sqfs_devread(start, csize, dst))
+			return -1;
+		return csize;
+	}
+
+	src = sqfs_map(start);
+	if (src == NULL) {
+		if (sqfs_devread(start, csize, sqfs.cbuf))
+			return -1;
+		src = sqfs.cbuf;
+	}
+	len = sqfs_decompress(dst, dstlen, src, csize);
+	if (len < 0)
+		goto err;
+	return len;
+
+err:
+	printf("** squashfs: bad data block at 0x%llx **\n", start);
+	return -1;
+}
+
+/*
+ * Return the decompressed metadata block at disk offset 'block' from
+ * the metadata cache, reading it if needed. NULL on errors.
+ */
+static struct sqfs_cache_entry *sqfs_metadata_block (u64 block)
+{
+	struct sqfs_cache_entry *e;
+	__le16 hdr;
+	u32 csize;
+	void *src;
+	int hit;
+
+	e = sqfs_cache_get(meta_cache, CONFIG_SQUASHFS_METADATA_CACHE_BLOCKS,
+			   block, SQUASHFS_METADATA_SIZE, &hit);
+	if (e == NULL || hit)
+		return e;
+
+	if (sqfs_devread(block, sizeof(hdr), &hdr))
+		return NULL;
+	csize = SQUASHFS_COMPRESSED_SIZE(le16_to_cpu(hdr));
+	if (csize > SQUASHFS_METADATA_SIZE)
+		goto err;
+
+	if (SQUASHFS_COMPRESSED(le16_to_cpu(hdr))) {
+		src = sqfs_map(block + sizeof(hdr));
+		if (src == NULL) {
+			if (sqfs_devread(block + sizeof(hdr), csize, sqfs.cbuf))
+				return NULL;
+			src = sqfs.cbuf;
+		}
+		e->len = sqfs_decompress(e->data, SQUASHFS_METADATA_SIZE,
+					 src, csize);
+		if (e->len < 0)
+			goto err;
+	} else {
+		if (sqfs_devread(block + sizeof(hdr), csize, e->data))
+			return NULL;
+		e->len = csize;
+	}
+	e->next = block + sizeof(hdr) + csize;
+	e->used = ++sqfs_cache_clock;
+	return e;
+
+err:
+	printf("** squashfs: bad metadata block at 0x%llx **\n", block);
+	return NULL;
+}
+
+/*
+ * Read 'len' bytes of metadata starting at 'offset' into the block at
+ * '*block', continuing into the following blocks as needed. The
+ * position is advanced past the data read. Return 0 on success.
+ */
+static int sqfs_read_metadata (u64 *block, int *offset, void *buf, int len)
+{
+	struct sqfs_cache_entry *e;
+	int n;
+
+	while (len > 0) {
+		e = sqfs_metadata_block(*block);
+		if (e == NULL)
+			return -1;
+		if (*offset >= e->len) {
+			if (*offset > e->len)
+				return -1;
+			*block = e->next;
+			*offset = 0;
+			continue;
+		}
+		n = min(len, e->len - *offset);
+		memcpy(buf, e->data + *offset, n);
+		buf += n;
+		len -= n;
+		*offset += n;
+	}
+	return 0;
+}
+
+static int sqfs_read_inode (u64 ref, struct sqfs_inode *inode)
+{
+	struct squashfs_base_inode base;
+	u64 block = le64_to_cpu(sqfs.sb.inode_table_start) +
+		SQUASHFS_INODE_BLK(ref);
+	int offset = SQUASHFS_INODE_OFFSET(ref);
+
+	if (sqfs_read_metadata(&block, &offset, &base, sizeof(base)))
+		return -1;
+
+	memset(inode, 0, sizeof(*inode));
+	inode->type = le16_to_cpu(base.inode_type);
+	inode->frag = SQUASHFS_INVALID_FRAG;
+
+	switch (inode->type) {
+	case SQUASHFS_DIR_TYPE: {
+		struct squashfs_dir_inode dir;
+
+		if (sqfs_read_metadata(&block, &offset, &dir, sizeof(dir)))
+			return -1;
+		inode->start = le32_to_cpu(dir.start_block);
+		inode->size = le16_to_cpu(dir.file_size);
+		inode->dir_offset = le16_to_cpu(dir.offset);
+		break;
+	}
+	case SQUASHFS_LDIR_TYPE: {
+		struct squashfs_ldir_inode dir;
+
+		if (sqfs_read_metadata(&block, &offset, &dir, sizeof(dir)))
+			return -1;
+		inode->type = SQUASHFS_DIR_TYPE;
+		inode->start = le32_to_cpu(dir.start_block);
+		inode->size = le32_to_cpu(dir.file_size);
+		inode->dir_offset = le16_to_cpu(dir.offset);
+		break;
+	}
+	case SQUASHFS_REG_TYPE: {
+		struct squashfs_reg_inode reg;
+
+		if (sqfs_read_metadata(&block, &offset, &reg, sizeof(reg)))
+			return -1;
+		inode->start = le32_to_cpu(reg.start_block);
+		inode->size = le32_to_cpu(reg.file_size);
+		inode->frag = le32_to_cpu(reg.fragment);
+		inode->frag_offset = le32_to_cpu(reg.offset);
+		break;
+	}
+	case SQUASHFS_LREG_TYPE: {
+		struct squashfs_lreg_inode reg;
+
+		if (sqfs_read_metadata(&block, &offset, &reg, sizeof(reg)))
+			return -1;
+		inode->type = SQUASHFS_REG_TYPE;
+		inode->start = le64_to_cpu(reg.start_block);
+		inode->size = le64_to_cpu(reg.file_size);
+		inode->frag = le32_to_cpu(reg.fragment);
+		inode->frag_offset = le32_to_cpu(reg.offset);
+		break;
+	}
+	case SQUASHFS_SYMLINK_TYPE:
+	case SQUASHFS_LSYMLINK_TYPE: {
+		struct squashfs_symlink_inode sym;
+
+		if (sqfs_read_metadata(&block, &offset, &sym, sizeof(sym)))
+			return -1;
+		inode->type = SQUASHFS_SYMLINK_TYPE;
+		inode->size = le32_to_cpu(sym.symlink_size);
+		break;
+	}
+	default:
+		break;
+	}
+
+	inode->mblock = block;
+	inode->moffset = offset;
+	return 0;
+}
+
+/*
+ * Walk the entries of directory 'dir'. With a 'name' return the inode
+ * reference and basic type of the matching entry in 'ref' and 'type',
+ * otherwise list all entries. Return 1 if the name was found, 0 if not
+ * and -1 on errors.
+ */
+static int sqfs_iterate_dir (struct sqfs_inode *dir, const char *name,
+			     u64 *ref, int *type)
+{
+	struct squashfs_dir_header hdr;
+	struct squashfs_dir_entry ent;
+	char entname[SQUASHFS_NAME_LEN + 1];
+	u64 block = le64_to_cpu(sqfs.sb.directory_table_start) + dir->start;
+	int offset = dir->dir_offset;
+	/* The size counts the "." and ".." entries that are not stored */
+	long left = dir->size - 3;
+	int count, len;
+
+	while (left > 0) {
+		if (sqfs_read_metadata(&block, &offset, &hdr, sizeof(hdr)))
+			return -1;
+		left -= sizeof(hdr);
+		count = le32_to_cpu(hdr.count) + 1;
+
+		while (count-- > 0 && left > 0) {
+			u64 entref;
+
+			if (sqfs_read_metadata(&block, &offset, &ent,
+					       sizeof(ent)))
+				return -1;
+			len = le16_to_cpu(ent.size) + 1;
+			if (len > SQUASHFS_NAME_LEN)
+				return -1;
+			if (sqfs_read_metadata(&block, &offset, entname, len))
+				return -1;
+			entname[len] = '\0';
+			left -= sizeof(ent) + len;
+
+			entref = ((u64)le32_to_cpu(hdr.start_block) << 16) |
+				le16_to_cpu(ent.offset);
+
+			if (name != NULL) {
+				if (strcmp(name, entname) == 0) {
+					*ref = entref;
+					*type = le16_to_cpu(ent.type);
+					return 1;
+				}
+				continue;
+			}
+
+			switch (le16_to_cpu(ent.type)) {
+			case SQUASHFS_DIR_TYPE:
+				printf("<DIR> %10d %s\n", 0, entname);
+				break;
+			case SQUASHFS_SYMLINK_TYPE:
+				printf("<SYM> %10d %s\n", 0, entname);
+				break;
+			case SQUASHFS_REG_TYPE: {
+				struct sqfs_inode inode;
+
+				if (sqfs_read_inode(entref, &inode))
+					return -1;
+				printf("      %10llu %s\n", inode.size, entname);
+				break;
+			}
+			default:
+				printf("< ? > %10d %s\n", 0, entname);
+				break;
+			}
+		}
+	}
+	return 0;
+}
+
+/*
+ * Resolve 'path' from the directory on top of 'stack', pushing the
+ * inode references of the components found and following symlinks.
+ * Return 0 on success.
+ */
+static int sqfs_walk (const char *path, u64 *stack, int *depth, int *nest)
+{
+	char fpath[strlen(path) + 1];
+	struct sqfs_inode inode;
+	char *name, *next;
+	u64 ref;
+	int type;
+
+	strcpy(fpath, path);
+
+	for (name = fpath; name != NULL; name = next) {
+		next = strchr(name, '/');
+		if (next != NULL)
+			*next++ = '\0';
+
+		if (*name == '\0' || strcmp(name, ".") == 0)
+			continue;
+		if (strcmp(name, "..") == 0) {
+			if (*depth > 0)
+				(*depth)--;
+			continue;
+		}
+
+		if (sqfs_read_inode(stack[*depth], &inode))
+			return -1;
+		if (inode.type != SQUASHFS_DIR_TYPE)
+			return -1;
+		if (sqfs_iterate_dir(&inode, name, &ref, &type) != 1)
+			return -1;
+
+		if (type == SQUASHFS_SYMLINK_TYPE) {
+			char *target;
+			int ret;
+
+			if (++*nest > SQFS_MAX_SYMLINKS)
+				return -1;
+			if (sqfs_read_inode(ref, &inode))
+				return -1;
+			if (inode.size > SQUASHFS_FILE_MAX_SIZE)
+				return -1;
+			target = malloc(inode.size + 1);
+			if (target == NULL)
+				return -1;
+			if (sqfs_read_metadata(&inode.mblock, &inode.moffset,
+					       target, inode.size)) {
+				free(target);
+				return -1;
+			}
+			target[inode.size] = '\0';
+			debug("squashfs: symlink %s -> %s\n", name, target);
+			/* Absolute links start over from the root */
+			if (target[0] == '/')
+				*depth = 0;
+			ret = sqfs_walk(target, stack, depth, nest);
+			free(target);
+			if (ret)
+				return ret;
+			continue;
+		}
+
+		if (*depth + 1 >= SQFS_MAX_DEPTH)
+			return -1;
+		stack[++*depth] = ref;
+	}
+	return 0;
+}
+
+static int sqfs_lookup (const char *path, struct sqfs_inode *inode)
+{
+	u64 stack[SQFS_MAX_DEPTH];
+	int depth = 0, nest = 0;
+
+	if (!sqfs.valid)
+		return -1;
+
+	stack[0] = le64_to_cpu(sqfs.sb.root_inode);
+	if (sqfs_walk(path, stack, &depth, &nest))
+		return -1;
+	return sqfs_read_inode(stack[depth], inode);
+}
+
+/*
+ * Return the decompressed fragment block 'frag' from the fragment
+ * cache, reading it if needed. NULL on errors.
+ */
+static struct sqfs_cache_entry *sqfs_fragment (u32 frag)
+{
+	struct squashfs_fragment_entry ent;
+	struct sqfs_cache_entry *e;
+	u64 block;
+	int offset;
+	int hit;
+
+	if (frag >= le32_to_cpu(sqfs.sb.fragments))
+		return NULL;
+
+	block = le64_to_cpu(sqfs.frag_index[SQUASHFS_FRAGMENT_INDEX(frag)]);
+	offset = SQUASHFS_FRAGMENT_INDEX_OFFSET(frag);
+	if (sqfs_read_metadata(&block, &offset, &ent, sizeof(ent)))
+		return NULL;
+
+	e = sqfs_cache_get(frag_cache, CONFIG_SQUASHFS_FRAGMENT_CACHE_BLOCKS,
+			   le64_to_cpu(ent.start_block), sqfs.block_size, &hit);
+	if (e == NULL || hit)
+		return e;
+
+	e->len = sqfs_read_block(le64_to_cpu(ent.start_block),
+				 le32_to_cpu(ent.size), e->data,
+				 sqfs.block_size);
+	if (e->len < 0)
+		return NULL;
+	e->used = ++sqfs_cache_clock;
+	return e;
+}
+
+/* Number of block sizes fetched from the block list at a time */
+#define SQFS_BLOCK_LIST_CHUNK	64
+
+/*
+ * Read 'len' bytes from offset 'pos' of the regular file 'inode'. Only
+ * the blocks overlapping that range are read; a block wanted in full
+ * is decompressed straight into 'buf'.
+ */
+static long sqfs_read_file (struct sqfs_inode *inode, char *buf, u64 pos,
+			    u64 len)
+{
+	__le32 sizes[SQFS_BLOCK_LIST_CHUNK];
+	u64 bs = sqfs.block_size;
+	u64 end, disk = inode->start;
+	u32 nblocks, i;
+	long ret;
+
+	if (pos >= inode->size)
+		return 0;
+	if (len == 0 || len > inode->size - pos)
+		len = inode->size - pos;
+	ret = len;
+	end = pos + len;
+
+	if (inode->frag == SQUASHFS_INVALID_FRAG)
+		nblocks = (inode->size + bs - 1) / bs;
+	else
+		nblocks = inode->size / bs;
+
+	for (i = 0; i < nblocks && i * bs < end; i++) {
+		u64 bstart = i * bs;
+		u64 blen = min(bs, inode->size - bstart);
+		u64 s, e;
+		u32 size;
+
+		if (i % SQFS_BLOCK_LIST_CHUNK == 0) {
+			int n = min(nblocks - i, (u32)SQFS_BLOCK_LIST_CHUNK);
+
+			if (sqfs_read_metadata(&inode->mblock, &inode->moffset,
+					       sizes, n * sizeof(__le32)))
+				return -1;
+		}
+		size = le32_to_cpu(sizes[i % SQFS_BLOCK_LIST_CHUNK]);
+
+		if (bstart + blen <= pos)
+			goto next;
+		s = max(pos, bstart);
+		e = min(end, bstart + blen);
+
+		if (size == 0) {
+			/* Sparse block */
+			memset(buf, 0, e - s);
+		} else if (!SQUASHFS_COMPRESSED_BLOCK(size)) {
+			if (sqfs_devread(disk + (s - bstart), e - s, buf))
+				return -1;
+		} else if (s == bstart && e == bstart + blen) {
+			if (sqfs_read_block(disk, size, buf, blen) != blen)
+				return -1;
+		} else {
+			if (sqfs_read_block(disk, size, sqfs.dbuf, bs) != blen)
+				return -1;
+			memcpy(buf, sqfs.dbuf + (s - bstart), e - s);
+		}
+		buf += e - s;
+		WATCHDOG_RESET();
+next:
+		disk += SQUASHFS_COMPRESSED_SIZE_BLOCK(size);
+	}
+
+	/* The tail lives in a fragment block */
+	if (inode->frag != SQUASHFS_INVALID_FRAG && end > (u64)nblocks * bs) {
+		struct sqfs_cache_entry *frag;
+		u64 fstart = (u64)nblocks * bs;
+		u64 s = max(pos, fstart);
+
+		frag = sqfs_fragment(inode->frag);
+		if (frag == NULL ||
+		    inode->frag_offset + (end - fstart) > frag->len) {
+			printf("** squashfs: bad fragment %u **\n", inode->frag);
+			return -1;
+		}
+		memcpy(buf, frag->data + inode->frag_offset + (s - fstart),
+		       end - s);
+	}
+
+	return ret;
+}
+
+static void sqfs_umount (void)
+{
+	sqfs_cache_flush(meta_cache, CONFIG_SQUASHFS_METADATA_CACHE_BLOCKS);
+	sqfs_cache_flush(frag_cache, CONFIG_SQUASHFS_FRAGMENT_CACHE_BLOCKS);
+	free(sqfs.frag_index);
+	free(sqfs.cbuf);
+	free(sqfs.dbuf);
+	memset(&sqfs, 0, sizeof(sqfs));
+}
+
+int sqfs_mount (void)
+{
+	struct squashfs_super_block sb;
+	u32 block_size, nidx;
+	u16 comp;
+
+	if (sqfs_devread(0, sizeof(sb), &sb))
+		return -1;
+	if (le32_to_cpu(sb.s_magic) != SQUASHFS_MAGIC) {
+		debug("squashfs: bad magic\n");
+		return -1;
+	}
+
+	/* Same image as last time? Keep the caches */
+	if (sqfs.valid && sqfs.src.dev == sqfs_src.dev &&
+	    sqfs.src.media_gen == sqfs_src.media_gen &&
+	    sqfs.src.part.start == sqfs_src.part.start &&
+	    sqfs.src.addr == sqfs_src.addr &&
+	    memcmp(&sqfs.sb, &sb, sizeof(sb)) == 0)
+		return 0;
+
+	sqfs_umount();
+
+	block_size = le32_to_cpu(sb.block_size);
+	comp = le16_to_cpu(sb.compression);
+	if (le16_to_cpu(sb.s_major) != SQUASHFS_MAJOR ||
+	    block_size < SQUASHFS_FILE_MIN_SIZE ||
+	    block_size > SQUASHFS_FILE_MAX_SIZE ||
+	    block_size != (1 << le16_to_cpu(sb.block_log))) {
+		printf("** squashfs: unsupported version %d.%d **\n",
+			le16_to_cpu(sb.s_major), le16_to_cpu(sb.s_minor));
+		return -1;
+	}
+	if (comp != ZLIB_COMPRESSION
+#ifdef CONFIG_LZMA
+	    && comp != LZMA_COMPRESSION
+#endif
+	    ) {
+		printf("** squashfs: unsupported compression %d **\n", comp);
+		return -1;
+	}
+
+	memcpy(&sqfs.sb, &sb, sizeof(sb));
+	memcpy(&sqfs.src, &sqfs_src, sizeof(sqfs_src));
+	sqfs.block_size = block_size;
+
+	/* Compressed metadata blocks may be larger than small data blocks */
+	sqfs.cbuf = malloc(max(block_size, (u32)SQUASHFS_METADATA_SIZE));
+	sqfs.dbuf = malloc(block_size);
+	nidx = SQUASHFS_FRAGMENT_INDEXES(le32_to_cpu(sb.fragments));
+	sqfs.frag_index = malloc((nidx + 1) * sizeof(u64));
+	if (sqfs.cbuf == NULL || sqfs.dbuf == NULL ||
+	    sqfs.frag_index == NULL) {
+		printf("** squashfs: malloc failed **\n");
+		goto fail;
+	}
+	if (nidx != 0 &&
+	    sqfs_devread(le64_to_cpu(sb.fragment_table_start),
+			 nidx * sizeof(u64), sqfs.frag_index))
+		goto fail;
+
+	debug("squashfs: %d inodes, block size %d, compression %d\n",
+	      le32_to_cpu(sb.inodes), block_size, comp);
+	sqfs.valid = 1;
+	return 0;
+
+fail:
+	sqfs_umount();
+	return -1;
+}
+
+int sqfs_ls (const char *dirname)
+{
+	struct sqfs_inode inode;
+
+	if (sqfs_lookup(dirname, &inode) ||
+	    inode.type != SQUASHFS_DIR_TYPE) {
+		printf("** Can not find directory %s **\n", dirname);
+		return -1;
+	}
+	return sqfs_iterate_dir(&inode, NULL, NULL, NULL) < 0 ? -1 : 0;
+}
+
+long sqfs_size (const char *filename)
+{
+	struct sqfs_inode inode;
+
+	if (sqfs_lookup(filename, &inode) || inode.type != SQUASHFS_REG_TYPE)
+		return -1;
+	return inode.size;
+}
+
+long sqfs_read (const char *filename, void *buf, ulong pos, ulong len)
+{
+	struct sqfs_inode inode;
+
+	if (sqfs_lookup(filename, &inode) ||
+	    inode.type != SQUASHFS_REG_TYPE) {
+		printf("** File not found %s **\n", filename);
+		return -1;
+	}
+	return sqfs_read_file(&inode, buf, pos, len);
+}
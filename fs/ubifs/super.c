@@ -393,6 +393,11 @@ static int init_constants_early(struct ubifs_info *c)
 	 */
 	c->leb_overhead = c->leb_size % UBIFS_MAX_DATA_NODE_SZ;
 
+	/* Buffer size for bulk-reads */
+	c->max_bu_buf_len = UBIFS_MAX_BULK_READ * UBIFS_MAX_DATA_NODE_SZ;
+	if (c->max_bu_buf_len > c->leb_size)
+		c->max_bu_buf_len = c->leb_size;
+
 	return 0;
 }
 
@@ -629,6 +634,17 @@ static int mount_ubifs(struct ubifs_info *c)
 	if (!c->sbuf)
 		goto out_free;
 
+	if (ubifs_decomp_init(c))
+		goto out_free;
+
+	/* Loading files is much faster with bulk-reads, use them if we can */
+	c->bu.buf = kmalloc(c->max_bu_buf_len, GFP_KERNEL);
+	if (c->bu.buf)
+		c->bulk_read = 1;
+	else
+		ubifs_warn("cannot allocate %d bytes of memory for bulk-read, "
+			   "disabling it", c->max_bu_buf_len);
+
 	/*
 	 * We have to check all CRCs, even for data nodes, when we mount the FS
 	 * (specifically, when we are replaying).
@@ -810,6 +826,8 @@ out_master:
 out_free:
 	vfree(c->ileb_buf);
 	vfree(c->sbuf);
+	kfree(c->bu.buf);
+	ubifs_decomp_exit(c);
 	kfree(c->bottom_up_buf);
 	ubifs_debugging_exit(c);
 	return err;
@@ -844,6 +862,8 @@ static void ubifs_umount(struct ubifs_info *c)
 	kfree(c->mst_node);
 	vfree(c->ileb_buf);
 	vfree(c->sbuf);
+	kfree(c->bu.buf);
+	ubifs_decomp_exit(c);
 	kfree(c->bottom_up_buf);
 	ubifs_debugging_exit(c);
 
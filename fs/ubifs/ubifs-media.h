@@ -325,15 +325,24 @@ enum {
  * UBIFS_COMPR_NONE: no compression
  * UBIFS_COMPR_LZO: LZO compression
  * UBIFS_COMPR_ZLIB: ZLIB compression
+ * UBIFS_COMPR_ZSTD: ZSTD compression (not supported by U-Boot)
  * UBIFS_COMPR_TYPES_CNT: count of supported compression types
  */
 enum {
 	UBIFS_COMPR_NONE,
 	UBIFS_COMPR_LZO,
 	UBIFS_COMPR_ZLIB,
+	UBIFS_COMPR_ZSTD,
 	UBIFS_COMPR_TYPES_CNT,
 };
 
+/*
+ * LZMA compressed data nodes (U-Boot only, see CONFIG_UBIFS_LZMA). This is
+ * not a mainline UBIFS compressor, so the type is kept well above the range
+ * mainline uses. The data starts with the 5 LZMA properties bytes.
+ */
+#define UBIFS_COMPR_LZMA	0x100
+
 /*
  * UBIFS node types.
  *
@@ -24,23 +24,140 @@
  */
 
 #include "ubifs.h"
+#include <div64.h>
+#include <watchdog.h>
 #include <u-boot/zlib.h>
+#ifdef CONFIG_UBIFS_LZMA
+#ifndef CONFIG_LZMA
+#error CONFIG_UBIFS_LZMA needs CONFIG_LZMA
+#endif
+#include <lzma/LzmaTypes.h>
+#include <lzma/LzmaDec.h>
+#endif
 
 DECLARE_GLOBAL_DATA_PTR;
 
 /* compress.c */
 
+/**
+ * struct ubifs_decomp_stats - decompression statistics of one compressor.
+ * @nodes: number of nodes decompressed
+ * @in_bytes: compressed bytes decompressed
+ * @out_bytes: bytes produced
+ * @ticks: time spent decompressing, in 'get_ticks()' units
+ */
+struct ubifs_decomp_stats {
+	unsigned long nodes;
+	unsigned long long in_bytes;
+	unsigned long long out_bytes;
+	unsigned long long ticks;
+};
+
+/**
+ * struct ubifs_decomp - decompression state of a mount.
+ * @dn: buffer for one data node, used by 'do_readpage()'
+ * @zstrm: zlib stream, only reset between nodes
+ * @lzma: LZMA decoder, the probability tables are kept between nodes
+ * @lzma_alloc: allocator of @lzma
+ * @stats: decompression statistics, per compressor slot
+ * @bad_type: number of data nodes with an unknown or unsupported compressor
+ *
+ * This is allocated at mount time, so that decompressing a node does not
+ * have to allocate and free memory. Only the LZMA probability tables are
+ * allocated by the first LZMA node, as their size depends on its properties.
+ */
+struct ubifs_decomp {
+	struct ubifs_data_node *dn;
+	z_stream zstrm;
+#ifdef CONFIG_UBIFS_LZMA
+	CLzmaDec lzma;
+	ISzAlloc lzma_alloc;
+#endif
+	struct ubifs_decomp_stats stats[UBIFS_COMPR_SLOTS];
+	unsigned long bad_type;
+};
+
+static int lzo_decompress(struct ubifs_info *c, const unsigned char *in,
+			  size_t in_len, unsigned char *out, size_t *out_len)
+{
+	return lzo1x_decompress_safe(in, in_len, out, out_len);
+}
+
 /*
- * We need a wrapper for zunzip() because the parameters are
- * incompatible with the lzo decompressor.
+ * Raw deflate data is inflated with the stream set up at mount time, which
+ * keeps its state and window allocated. Like 'zunzip()' with @stoponerr == 0,
+ * a stream that ends early is left to the length check of the caller.
  */
-static int gzip_decompress(const unsigned char *in, size_t in_len,
-			   unsigned char *out, size_t *out_len)
+static int gzip_decompress(struct ubifs_info *c, const unsigned char *in,
+			   size_t in_len, unsigned char *out, size_t *out_len)
+{
+	z_stream *s = &c->decomp->zstrm;
+	int r;
+
+	r = inflateReset(s);
+	if (r != Z_OK)
+		return r;
+
+	s->next_in = (unsigned char *)in;
+	s->avail_in = in_len;
+	s->next_out = out;
+	s->avail_out = *out_len;
+	r = inflate(s, Z_FINISH);
+	if (r != Z_STREAM_END && r != Z_OK && r != Z_BUF_ERROR)
+		return r;
+
+	*out_len = s->next_out - out;
+	return 0;
+}
+
+#ifdef CONFIG_UBIFS_LZMA
+static void *lzma_alloc(void *p, size_t size)
 {
-	unsigned long len = in_len;
-	return zunzip(out, *out_len, (unsigned char *)in, &len, 0, 0);
+	return malloc(size);
 }
 
+static void lzma_free(void *p, void *address)
+{
+	free(address);
+}
+
+/*
+ * LZMA data starts with the 5 properties bytes, followed by the raw stream.
+ * The output buffer is used as the dictionary, so only the probability
+ * tables are allocated, and only when the properties change.
+ */
+static int lzma_decompress(struct ubifs_info *c, const unsigned char *in,
+			   size_t in_len, unsigned char *out, size_t *out_len)
+{
+	struct ubifs_decomp *d = c->decomp;
+	CLzmaDec *p = &d->lzma;
+	ELzmaStatus status;
+	SizeT len;
+	SRes res;
+
+	if (in_len < LZMA_PROPS_SIZE)
+		return SZ_ERROR_INPUT_EOF;
+
+	res = LzmaDec_AllocateProbs(p, in, LZMA_PROPS_SIZE, &d->lzma_alloc);
+	if (res != SZ_OK)
+		return res;
+
+	p->dic = out;
+	p->dicBufSize = *out_len;
+	LzmaDec_Init(p);
+
+	len = in_len - LZMA_PROPS_SIZE;
+	res = LzmaDec_DecodeToDic(p, *out_len, in + LZMA_PROPS_SIZE, &len,
+				  LZMA_FINISH_ANY, &status);
+	if (res == SZ_OK && status == LZMA_STATUS_NEEDS_MORE_INPUT)
+		res = SZ_ERROR_INPUT_EOF;
+	*out_len = p->dicPos;
+	p->dic = NULL;
+
+	return res;
+}
+#endif
+
 /* Fake description object for the "none" compressor */
 static struct ubifs_compressor none_compr = {
 	.compr_type = UBIFS_COMPR_NONE,
@@ -53,7 +170,7 @@ static struct ubifs_compressor lzo_compr = {
 	.compr_type = UBIFS_COMPR_LZO,
 	.name = "LZO",
 	.capi_name = "lzo",
-	.decompress = lzo1x_decompress_safe,
+	.decompress = lzo_decompress,
 };
 
 static struct ubifs_compressor zlib_compr = {
@@ -63,11 +180,44 @@ static struct ubifs_compressor zlib_compr = {
 	.decompress = gzip_decompress,
 };
 
+/* Fake description object for zstd, which is not supported */
+static struct ubifs_compressor zstd_compr = {
+	.compr_type = UBIFS_COMPR_ZSTD,
+	.name = "zstd",
+};
+
+#ifdef CONFIG_UBIFS_LZMA
+static struct ubifs_compressor lzma_compr = {
+	.compr_type = UBIFS_COMPR_LZMA,
+	.name = "LZMA",
+	.capi_name = "lzma",
+	.decompress = lzma_decompress,
+};
+#endif
+
 /* All UBIFS compressors */
-struct ubifs_compressor *ubifs_compressors[UBIFS_COMPR_TYPES_CNT];
+struct ubifs_compressor *ubifs_compressors[UBIFS_COMPR_SLOTS];
+
+/**
+ * compr_slot - find the slot of a compressor type in 'ubifs_compressors[]'.
+ * @compr_type: compressor type, as found on the media
+ *
+ * Returns the slot, or %-1 if @compr_type is not a known compressor type.
+ */
+static int compr_slot(int compr_type)
+{
+#ifdef CONFIG_UBIFS_LZMA
+	if (compr_type == UBIFS_COMPR_LZMA)
+		return UBIFS_COMPR_LZMA_SLOT;
+#endif
+	if (compr_type < 0 || compr_type >= UBIFS_COMPR_TYPES_CNT)
+		return -1;
+	return compr_type;
+}
 
 /**
  * ubifs_decompress - decompress data.
+ * @c: UBIFS file-system description object
  * @in_buf: data to decompress
  * @in_len: length of the data to decompress
  * @out_buf: output buffer where decompressed data should
@@ -78,36 +228,114 @@ struct ubifs_compressor *ubifs_compressors[UBIFS_COMPR_TYPES_CNT];
  * The length of the uncompressed data is returned in @out_len. This functions
  * returns %0 on success or a negative error code on failure.
  */
-int ubifs_decompress(const void *in_buf, int in_len, void *out_buf,
-		     int *out_len, int compr_type)
+int ubifs_decompress(struct ubifs_info *c, const void *in_buf, int in_len,
+		     void *out_buf, int *out_len, int compr_type)
 {
 	int err;
 	struct ubifs_compressor *compr;
-
-	if (unlikely(compr_type < 0 || compr_type >= UBIFS_COMPR_TYPES_CNT)) {
-		ubifs_err("invalid compression type %d", compr_type);
+	struct ubifs_decomp_stats *stats;
+	unsigned long long start;
+	int slot = compr_slot(compr_type);
+
+	if (unlikely(slot < 0)) {
+		ubifs_err("unknown compression type %#x in data node",
+			  compr_type);
+		c->decomp->bad_type += 1;
 		return -EINVAL;
 	}
 
-	compr = ubifs_compressors[compr_type];
+	compr = ubifs_compressors[slot];
 
 	if (unlikely(!compr->capi_name)) {
 		ubifs_err("%s compression is not compiled in", compr->name);
+		c->decomp->bad_type += 1;
 		return -EINVAL;
 	}
 
+	stats = &c->decomp->stats[slot];
+	start = get_ticks();
+
 	if (compr_type == UBIFS_COMPR_NONE) {
 		memcpy(out_buf, in_buf, in_len);
 		*out_len = in_len;
-		return 0;
+		err = 0;
+	} else {
+		err = compr->decompress(c, in_buf, in_len, out_buf,
+					(size_t *)out_len);
 	}
 
-	err = compr->decompress(in_buf, in_len, out_buf, (size_t *)out_len);
-	if (err)
+	/* 32 bit tick counters wrap, so only keep the low 32 bits */
+	stats->ticks += (unsigned long)(get_ticks() - start);
+	if (err) {
 		ubifs_err("cannot decompress %d bytes, compressor %s, "
 			  "error %d", in_len, compr->name, err);
+		return err;
+	}
 
-	return err;
+	stats->nodes += 1;
+	stats->in_bytes += in_len;
+	stats->out_bytes += *out_len;
+	return 0;
+}
+
+/**
+ * ubifs_decomp_init - allocate the decompression state of a mount.
+ * @c: UBIFS file-system description object
+ *
+ * This function returns zero in case of success and %-ENOMEM if there is not
+ * enough memory.
+ */
+int ubifs_decomp_init(struct ubifs_info *c)
+{
+	struct ubifs_decomp *d;
+
+	d = kzalloc(sizeof(struct ubifs_decomp), GFP_KERNEL);
+	if (!d)
+		return -ENOMEM;
+	c->decomp = d;
+
+	d->dn = kmalloc(UBIFS_MAX_DATA_NODE_SZ, GFP_NOFS);
+	if (!d->dn)
+		goto out_free;
+
+#if defined(CONFIG_HW_WATCHDOG) || defined(CONFIG_WATCHDOG)
+	d->zstrm.outcb = (cb_func)WATCHDOG_RESET;
+#endif
+	if (inflateInit2(&d->zstrm, -MAX_WBITS) != Z_OK)
+		goto out_free;
+
+#ifdef CONFIG_UBIFS_LZMA
+	LzmaDec_Construct(&d->lzma);
+	d->lzma_alloc.Alloc = lzma_alloc;
+	d->lzma_alloc.Free = lzma_free;
+#endif
+	return 0;
+
+out_free:
+	kfree(d->dn);
+	kfree(d);
+	c->decomp = NULL;
+	return -ENOMEM;
+}
+
+/**
+ * ubifs_decomp_exit - free the decompression state of a mount.
+ * @c: UBIFS file-system description object
+ */
+void ubifs_decomp_exit(struct ubifs_info *c)
+{
+	struct ubifs_decomp *d = c->decomp;
+
+	if (!d)
+		return;
+
+	inflateEnd(&d->zstrm);
+#ifdef CONFIG_UBIFS_LZMA
+	LzmaDec_FreeProbs(&d->lzma, &d->lzma_alloc);
+#endif
+	kfree(d->dn);
+	kfree(d);
+	c->decomp = NULL;
 }
 
 /**
@@ -119,12 +347,15 @@ int ubifs_decompress(const void *in_buf, int in_len, void *out_buf,
  */
 static int __init compr_init(struct ubifs_compressor *compr)
 {
-	ubifs_compressors[compr->compr_type] = compr;
+	ubifs_compressors[compr_slot(compr->compr_type)] = compr;
 
 #ifndef CONFIG_RELOC_FIXUP_WORKS
-	ubifs_compressors[compr->compr_type]->name += gd->reloc_off;
-	ubifs_compressors[compr->compr_type]->capi_name += gd->reloc_off;
-	ubifs_compressors[compr->compr_type]->decompress += gd->reloc_off;
+	compr->name += gd->reloc_off;
+	/* A NULL @capi_name marks a compressor which is not compiled in */
+	if (compr->capi_name)
+		compr->capi_name += gd->reloc_off;
+	if (compr->decompress)
+		compr->decompress += gd->reloc_off;
 #endif
 
 	return 0;
@@ -148,6 +379,16 @@ int __init ubifs_compressors_init(void)
 	if (err)
 		return err;
 
+	err = compr_init(&zstd_compr);
+	if (err)
+		return err;
+
+#ifdef CONFIG_UBIFS_LZMA
+	err = compr_init(&lzma_compr);
+	if (err)
+		return err;
+#endif
+
 	err = compr_init(&none_compr);
 	if (err)
 		return err;
@@ -520,23 +761,17 @@ static inline void *kmap(struct page *page)
 	return page->addr;
 }
 
-static int read_block(struct inode *inode, void *addr, unsigned int block,
-		      struct ubifs_data_node *dn)
+/*
+ * Decompress data node @dn of block @block into @addr. The remainder of the
+ * block, and the data beyond the end of the file, are zeroed out.
+ */
+static int read_data_node(struct ubifs_info *c, struct inode *inode,
+			  void *addr, unsigned int block,
+			  struct ubifs_data_node *dn)
 {
-	struct ubifs_info *c = inode->i_sb->s_fs_info;
-	int err, len, out_len;
-	union ubifs_key key;
+	int err, len, out_len, ilen;
 	unsigned int dlen;
 
-	data_key_init(c, &key, inode->i_ino, block);
-	err = ubifs_tnc_lookup(c, &key, dn);
-	if (err) {
-		if (err == -ENOENT)
-			/* Not found, so it must be a hole */
-			memset(addr, 0, UBIFS_BLOCK_SIZE);
-		return err;
-	}
-
 	ubifs_assert(le64_to_cpu(dn->ch.sqnum) > ubifs_inode(inode)->creat_sqnum);
 
 	len = le32_to_cpu(dn->size);
@@ -545,7 +780,7 @@ static int read_block(struct inode *inode, void *addr, unsigned int block,
 
 	dlen = le32_to_cpu(dn->ch.len) - UBIFS_DATA_NODE_SZ;
 	out_len = UBIFS_BLOCK_SIZE;
-	err = ubifs_decompress(&dn->data, dlen, addr, &out_len,
+	err = ubifs_decompress(c, &dn->data, dlen, addr, &out_len,
 			       le16_to_cpu(dn->compr_type));
 	if (err || len != out_len)
 		goto dump;
@@ -558,6 +793,12 @@ static int read_block(struct inode *inode, void *addr, unsigned int block,
 	if (len < UBIFS_BLOCK_SIZE)
 		memset(addr + len, 0, UBIFS_BLOCK_SIZE - len);
 
+	/* The last block may have data beyond the end of the file */
+	ilen = inode->i_size & (UBIFS_BLOCK_SIZE - 1);
+	if (block + 1 == (inode->i_size + UBIFS_BLOCK_SIZE - 1) >>
+			 UBIFS_BLOCK_SHIFT && ilen && ilen < len)
+		memset(addr + ilen, 0, len - ilen);
+
 	return 0;
 
 dump:
@@ -567,6 +808,25 @@ dump:
 	return -EINVAL;
 }
 
+static int read_block(struct inode *inode, void *addr, unsigned int block,
+		      struct ubifs_data_node *dn)
+{
+	struct ubifs_info *c = inode->i_sb->s_fs_info;
+	int err;
+	union ubifs_key key;
+
+	data_key_init(c, &key, inode->i_ino, block);
+	err = ubifs_tnc_lookup(c, &key, dn);
+	if (err) {
+		if (err == -ENOENT)
+			/* Not found, so it must be a hole */
+			memset(addr, 0, UBIFS_BLOCK_SIZE);
+		return err;
+	}
+
+	return read_data_node(c, inode, addr, block, dn);
+}
+
 static int do_readpage(struct ubifs_info *c, struct inode *inode, struct page *page)
 {
 	void *addr;
@@ -588,10 +848,7 @@ static int do_readpage(struct ubifs_info *c, struct inode *inode, struct page *p
 		goto out;
 	}
 
-	dn = kmalloc(UBIFS_MAX_DATA_NODE_SZ, GFP_NOFS);
-	if (!dn)
-		return -ENOMEM;
-
+	dn = c->decomp->dn;
 	i = 0;
 	while (1) {
 		int ret;
@@ -606,12 +863,6 @@ static int do_readpage(struct ubifs_info *c, struct inode *inode, struct page *p
 				err = ret;
 				if (err != -ENOENT)
 					break;
-			} else if (block + 1 == beyond) {
-				int dlen = le32_to_cpu(dn->size);
-				int ilen = i_size & (UBIFS_BLOCK_SIZE - 1);
-
-				if (ilen && ilen < dlen)
-					memset(addr + ilen, 0, dlen - ilen);
 			}
 		}
 		if (++i >= UBIFS_BLOCKS_PER_PAGE)
@@ -623,21 +874,90 @@ static int do_readpage(struct ubifs_info *c, struct inode *inode, struct page *p
 		if (err == -ENOENT) {
 			/* Not found, so it must be a hole */
 			dbg_gen("hole");
-			goto out_free;
+			goto out;
 		}
 		ubifs_err("cannot read page %lu of inode %lu, error %d",
 			  page->index, inode->i_ino, err);
-		goto error;
+		return err;
 	}
 
-out_free:
-	kfree(dn);
 out:
 	return 0;
+}
 
-error:
-	kfree(dn);
-	return err;
+/**
+ * do_bulk_read - read pages of a file with bulk-reads.
+ * @c: UBIFS file-system description object
+ * @inode: inode to read from
+ * @page: first page to read, advanced past the pages read
+ * @count: number of pages of the file to read
+ *
+ * Data nodes of the file which follow each other in the same LEB are looked
+ * up in the TNC together, read with one I/O into the bulk-read buffer and
+ * decompressed from there. If something goes wrong, the pages from @page on
+ * are left to 'do_readpage()', which reports the error.
+ */
+static void do_bulk_read(struct ubifs_info *c, struct inode *inode,
+			 struct page *page, unsigned int count)
+{
+	struct bu_info *bu = &c->bu;
+	unsigned int first, block, next, end;
+	void *addr = page->addr, *buf;
+	int i, err = 0;
+
+	first = block = page->index << UBIFS_BLOCKS_PER_PAGE_SHIFT;
+	end = count << UBIFS_BLOCKS_PER_PAGE_SHIFT;
+	next = (inode->i_size + UBIFS_BLOCK_SIZE - 1) >> UBIFS_BLOCK_SHIFT;
+	if (end > next)
+		end = next;
+
+	bu->buf_len = c->max_bu_buf_len;
+	while (block < end) {
+		data_key_init(c, &bu->key, inode->i_ino, block);
+		err = ubifs_tnc_get_bu_keys(c, bu);
+		if (err)
+			break;
+		if (!bu->cnt && !bu->eof)
+			break;
+		if (bu->cnt) {
+			err = ubifs_tnc_bulk_read(c, bu);
+			if (err)
+				break;
+		}
+
+		buf = bu->buf;
+		for (i = 0; i < bu->cnt; i++) {
+			next = key_block(c, &bu->zbranch[i].key);
+			if (next >= end)
+				break;
+
+			/* Not found, so it must be a hole */
+			memset(addr, 0, (next - block) << UBIFS_BLOCK_SHIFT);
+			addr += (next - block) << UBIFS_BLOCK_SHIFT;
+			err = read_data_node(c, inode, addr, next, buf);
+			if (err)
+				goto out;
+
+			block = next + 1;
+			addr += UBIFS_BLOCK_SIZE;
+			buf += ALIGN(bu->zbranch[i].len, 8);
+		}
+
+		if (i < bu->cnt || bu->eof) {
+			/* No more data nodes before @end */
+			memset(addr, 0, (end - block) << UBIFS_BLOCK_SHIFT);
+			addr += (end - block) << UBIFS_BLOCK_SHIFT;
+			block = end;
+		}
+	}
+
+out:
+	if (err)
+		ubifs_warn("ignoring error %d and skipping bulk-read", err);
+
+	block &= ~(UBIFS_BLOCKS_PER_PAGE - 1);
+	page->addr += (block - first) << UBIFS_BLOCK_SHIFT;
+	page->index = block >> UBIFS_BLOCKS_PER_PAGE_SHIFT;
 }
 
 int ubifs_load(char *filename, u32 addr, u32 size)
@@ -683,7 +1003,9 @@ int ubifs_load(char *filename, u32 addr, u32 size)
 	page.addr = (void *)addr;
 	page.index = 0;
 	page.inode = inode;
-	for (i = 0; i < count; i++) {
+	if (c->bulk_read)
+		do_bulk_read(c, inode, &page, count);
+	for (i = page.index; i < count; i++) {
 		err = do_readpage(c, inode, &page);
 		if (err)
 			break;
@@ -703,3 +1025,43 @@ out:
 	ubi_close_volume(c->ubi);
 	return err;
 }
+
+/**
+ * ubifs_print_info - print information about the mounted file-system.
+ *
+ * Prints the default compressor and, for each compressor, how many data
+ * nodes have been decompressed since the file-system was mounted and how
+ * long that took, then how many data nodes were rejected because their
+ * compressor is unknown or not compiled in.
+ */
+void ubifs_print_info(void)
+{
+	struct ubifs_info *c = ubifs_sb->s_fs_info;
+	struct ubifs_decomp_stats *stats;
+	unsigned long long us, avg;
+	ulong tbclk = get_tbclk() / 1000;
+	int i;
+
+	printf("default compressor: %s\n", ubifs_compr_name(c->default_compr));
+	printf("bulk-read:          %s\n", c->bulk_read ? "on" : "off");
+	printf("\ncompressor          nodes    compressed  uncompressed"
+	       "   time (us)  us/node\n");
+	for (i = 0; i < UBIFS_COMPR_SLOTS; i++) {
+		/* Only list the compressors which are compiled in */
+		if (!ubifs_compressors[i]->capi_name)
+			continue;
+
+		stats = &c->decomp->stats[i];
+		us = stats->ticks * 1000;
+		do_div(us, tbclk);
+		avg = us;
+		if (stats->nodes)
+			do_div(avg, stats->nodes);
+		printf("%-16s %8lu  %12llu  %12llu  %10llu  %7llu\n",
+		       ubifs_compressors[i]->name, stats->nodes, stats->in_bytes,
+		       stats->out_bytes, us, avg);
+	}
+	if (c->decomp->bad_type)
+		printf("\n%lu data nodes with an unknown or unsupported "
+		       "compressor\n", c->decomp->bad_type);
+}
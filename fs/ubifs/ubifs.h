@@ -1221,6 +1221,17 @@ struct ubifs_node_range {
 	int max_len;
 };
 
+/*
+ * Compressors are kept in 'ubifs_compressors[]' by their type, the U-Boot
+ * only LZMA compressor goes into the slot after the mainline ones.
+ */
+#ifdef CONFIG_UBIFS_LZMA
+#define UBIFS_COMPR_LZMA_SLOT	UBIFS_COMPR_TYPES_CNT
+#define UBIFS_COMPR_SLOTS	(UBIFS_COMPR_TYPES_CNT + 1)
+#else
+#define UBIFS_COMPR_SLOTS	UBIFS_COMPR_TYPES_CNT
+#endif
+
 /**
  * struct ubifs_compressor - UBIFS compressor description structure.
  * @compr_type: compressor type (%UBIFS_COMPR_LZO, etc)
@@ -1229,13 +1240,15 @@ struct ubifs_node_range {
  * @decomp_mutex: mutex used during decompression
  * @name: compressor name
  * @capi_name: cryptoapi compressor name
+ * @decompress: decompression function, may use the decompression state of
+ *              the mount
  */
 struct ubifs_compressor {
 	int compr_type;
 	char *name;
 	char *capi_name;
-	int (*decompress)(const unsigned char *in, size_t in_len,
-			  unsigned char *out, size_t *out_len);
+	int (*decompress)(struct ubifs_info *c, const unsigned char *in,
+			  size_t in_len, unsigned char *out, size_t *out_len);
 };
 
 /**
@@ -1413,6 +1426,8 @@ struct ubifs_debug_info;
  * @max_bu_buf_len: maximum bulk-read buffer length
  * @bu_mutex: protects the pre-allocated bulk-read buffer and @c->bu
  * @bu: pre-allocated bulk-read information
+ * @decomp: decompression buffers, compressor state and statistics allocated
+ *          for the whole mount
  *
  * @log_lebs: number of logical eraseblocks in the log
  * @log_bytes: log size in bytes
@@ -1652,6 +1667,7 @@ struct ubifs_info {
 	int max_bu_buf_len;
 	struct mutex bu_mutex;
 	struct bu_info bu;
+	struct ubifs_decomp *decomp;
 
 	int log_lebs;
 	long long log_bytes;
@@ -1828,7 +1844,7 @@ extern const struct file_operations ubifs_dir_operations;
 extern const struct inode_operations ubifs_dir_inode_operations;
 extern const struct inode_operations ubifs_symlink_inode_operations;
 extern struct backing_dev_info ubifs_backing_dev_info;
-extern struct ubifs_compressor *ubifs_compressors[UBIFS_COMPR_TYPES_CNT];
+extern struct ubifs_compressor *ubifs_compressors[UBIFS_COMPR_SLOTS];
 
 /* io.c */
 void ubifs_ro_mode(struct ubifs_info *c, int err);
@@ -2130,8 +2146,10 @@ int __init ubifs_compressors_init(void);
 void __exit ubifs_compressors_exit(void);
 void ubifs_compress(const void *in_buf, int in_len, void *out_buf, int *out_len,
 		    int *compr_type);
-int ubifs_decompress(const void *buf, int len, void *out, int *out_len,
-		     int compr_type);
+int ubifs_decompress(struct ubifs_info *c, const void *buf, int len, void *out,
+		     int *out_len, int compr_type);
+int ubifs_decomp_init(struct ubifs_info *c);
+void ubifs_decomp_exit(struct ubifs_info *c);
 
 #include "debug.h"
 #include "misc.h"
@@ -219,6 +219,7 @@ void	hang		(void) __attribute__ ((noreturn));
 phys_size_t initdram (int);
 int	display_options (void);
 void	print_size(unsigned long long, const char *);
+void	print_rate(unsigned long long, ulong, const char *);
 int	print_buffer (ulong addr, void* data, uint width, uint count, uint linelen);
 
 /* common/main.c */
@@ -620,6 +621,7 @@ ulong	ticks2usec    (unsigned long ticks);
 int	init_timebase (void);
 
 /* lib/gunzip.c */
+int gzip_header_len(const unsigned char *src, unsigned long len);
 int gunzip(void *, int, unsigned char *, unsigned long *);
 int zunzip(void *dst, int dstlen, unsigned char *src, unsigned long *lenp,
 						int stoponerr, int offset);
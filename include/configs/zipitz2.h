@@ -36,7 +36,7 @@
 #define CONFIG_ENV_ADDR			0x40000
 #define CONFIG_ENV_SIZE			0x20000
 
-#define	CONFIG_SYS_MALLOC_LEN		(256*1024)
+#define	CONFIG_SYS_MALLOC_LEN		(1024*1024)
 #define	CONFIG_SYS_GBL_DATA_SIZE	256
 
 #define	CONFIG_BOOTCOMMAND						\
@@ -84,10 +84,17 @@
 #define	CONFIG_MMC
 #define	CONFIG_GENERIC_MMC
 #define	CONFIG_PXA_MMC_GENERIC
+#define	CONFIG_PXA_DMA
 #define	CONFIG_SYS_MMC_BASE		0xF0000000
 #define	CONFIG_CMD_FAT
+#define	CONFIG_FAT_PRELOAD_MAX		(64*1024)
 #define CONFIG_CMD_EXT2
+#define	CONFIG_CMD_FS_GENERIC
+#define	CONFIG_CMD_SQUASHFS
 #define	CONFIG_DOS_PARTITION
+#define	CONFIG_BLOCK_CACHE
+#define	CONFIG_BLOCK_READAHEAD
+#define	CONFIG_CMD_BLOCK_CACHE
 #endif
 
 /*
@@ -73,6 +73,7 @@ struct cramfs_super {
 #define CRAMFS_FLAG_HOLES		0x00000100	/* support for holes */
 #define CRAMFS_FLAG_WRONG_SIGNATURE	0x00000200	/* reserved */
 #define CRAMFS_FLAG_SHIFTED_ROOT_OFFSET 0x00000400	/* shifted root fs */
+#define CRAMFS_FLAG_EXT_BLOCK_POINTERS	0x00000800	/* block pointer extensions */
 
 /*
  * Valid values in super.flags.	 Currently we refuse to mount
@@ -82,7 +83,24 @@ struct cramfs_super {
 #define CRAMFS_SUPPORTED_FLAGS	( 0x000000ff \
 				| CRAMFS_FLAG_HOLES \
 				| CRAMFS_FLAG_WRONG_SIGNATURE \
-				| CRAMFS_FLAG_SHIFTED_ROOT_OFFSET )
+				| CRAMFS_FLAG_SHIFTED_ROOT_OFFSET \
+				| CRAMFS_FLAG_EXT_BLOCK_POINTERS )
+
+/*
+ * Block pointer flags, used with CRAMFS_FLAG_EXT_BLOCK_POINTERS.
+ * An uncompressed block is stored as is. A direct pointer holds the
+ * start of the block (shifted by CRAMFS_BLK_DIRECT_PTR_SHIFT) instead
+ * of its end; a compressed block at a direct pointer starts with its
+ * 16 bit length.
+ */
+#define CRAMFS_BLK_FLAG_UNCOMPRESSED	(1U << 31)
+#define CRAMFS_BLK_FLAG_DIRECT_PTR	(1U << 30)
+#define CRAMFS_BLK_FLAGS	( CRAMFS_BLK_FLAG_UNCOMPRESSED \
+				| CRAMFS_BLK_FLAG_DIRECT_PTR )
+#define CRAMFS_BLK_DIRECT_PTR_SHIFT	2
+
+/* Files are split in blocks of this size */
+#define CRAMFS_BLKSIZE		4096
 
 #define CRAMFS_16(x)	(x)
 #define CRAMFS_24(x)	(x)
@@ -26,7 +26,9 @@
  */
 
 
+#ifndef SECTOR_SIZE	/* fat.h has the same one */
 #define SECTOR_SIZE		0x200
+#endif
 #define SECTOR_BITS		9
 
 /* Error codes */
@@ -74,8 +76,12 @@ typedef enum
 
 
 extern int ext2fs_set_blk_dev(block_dev_desc_t *rbdd, int part);
+extern int ext2fs_mounted_part(block_dev_desc_t *dev, int part,
+			       disk_partition_t *info);
 extern int ext2fs_ls (char *dirname);
 extern int ext2fs_open (char *filename);
 extern int ext2fs_read (char *buf, unsigned len);
+extern int ext2fs_read_at (char *buf, unsigned pos, unsigned len);
+extern int ext2fs_read_runs (void);
 extern int ext2fs_mount (unsigned part_length);
 extern int ext2fs_close(void);
@@ -177,7 +177,7 @@ typedef struct dir_slot {
  * (see FAT32 accesses)
  */
 typedef struct {
-	__u8	fatbuf[FATBUFSIZE]; /* Current FAT buffer */
+	__u8	*fatbuf;	/* Current FAT window, see get_fatent */
 	int	fatsize;	/* Size of FAT in bits */
 	__u16	fatlength;	/* Length of FAT in sectors */
 	__u16	fat_sect;	/* Starting sector of the FAT */
@@ -187,6 +187,12 @@ typedef struct {
 	int	fatbufnum;	/* Used by get_fatent, init to -1 */
 } fsdata;
 
+/* A physically contiguous run of a file's clusters */
+typedef struct {
+	__u32	sect;		/* First sector of the run */
+	__u32	nsect;		/* Length of the run in sectors */
+} fat_extent;
+
 typedef int	(file_detectfs_func)(void);
 typedef int	(file_ls_func)(const char *dir);
 typedef long	(file_read_func)(const char *filename, void *buffer,
@@ -209,6 +215,11 @@ int file_cd(const char *path);
 int file_fat_detectfs(void);
 int file_fat_ls(const char *dir);
 long file_fat_read(const char *filename, void *buffer, unsigned long maxsize);
+long file_fat_read_at(const char *filename, unsigned long pos, void *buffer,
+		      unsigned long maxsize);
+int file_fat_extents(void);
+int file_fat_probe(void);
+long file_fat_size(const char *filename);
 const char *file_getfsname(int idx);
 int fat_register_device(block_dev_desc_t *dev_desc, int part_no);
 
@@ -0,0 +1,62 @@
+/*
+ * Generic filesystem layer for block devices
+ *
+ * See file CREDITS for list of people who contributed to this
+ * project.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston,
+ * MA 02111-1307 USA
+ */
+#ifndef _FS_H_
+#define _FS_H_
+
+#define FS_TYPE_ANY	0
+#define FS_TYPE_FAT	1
+#define FS_TYPE_EXT2	2
+#define FS_TYPE_SQUASHFS	3
+
+/*
+ * Select the partition 'dev_part_str' ("dev[:part]", hex) of the block
+ * device on interface 'ifname' and mount the filesystem on it. With
+ * FS_TYPE_ANY the filesystem type is probed. Return 0 on success.
+ */
+int fs_set_blk_dev(const char *ifname, const char *dev_part_str, int fstype);
+
+/* Name of the filesystem selected by fs_set_blk_dev() */
+const char *fs_type_name(void);
+
+/*
+ * The following act on the filesystem selected by fs_set_blk_dev() and
+ * return -1 on errors.
+ */
+int fs_ls(const char *dirname);
+long fs_size(const char *filename);
+
+/*
+ * Read at most 'len' bytes (all if 0) from offset 'pos' of 'filename'
+ * to 'addr'. Return the number of bytes read.
+ */
+long fs_read(const char *filename, ulong addr, ulong pos, ulong len);
+
+/*
+ * Read 'filename' in pieces of up to CONFIG_FS_STREAM_CHUNK bytes and pass
+ * each to 'fn', which returns 0 to go on, 1 to stop and < 0 on errors.
+ * Return the number of bytes read, or -1 if reading or 'fn' failed.
+ */
+long fs_read_stream(const char *filename,
+		    int (*fn)(void *priv, const void *buf, ulong len),
+		    void *priv);
+
+#endif /* _FS_H_ */
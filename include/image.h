@@ -509,6 +509,30 @@ static inline int image_check_target_arch (const image_header_t *hdr)
 }
 #endif /* USE_HOSTCC */
 
+#ifndef USE_HOSTCC
+/*
+ * Decompressor fed with a compressed image in pieces (common/image_stream.c),
+ * so that the image can be decompressed while it is read from storage and
+ * no copy of the whole compressed image is needed. The first piece has to
+ * hold the header of the compressed data (gzip or LZMA, a few hundred bytes
+ * at most).
+ */
+typedef struct image_stream {
+	uint8_t		comp;		/* IH_COMP_* */
+	int		done;		/* end of compressed data seen */
+	uchar		*dst;		/* output buffer */
+	ulong		dstlen;		/* size of the output buffer */
+	ulong		len;		/* bytes written to dst so far */
+	ulong		in_len;		/* bytes fed so far */
+	void		*priv;		/* decompressor state */
+} image_stream_t;
+
+int image_stream_init (image_stream_t *s, uint8_t comp, void *dst,
+		       ulong dstlen);
+int image_stream_write (image_stream_t *s, const void *buf, ulong len);
+int image_stream_end (image_stream_t *s);
+#endif /* USE_HOSTCC */
+
 /*******************************************************************/
 /* New uImage format specific code (prefixed with fit_) */
 /*******************************************************************/
@@ -49,6 +49,11 @@
 
 #define IS_SD(x) (x->version & SD_VERSION_SD)
 
+/* Largest number of blocks a host moves with one multi-block command */
+#ifndef CONFIG_SYS_MMC_MAX_BLK_COUNT
+#define CONFIG_SYS_MMC_MAX_BLK_COUNT	65535
+#endif
+
 #define MMC_DATA_READ		1
 #define MMC_DATA_WRITE		2
 
@@ -81,6 +86,7 @@
 #define SD_CMD_SEND_IF_COND		8
 
 #define SD_CMD_APP_SET_BUS_WIDTH	6
+#define SD_CMD_APP_SET_WR_BLK_ERASE_COUNT	23
 #define SD_CMD_APP_SEND_OP_COND		41
 #define SD_CMD_APP_SEND_SCR		51
 
@@ -88,6 +94,14 @@
 #define SD_HIGHSPEED_BUSY	0x00020000
 #define SD_HIGHSPEED_SUPPORTED	0x00020000
 
+/* Card status bits returned by SEND_STATUS */
+#define MMC_STATUS_RDY_FOR_DATA	(1 << 8)
+#define MMC_STATUS_CURR_STATE	(0xf << 9)
+#define MMC_STATE_PRG		(7 << 9)
+
+/* Programming timeout of a write batch, in milliseconds */
+#define MMC_WRITE_TIMEOUT	1000
+
 #define MMC_HS_TIMING		0x00000100
 #define MMC_HS_52MHZ		0x2
 
@@ -258,6 +272,7 @@ struct mmc {
 	uint tran_speed;
 	uint read_bl_len;
 	uint write_bl_len;
+	uint b_max;		/* max blocks per multi-block transfer */
 	u64 capacity;
 	block_dev_desc_t block_dev;
 	int (*send_cmd)(struct mmc *mmc,
@@ -50,6 +50,7 @@ typedef struct block_dev_desc {
 				       lbaint_t blkcnt,
 				       const void *buffer);
 	void		*priv;		/* driver private struct pointer */
+	unsigned long	media_gen;	/* bumped on every scan and write */
 }block_dev_desc_t;
 
 /* Interface types: */
@@ -106,6 +107,7 @@ block_dev_desc_t* mg_disk_get_dev(int dev);
 int get_partition_info (block_dev_desc_t * dev_desc, int part, disk_partition_t *info);
 void print_part (block_dev_desc_t *dev_desc);
 void  init_part (block_dev_desc_t *dev_desc);
+void blk_media_changed (block_dev_desc_t *dev_desc);
 void dev_print(block_dev_desc_t *dev_desc);
 
 
@@ -144,4 +146,55 @@ void print_part_efi (block_dev_desc_t *dev_desc);
 int   test_part_efi (block_dev_desc_t *dev_desc);
 #endif
 
+#ifdef CONFIG_BLOCK_CACHE
+/* disk/blk_cache.c */
+struct blk_cache_stats {
+	unsigned int hits;
+	unsigned int misses;
+	unsigned int entries;		/* entries currently cached */
+	unsigned int max_entries;	/* max number of cached extents */
+	unsigned int max_blocks;	/* largest read that gets cached */
+	unsigned int ra_hits;		/* reads served from readahead */
+	unsigned int ra_reads;		/* readahead device reads */
+	unsigned int ra_max;		/* max readahead window in blocks */
+};
+
+ulong blk_dread(block_dev_desc_t *dev_desc, lbaint_t start,
+		lbaint_t blkcnt, void *buffer);
+ulong blk_dwrite(block_dev_desc_t *dev_desc, lbaint_t start,
+		lbaint_t blkcnt, const void *buffer);
+void blk_cache_invalidate(int if_type, int dev);
+void blk_cache_configure(unsigned int blocks, unsigned int entries);
+void blk_cache_get_stats(struct blk_cache_stats *stats);
+void blk_cache_reset_stats(void);
+#ifdef CONFIG_BLOCK_READAHEAD
+void blk_readahead_configure(unsigned int blocks);
+#endif
+#else
+static inline ulong blk_dread(block_dev_desc_t *dev_desc, lbaint_t start,
+				lbaint_t blkcnt, void *buffer)
+{
+	if (!dev_desc->block_read)
+		return 0;
+
+	return dev_desc->block_read(dev_desc->dev, start, blkcnt, buffer);
+}
+
+static inline ulong blk_dwrite(block_dev_desc_t *dev_desc, lbaint_t start,
+				lbaint_t blkcnt, const void *buffer)
+{
+	ulong n;
+
+	if (!dev_desc->block_write)
+		return 0;
+
+	n = dev_desc->block_write(dev_desc->dev, start, blkcnt, buffer);
+	blk_media_changed(dev_desc);
+
+	return n;
+}
+
+static inline void blk_cache_invalidate(int if_type, int dev) {}
+#endif
+
 #endif /* _PART_H */
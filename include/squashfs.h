@@ -0,0 +1,41 @@
+/*
+ * SquashFS read-only filesystem
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston,
+ * MA 02111-1307 USA
+ */
+#ifndef _SQUASHFS_H_
+#define _SQUASHFS_H_
+
+/*
+ * Select the image to use: a partition of a block device (0 for the
+ * whole device), or an image mapped at 'addr' in memory, e.g. on NOR.
+ * Return 0 on success.
+ */
+int sqfs_set_blk_dev(block_dev_desc_t *dev_desc, int part);
+void sqfs_set_mem(ulong addr);
+
+/*
+ * Check the superblock of the selected image. The caches are kept if
+ * it is the image mounted last. Return 0 on success.
+ */
+int sqfs_mount(void);
+
+/* These return -1 on errors */
+int sqfs_ls(const char *dirname);
+long sqfs_size(const char *filename);
+long sqfs_read(const char *filename, void *buf, ulong pos, ulong len);
+
+#endif /* _SQUASHFS_H_ */
@@ -0,0 +1,173 @@
+/*
+ * SquashFS 4.0 on-disk format, after fs/squashfs/squashfs_fs.h of the
+ * Linux kernel:
+ *  Copyright (c) 2002, 2003, 2004, 2005, 2006, 2007, 2008
+ *  Phillip Lougher <phillip@squashfs.org.uk>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston,
+ * MA 02111-1307 USA
+ *
+ * All fields are little endian.
+ */
+#ifndef __SQUASHFS_FS_H
+#define __SQUASHFS_FS_H
+
+#define SQUASHFS_MAGIC			0x73717368
+#define SQUASHFS_MAJOR			4
+
+/* Metadata blocks: a 16 bit header, then up to 8 KiB of data */
+#define SQUASHFS_METADATA_SIZE		8192
+#define SQUASHFS_COMPRESSED_BIT		(1 << 15)
+#define SQUASHFS_COMPRESSED_SIZE(h)	((h) & ~SQUASHFS_COMPRESSED_BIT)
+#define SQUASHFS_COMPRESSED(h)		(!((h) & SQUASHFS_COMPRESSED_BIT))
+
+/* Data and fragment block sizes: bit 24 set if stored uncompressed */
+#define SQUASHFS_COMPRESSED_BIT_BLOCK	(1 << 24)
+#define SQUASHFS_COMPRESSED_SIZE_BLOCK(s) ((s) & ~SQUASHFS_COMPRESSED_BIT_BLOCK)
+#define SQUASHFS_COMPRESSED_BLOCK(s)	(!((s) & SQUASHFS_COMPRESSED_BIT_BLOCK))
+
+#define SQUASHFS_FILE_MIN_SIZE		4096
+#define SQUASHFS_FILE_MAX_SIZE		1048576
+#define SQUASHFS_NAME_LEN		256
+#define SQUASHFS_INVALID_FRAG		0xffffffffU
+
+/* Inode references: metadata block (from the table start) and offset */
+#define SQUASHFS_INODE_BLK(ref)		((unsigned int)((ref) >> 16))
+#define SQUASHFS_INODE_OFFSET(ref)	((unsigned int)((ref) & 0xffff))
+
+#define SQUASHFS_FRAGMENT_INDEX(f)	((f) / (SQUASHFS_METADATA_SIZE / \
+					 sizeof(struct squashfs_fragment_entry)))
+#define SQUASHFS_FRAGMENT_INDEX_OFFSET(f) \
+	(((f) % (SQUASHFS_METADATA_SIZE / \
+		 sizeof(struct squashfs_fragment_entry))) * \
+	 sizeof(struct squashfs_fragment_entry))
+#define SQUASHFS_FRAGMENT_INDEXES(n)	(SQUASHFS_FRAGMENT_INDEX((n) + \
+		(SQUASHFS_METADATA_SIZE / \
+		 sizeof(struct squashfs_fragment_entry)) - 1))
+
+/* Compression types */
+#define ZLIB_COMPRESSION		1
+#define LZMA_COMPRESSION		2
+#define LZO_COMPRESSION			3
+#define XZ_COMPRESSION			4
+
+/* Inode types */
+#define SQUASHFS_DIR_TYPE		1
+#define SQUASHFS_REG_TYPE		2
+#define SQUASHFS_SYMLINK_TYPE		3
+#define SQUASHFS_BLKDEV_TYPE		4
+#define SQUASHFS_CHRDEV_TYPE		5
+#define SQUASHFS_FIFO_TYPE		6
+#define SQUASHFS_SOCKET_TYPE		7
+#define SQUASHFS_LDIR_TYPE		8
+#define SQUASHFS_LREG_TYPE		9
+#define SQUASHFS_LSYMLINK_TYPE		10
+
+struct squashfs_super_block {
+	__le32	s_magic;
+	__le32	inodes;
+	__le32	mkfs_time;
+	__le32	block_size;
+	__le32	fragments;
+	__le16	compression;
+	__le16	block_log;
+	__le16	flags;
+	__le16	no_ids;
+	__le16	s_major;
+	__le16	s_minor;
+	__le64	root_inode;
+	__le64	bytes_used;
+	__le64	id_table_start;
+	__le64	xattr_id_table_start;
+	__le64	inode_table_start;
+	__le64	directory_table_start;
+	__le64	fragment_table_start;
+	__le64	lookup_table_start;
+} __attribute__ ((packed));
+
+struct squashfs_base_inode {
+	__le16	inode_type;
+	__le16	mode;
+	__le16	uid;
+	__le16	guid;
+	__le32	mtime;
+	__le32	inode_number;
+} __attribute__ ((packed));
+
+/* The type specific parts follow the base inode */
+struct squashfs_dir_inode {
+	__le32	start_block;
+	__le32	nlink;
+	__le16	file_size;
+	__le16	offset;
+	__le32	parent_inode;
+} __attribute__ ((packed));
+
+struct squashfs_ldir_inode {
+	__le32	nlink;
+	__le32	file_size;
+	__le32	start_block;
+	__le32	parent_inode;
+	__le16	i_count;
+	__le16	offset;
+	__le32	xattr;
+} __attribute__ ((packed));
+
+/* Followed by the block list, one __le32 per full block */
+struct squashfs_reg_inode {
+	__le32	start_block;
+	__le32	fragment;
+	__le32	offset;
+	__le32	file_size;
+} __attribute__ ((packed));
+
+struct squashfs_lreg_inode {
+	__le64	start_block;
+	__le64	file_size;
+	__le64	sparse;
+	__le32	nlink;
+	__le32	fragment;
+	__le32	offset;
+	__le32	xattr;
+} __attribute__ ((packed));
+
+/* Followed by the target */
+struct squashfs_symlink_inode {
+	__le32	nlink;
+	__le32	symlink_size;
+} __attribute__ ((packed));
+
+/* A run of directory entries whose inodes share a metadata block */
+struct squashfs_dir_header {
+	__le32	count;		/* Entries - 1 */
+	__le32	start_block;
+	__le32	inode_number;
+} __attribute__ ((packed));
+
+/* Followed by size + 1 bytes of name */
+struct squashfs_dir_entry {
+	__le16	offset;
+	__le16	inode_number;	/* Signed delta */
+	__le16	type;
+	__le16	size;
+} __attribute__ ((packed));
+
+struct squashfs_fragment_entry {
+	__le64	start_block;
+	__le32	size;
+	__le32	unused;
+} __attribute__ ((packed));
+
+#endif /* __SQUASHFS_FS_H */
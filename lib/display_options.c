@@ -25,6 +25,7 @@
 #include <common.h>
 #include <linux/ctype.h>
 #include <asm/io.h>
+#include <div64.h>
 
 int display_options (void)
 {
@@ -84,6 +85,19 @@ void print_size(unsigned long long size, const char *s)
 	printf (" %ciB%s", c, s);
 }
 
+/*
+ * print a transfer rate as "xxx KiB/s", "xxx.y MiB/s", etc. for a given
+ * number of bytes moved in a given number of timer ticks (CONFIG_SYS_HZ)
+ */
+void print_rate(unsigned long long bytes, ulong ticks, const char *s)
+{
+	if (!ticks)
+		ticks = 1;
+
+	print_size(lldiv(bytes * CONFIG_SYS_HZ, ticks), "/s");
+	puts(s);
+}
+
 /*
  * Print data buffer in hex and ascii form to the terminal.
  *
@@ -56,28 +56,64 @@ void zfree(void *x, void *addr, unsigned nb)
 	free (addr);
 }
 
-int gunzip(void *dst, int dstlen, unsigned char *src, unsigned long *lenp)
+/*
+ * Return the length of the gzip header at 'src', of which 'len' bytes are
+ * valid: -1 if it is not a (supported) gzip header, 0 if it is longer than
+ * 'len' or leaves no compressed data.
+ */
+int gzip_header_len(const unsigned char *src, unsigned long len)
 {
-	int i, flags;
+	unsigned long i;
+	int flags;
 
 	/* skip header */
 	i = 10;
+	if (len < i)
+		return 0;
 	flags = src[3];
-	if (src[2] != DEFLATED || (flags & RESERVED) != 0) {
+	if (src[2] != DEFLATED || (flags & RESERVED) != 0)
+		return -1;
+	if ((flags & EXTRA_FIELD) != 0) {
+		/* XLEN, then XLEN bytes of extra field */
+		if (len < 12)
+			return 0;
+		i = 12 + src[10] + (src[11] << 8);
+		if (i > len)
+			return 0;
+	}
+	if ((flags & ORIG_NAME) != 0) {
+		while (i < len && src[i] != 0)
+			i++;
+		if (i++ >= len)
+			return 0;
+	}
+	if ((flags & COMMENT) != 0) {
+		while (i < len && src[i] != 0)
+			i++;
+		if (i++ >= len)
+			return 0;
+	}
+	if ((flags & HEAD_CRC) != 0) {
+		if (len - i < 2)
+			return 0;
+		i += 2;
+	}
+	if (i >= len)
+		return 0;
+
+	return i;
+}
+
+int gunzip(void *dst, int dstlen, unsigned char *src, unsigned long *lenp)
+{
+	int i;
+
+	i = gzip_header_len(src, *lenp);
+	if (i < 0) {
 		puts ("Error: Bad gzipped data\n");
 		return (-1);
 	}
-	if ((flags & EXTRA_FIELD) != 0)
-		i = 12 + src[10] + (src[11] << 8);
-	if ((flags & ORIG_NAME) != 0)
-		while (src[i++] != 0)
-			;
-	if ((flags & COMMENT) != 0)
-		while (src[i++] != 0)
-			;
-	if ((flags & HEAD_CRC) != 0)
-		i += 2;
-	if (i >= *lenp) {
+	if (i == 0) {
 		puts ("Error: gunzip out of data in header\n");
 		return (-1);
 	}
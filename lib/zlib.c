@@ -406,6 +406,412 @@ void inflate_fast OF((z_streamp strm, unsigned start));
 #define PUP(a) *++(a)
 #define UP_UNALIGNED(a) get_unaligned(++(a))
 
+#ifdef CONFIG_ZLIB_INFLATE_FAST_ARM
+#if !defined(__ARM__) || !defined(__LITTLE_ENDIAN)
+#error CONFIG_ZLIB_INFLATE_FAST_ARM needs a little-endian ARM target
+#endif
+#define INFLATE_FAST_ARM
+#define INFLATE_FAST_MIN_IN 12  /* input inflate_fast() needs, see below */
+#else
+#define INFLATE_FAST_MIN_IN 6
+#endif
+
+#ifdef INFLATE_FAST_ARM
+/*
+   With CONFIG_ZLIB_INFLATE_FAST_ARM, inflate_fast() is replaced by the
+   variant below, written for the PXA27x (an ARMv5TE).  ARMv5 has no
+   unaligned word loads and the XScale core does no hardware prefetching, so
+   instead of the 16-bit copies of the generic version it:
+
+   - refills the bit buffer to at least 24 bits with one unconditional
+     three byte load, so a length code and its extra bits, or a distance
+     code, never need a second refill
+   - keeps decoding literals while the bits in hand cover the next code,
+     without going back through the refill
+   - copies matches of INFLATE_FAST_WORDS bytes or more a word at a time
+     when the distance is 8 or more (aligned loads, shifted together when
+     source and destination disagree on alignment) and fills a word pattern
+     for distances of 1, 2 and 4
+   - issues PLD hints for the input and for far away match sources
+
+   The bit buffer may hold copies of input bits above "bits"; they are
+   always the stream's own bits, so OR-ing them in again is harmless, and
+   they are masked off before returning.  Reading three bytes per refill
+   and up to three refills per length/distance pair needs 12 bytes of input
+   to be available, hence INFLATE_FAST_MIN_IN.
+
+   It produces the same output as the generic version (tools/zlib_bench
+   checks this on the host), but has not been timed on XScale hardware yet,
+   so it is off unless a board asks for it.
+ */
+#define INFLATE_FAST_WORDS 16
+
+typedef unsigned int __attribute__((__may_alias__)) zword;
+
+#define PLD(p) __builtin_prefetch(p)
+
+#define REFILL() \
+    do { \
+        hold |= (unsigned long)(in[0] | (in[1] << 8) | (in[2] << 16)) << bits; \
+        in += (31 - bits) >> 3; \
+        bits |= 24; \
+    } while (0)
+
+/*
+   Copy len bytes from "from" to "out" a word at a time.  The source may
+   overlap the destination only if it is 8 or more bytes behind it: a word
+   is loaded one iteration before its bytes are used.
+ */
+static inline unsigned char FAR *copy_words(unsigned char FAR *out,
+                                            const unsigned char FAR *from,
+                                            unsigned len)
+{
+    zword *dst;
+    const zword *src;
+    zword cur, next;
+    unsigned sh;
+
+    while ((unsigned long)out & 3) {
+        *out++ = *from++;
+        len--;
+    }
+    dst = (zword *)out;
+    sh = ((unsigned long)from & 3) << 3;
+    if (sh == 0) {
+        src = (const zword *)from;
+        while (len >= 8) {
+            dst[0] = src[0];
+            dst[1] = src[1];
+            dst += 2;
+            src += 2;
+            len -= 8;
+        }
+        if (len >= 4) {
+            *dst++ = *src++;
+            len -= 4;
+        }
+        from = (const unsigned char FAR *)src;
+    }
+    else {
+        src = (const zword *)(from - (sh >> 3));
+        cur = *src++;
+        while (len >= 4) {
+            next = *src++;
+            *dst++ = (cur >> sh) | (next << (32 - sh));
+            cur = next;
+            len -= 4;
+        }
+        from = (const unsigned char FAR *)src - 4 + (sh >> 3);
+    }
+    out = (unsigned char FAR *)dst;
+    while (len--)
+        *out++ = *from++;
+    return out;
+}
+
+/*
+   Repeat the last dist bytes before "out" for len bytes, dist being 1, 2
+   or 4 and len at least 8.
+ */
+static inline unsigned char FAR *fill_words(unsigned char FAR *out,
+                                            unsigned dist, unsigned len)
+{
+    const unsigned char FAR *from = out - dist;
+    zword pat, *dst;
+
+    /* four bytes first, so that out[-4..-1] is one period (or more) */
+    *out++ = *from++;
+    *out++ = *from++;
+    *out++ = *from++;
+    *out++ = *from++;
+    len -= 4;
+    while ((unsigned long)out & 3) {
+        *out++ = *from++;
+        len--;
+    }
+    dst = (zword *)out;
+    pat = dst[-1];
+    while (len >= 8) {
+        dst[0] = pat;
+        dst[1] = pat;
+        dst += 2;
+        len -= 8;
+    }
+    if (len >= 4) {
+        *dst++ = pat;
+        len -= 4;
+    }
+    out = (unsigned char FAR *)dst;
+    from = out - dist;
+    while (len--)
+        *out++ = *from++;
+    return out;
+}
+
+/*
+   Decode literal, length, and distance codes and write out the resulting
+   literal and match bytes until either not enough input or output is
+   available, an end-of-block is encountered, or a data error is encountered.
+
+   Entry assumptions:
+
+        state->mode == LEN
+        strm->avail_in >= INFLATE_FAST_MIN_IN
+        strm->avail_out >= 258
+        start >= strm->avail_out
+        state->bits < 8
+
+   On return, state->mode is one of:
+
+        LEN -- ran out of enough output space or enough available input
+        TYPE -- reached end of block code, inflate() to interpret next block
+        BAD -- error in block data
+ */
+void inflate_fast(strm, start)
+z_streamp strm;
+unsigned start;         /* inflate()'s starting value for strm->avail_out */
+{
+    struct inflate_state FAR *state;
+    unsigned char FAR *in;      /* local strm->next_in */
+    unsigned char FAR *last;    /* while in < last, enough input available */
+    unsigned char FAR *inend;   /* end of the input */
+    unsigned char FAR *out;     /* local strm->next_out */
+    unsigned char FAR *beg;     /* inflate()'s initial strm->next_out */
+    unsigned char FAR *end;     /* while out < end, enough space available */
+    unsigned char FAR *outend;  /* end of the output space */
+#ifdef INFLATE_STRICT
+    unsigned dmax;              /* maximum distance from zlib header */
+#endif
+    unsigned wsize;             /* window size or zero if not using window */
+    unsigned whave;             /* valid bytes in the window */
+    unsigned write;             /* window write index */
+    unsigned char FAR *window;  /* allocated sliding window, if wsize != 0 */
+    unsigned long hold;         /* local strm->hold */
+    unsigned bits;              /* local strm->bits */
+    code const FAR *lcode;      /* local strm->lencode */
+    code const FAR *dcode;      /* local strm->distcode */
+    unsigned lmask;             /* mask for first level of length codes */
+    unsigned dmask;             /* mask for first level of distance codes */
+    code this;                  /* retrieved table entry */
+    unsigned op;                /* code bits, operation, extra bits, or */
+                                /*  window position, window bytes to copy */
+    unsigned len;               /* match length, unused bytes */
+    unsigned dist;              /* match distance */
+    unsigned char FAR *from;    /* where to copy match from */
+
+    /* copy state to local variables */
+    state = (struct inflate_state FAR *)strm->state;
+    in = strm->next_in;
+    inend = in + strm->avail_in;
+    last = inend - (INFLATE_FAST_MIN_IN - 1);
+    out = strm->next_out;
+    beg = out - (start - strm->avail_out);
+    outend = out + strm->avail_out;
+    end = outend - 257;
+#ifdef INFLATE_STRICT
+    dmax = state->dmax;
+#endif
+    wsize = state->wsize;
+    whave = state->whave;
+    write = state->write;
+    window = state->window;
+    hold = state->hold;
+    bits = state->bits;
+    lcode = state->lencode;
+    dcode = state->distcode;
+    lmask = (1U << state->lenbits) - 1;
+    dmask = (1U << state->distbits) - 1;
+
+    /* decode literals and length/distances until end-of-block or not enough
+       input data or output space */
+    do {
+        PLD(in + 32);
+        REFILL();
+        this = lcode[hold & lmask];
+        if (this.op == 0) {                     /* run of literals */
+            do {
+                Tracevv((stderr, this.val >= 0x20 && this.val < 0x7f ?
+                        "inflate:         literal '%c'\n" :
+                        "inflate:         literal 0x%02x\n", this.val));
+                hold >>= this.bits;
+                bits -= this.bits;
+                *out++ = (unsigned char)(this.val);
+                this = lcode[hold & lmask];
+            } while (this.op == 0 && this.bits <= bits);
+            continue;
+        }
+      dolen:
+        op = (unsigned)(this.bits);
+        hold >>= op;
+        bits -= op;
+        op = (unsigned)(this.op);
+        if (op == 0) {                          /* literal */
+            Tracevv((stderr, this.val >= 0x20 && this.val < 0x7f ?
+                    "inflate:         literal '%c'\n" :
+                    "inflate:         literal 0x%02x\n", this.val));
+            *out++ = (unsigned char)(this.val);
+        }
+        else if (op & 16) {                     /* length base */
+            len = (unsigned)(this.val);
+            op &= 15;                           /* number of extra bits */
+            if (op) {
+                len += (unsigned)hold & ((1U << op) - 1);
+                hold >>= op;
+                bits -= op;
+            }
+            Tracevv((stderr, "inflate:         length %u\n", len));
+            REFILL();
+            this = dcode[hold & dmask];
+          dodist:
+            op = (unsigned)(this.bits);
+            hold >>= op;
+            bits -= op;
+            op = (unsigned)(this.op);
+            if (op & 16) {                      /* distance base */
+                dist = (unsigned)(this.val);
+                op &= 15;                       /* number of extra bits */
+                if (bits < op)
+                    REFILL();
+                dist += (unsigned)hold & ((1U << op) - 1);
+#ifdef INFLATE_STRICT
+                if (dist > dmax) {
+                    strm->msg = (char *)"invalid distance too far back";
+                    state->mode = BAD;
+                    break;
+                }
+#endif
+                hold >>= op;
+                bits -= op;
+                Tracevv((stderr, "inflate:         distance %u\n", dist));
+                op = (unsigned)(out - beg);     /* max distance in output */
+                if (dist > op) {                /* see if copy from window */
+                    op = dist - op;             /* distance back in window */
+                    if (op > whave) {
+                        strm->msg = (char *)"invalid distance too far back";
+                        state->mode = BAD;
+                        break;
+                    }
+                    from = window;
+                    if (write == 0) {           /* very common case */
+                        from += wsize - op;
+                        if (op < len) {         /* some from window */
+                            len -= op;
+                            do {
+                                *out++ = *from++;
+                            } while (--op);
+                            from = out - dist;  /* rest from output */
+                        }
+                    }
+                    else if (write < op) {      /* wrap around window */
+                        from += wsize + write - op;
+                        op -= write;
+                        if (op < len) {         /* some from end of window */
+                            len -= op;
+                            do {
+                                *out++ = *from++;
+                            } while (--op);
+                            from = window;
+                            if (write < len) {  /* some from start of window */
+                                op = write;
+                                len -= op;
+                                do {
+                                    *out++ = *from++;
+                                } while (--op);
+                                from = out - dist;      /* rest from output */
+                            }
+                        }
+                    }
+                    else {                      /* contiguous in window */
+                        from += write - op;
+                        if (op < len) {         /* some from window */
+                            len -= op;
+                            do {
+                                *out++ = *from++;
+                            } while (--op);
+                            from = out - dist;  /* rest from output */
+                        }
+                    }
+                    while (len > 2) {
+                        *out++ = *from++;
+                        *out++ = *from++;
+                        *out++ = *from++;
+                        len -= 3;
+                    }
+                    if (len) {
+                        *out++ = *from++;
+                        if (len > 1)
+                            *out++ = *from++;
+                    }
+                }
+                else if (len >= INFLATE_FAST_WORDS && dist >= 8) {
+                    from = out - dist;          /* copy direct from output */
+                    if (dist > 256)
+                        PLD(from + 32);
+                    out = copy_words(out, from, len);
+                }
+                else if (len >= INFLATE_FAST_WORDS &&
+                         (dist == 1 || dist == 2 || dist == 4)) {
+                    out = fill_words(out, dist, len);
+                }
+                else {
+                    from = out - dist;          /* copy direct from output */
+                    do {                        /* minimum length is three */
+                        *out++ = *from++;
+                        *out++ = *from++;
+                        *out++ = *from++;
+                        len -= 3;
+                    } while (len > 2);
+                    if (len) {
+                        *out++ = *from++;
+                        if (len > 1)
+                            *out++ = *from++;
+                    }
+                }
+            }
+            else if ((op & 64) == 0) {          /* 2nd level distance code */
+                this = dcode[this.val + (hold & ((1U << op) - 1))];
+                goto dodist;
+            }
+            else {
+                strm->msg = (char *)"invalid distance code";
+                state->mode = BAD;
+                break;
+            }
+        }
+        else if ((op & 64) == 0) {              /* 2nd level length code */
+            this = lcode[this.val + (hold & ((1U << op) - 1))];
+            goto dolen;
+        }
+        else if (op & 32) {                     /* end-of-block */
+            Tracevv((stderr, "inflate:         end of block\n"));
+            state->mode = TYPE;
+            break;
+        }
+        else {
+            strm->msg = (char *)"invalid literal/length code";
+            state->mode = BAD;
+            break;
+        }
+    } while (in < last && out < end);
+
+    /* return unused bytes (bits < 32, so at most three of them) */
+    len = bits >> 3;
+    in -= len;
+    bits -= len << 3;
+    hold &= (1U << bits) - 1;
+
+    /* update state and return */
+    strm->next_in = in;
+    strm->next_out = out;
+    strm->avail_in = (unsigned)(inend - in);
+    strm->avail_out = (unsigned)(outend - out);
+    state->hold = hold;
+    state->bits = bits;
+    return;
+}
+
+#else /* !INFLATE_FAST_ARM */
+
 /*
    Decode literal, length, and distance codes and write out the resulting
    literal and match bytes until either not enough input or output is
@@ -706,6 +1112,7 @@ unsigned start;         /* inflate()'s starting value for strm->avail_out */
     state->bits = bits;
     return;
 }
+#endif /* INFLATE_FAST_ARM */
 
 /*
    inflate_fast() speedups that turned out slower (on a PowerPC G3 750CXe):
@@ -1778,7 +2185,7 @@ int flush;
         case LEN:
             if (strm->outcb != Z_NULL) /* for watchdog (U-Boot) */
                 (*strm->outcb)(Z_NULL, 0);
-            if (have >= 6 && left >= 258) {
+            if (have >= INFLATE_FAST_MIN_IN && left >= 258) {
                 RESTORE();
                 inflate_fast(strm, out);
                 LOAD();
@@ -0,0 +1,127 @@
+/*
+ * Host harness for extent mapped (ext4) files in fs/ext2.
+ *
+ * fs/ext2/ext2fs.c is built unmodified against the U-Boot headers, with
+ * the device access replaced by reads from an image file. The named
+ * files are then read from the image at random offsets and lengths,
+ * switching between files all the time, so the extent cache is hit,
+ * missed and replaced in every order, and compared with the host copies
+ * in <dir>.
+ *
+ * Usage: ext2_extent_test <image> <dir> <reads> <file>...
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ */
+
+#include <common.h>
+#include <malloc.h>
+#include <part.h>
+#include <ext2fs.h>
+
+/*
+ * The U-Boot headers replace the host libc ones (-nostdinc), so the
+ * few host calls used here are declared by hand.
+ */
+extern int open(const char *, int, ...);
+extern long pread(int, void *, unsigned long, long);
+extern void exit(int);
+extern int atoi(const char *);
+extern int rand(void);
+extern void srand(unsigned int);
+
+#define NFILES_MAX	16
+#define MAX_READ	(256 * 1024)
+
+static int img_fd;
+static block_dev_desc_t img_dev;
+
+block_dev_desc_t *ext2fs_get_blk_dev(int *part, disk_partition_t *info)
+{
+	*part = 1;
+	memset(info, 0, sizeof(*info));
+	return &img_dev;
+}
+
+int ext2fs_devread(int sector, int byte_offset, int byte_len, char *buf)
+{
+	long off = (long)sector * SECTOR_SIZE + byte_offset;
+
+	if (pread(img_fd, buf, byte_len, off) != byte_len) {
+		printf("devread: cannot read %d bytes at %ld\n", byte_len, off);
+		return 0;
+	}
+	return 1;
+}
+
+static char *slurp(const char *dir, const char *name, long *len)
+{
+	static char path[512];
+	char *b;
+	int fd;
+
+	sprintf(path, "%s/%s", dir, name);
+	fd = open(path, 0);
+	if (fd < 0) {
+		printf("cannot open %s\n", path);
+		exit(1);
+	}
+	b = malloc(64 << 20);
+	*len = pread(fd, b, 64 << 20, 0);
+	return b;
+}
+
+int main(int argc, char **argv)
+{
+	static char path[256];
+	static char out[MAX_READ];
+	char *ref[NFILES_MAX];
+	long size[NFILES_MAX];
+	int nfiles, reads, i, f, len, got;
+	unsigned int pos;
+
+	if (argc < 5 || argc - 4 > NFILES_MAX) {
+		printf("usage: %s <image> <dir> <reads> <file>...\n", argv[0]);
+		return 1;
+	}
+	img_fd = open(argv[1], 0);
+	if (img_fd < 0) {
+		printf("cannot open %s\n", argv[1]);
+		return 1;
+	}
+	reads = atoi(argv[3]);
+	nfiles = argc - 4;
+	for (f = 0; f < nfiles; f++)
+		ref[f] = slurp(argv[2], argv[4 + f], &size[f]);
+
+	srand(1);
+	for (i = 0; i < reads; i++) {
+		f = rand() % nfiles;
+		pos = rand() % size[f];
+		len = 1 + rand() % (rand() % 4 ? 64 : MAX_READ);
+		if (len > size[f] - pos)
+			len = size[f] - pos;
+
+		if (!ext2fs_mount(0)) {
+			printf("mount failed\n");
+			return 1;
+		}
+		sprintf(path, "/%s", argv[4 + f]);
+		if (ext2fs_open(path) != size[f]) {
+			printf("cannot open %s\n", path);
+			return 1;
+		}
+		memset(out, 0x5a, len);
+		got = ext2fs_read_at(out, pos, len);
+		ext2fs_close();
+		if (got != len || memcmp(out, ref[f] + pos, len)) {
+			printf("MISMATCH %s: %d bytes at %u (read %d)\n",
+			       argv[4 + f], len, pos, got);
+			return 1;
+		}
+	}
+	printf("%d reads of %d files ok\n", reads, nfiles);
+	return 0;
+}
@@ -0,0 +1,75 @@
+#!/bin/sh
+#
+# Build ext4 images holding a dense file, a sparse file with a two level
+# extent tree and a sparse file whose few extents fit in the inode, and
+# read them back at random offsets, for 1K and 4K blocks. Then check
+# that corrupt extent headers are refused.
+#
+
+set -e
+cd "$(dirname "$0")"
+T=test.tmp
+rm -rf $T
+mkdir -p $T/files
+
+python3 - $T/files <<'PY'
+import random
+import sys
+
+d = sys.argv[1]
+r = random.Random(3)
+
+
+def data(n):
+    return bytes(r.randrange(1, 256) for _ in range(n))
+
+
+def sparse(fn, size, runs, maxrun):
+    # Runs of data at random 1K aligned offsets, holes in between
+    with open(fn, 'wb') as f:
+        f.truncate(size)
+        for i in range(runs):
+            pos = r.randrange(size // 1024) * 1024
+            f.seek(pos)
+            f.write(data(min(1024 * r.randrange(1, maxrun), size - pos)))
+
+
+with open(d + '/dense', 'wb') as f:
+    f.write(data(2 << 20))
+sparse(d + '/sparse', 8 << 20, 300, 8)
+sparse(d + '/small', 1 << 20, 3, 20)
+PY
+
+for bs in 1024 4096; do
+	mkfs.ext4 -q -F -b $bs -d $T/files $T/img.$bs 32M > /dev/null
+	./ext2_extent_test $T/img.$bs $T/files 5000 dense sparse small
+done
+
+# Extent headers claiming more entries than they hold, or more than fit
+# in the inode, must be refused rather than read past the node.
+loc=$(debugfs -R "imap /small" $T/img.1024 2>/dev/null |
+	sed -n 's/.*located at block \([0-9]*\), offset \(0x[0-9a-f]*\).*/\1 \2/p')
+for field in entries max; do
+	cp $T/img.1024 $T/bad.img
+	python3 - $T/bad.img $loc $field <<'PY'
+import struct
+import sys
+
+img, blk, off, field = sys.argv[1], int(sys.argv[2]), int(sys.argv[3], 16), sys.argv[4]
+# inode.b starts 40 bytes into the inode: magic, entries, max, depth
+pos = blk * 1024 + off + 40 + (2 if field == 'entries' else 4)
+with open(img, 'r+b') as f:
+    f.seek(pos)
+    f.write(struct.pack('<H', 5))
+PY
+	if ./ext2_extent_test $T/bad.img $T/files 50 small > $T/log 2>&1 ||
+	   ! grep -q 'bad extent tree' $T/log; then
+		cat $T/log
+		echo "FAIL: corrupt extent $field accepted"
+		exit 1
+	fi
+	echo "corrupt extent $field: refused"
+done
+
+rm -rf $T
+echo "all tests passed"
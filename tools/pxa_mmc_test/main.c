@@ -0,0 +1,348 @@
+/*
+ * Host harness for block reads through the PXA MMC host driver.
+ *
+ * drivers/mmc/mmc.c and drivers/mmc/pxa_mmc_gen.c are built unmodified
+ * against the U-Boot headers, with every register access routed to
+ * pxa_sim_reg() (see pxa_sim.h). That emulates just enough of the PXA27x
+ * MMC controller in PIO mode, and of an SDHC card behind it, for
+ * mmc_init() and mmc_bread() to run.
+ *
+ * The same range of blocks is then read once per <b_max> argument, with
+ * mmc->b_max forced to that value, and checked against the card pattern.
+ * b_max 1 gives one CMD17 per block, which is what mmc_bread() used to do.
+ * For each read the harness counts the commands, the clock stops and the
+ * controller register accesses, and the SD bus clocks the transfer takes
+ * (commands, responses and data blocks with their CRCs; the card's read
+ * access time is left out).
+ *
+ * Usage: pxa_mmc_test <start> <blocks> <b_max>...
+ *
+ * The driver drains the RX FIFO a word at a time, so the buffers passed
+ * to it must be word aligned; the byte path is not emulated.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ */
+
+#include <common.h>
+#include <malloc.h>
+#include <part.h>
+#include <mmc.h>
+
+#include "../../drivers/mmc/pxa_mmc.h"
+
+/*
+ * The U-Boot headers replace the host libc ones (-nostdinc), so the
+ * few host calls used here are declared by hand.
+ */
+extern unsigned long strtoul(const char *, char **, int);
+extern void exit(int);
+
+#define MMC_BASE	0x41100000
+#define CARD_BLOCKS	(128 * 1024)	/* 64MiB */
+
+/* Controller registers, in address order from MMC_BASE */
+enum {
+	SIM_STRPCL, SIM_STAT, SIM_CLKRT, SIM_SPI, SIM_CMDAT, SIM_RESTO,
+	SIM_RDTO, SIM_BLKLEN, SIM_NOB, SIM_PRTBUF, SIM_I_MASK, SIM_I_REG,
+	SIM_CMD, SIM_ARGH, SIM_ARGL, SIM_RES, SIM_RXFIFO, SIM_TXFIFO,
+	SIM_NREGS
+};
+
+static u32 regs[SIM_NREGS];
+static int last = -1;		/* register handed out by the last access */
+
+static u16 resp[9];		/* response FIFO, as read from MMC_RES */
+static int resp_pos;
+
+static const u8 *rx_buf;	/* register data (SCR, switch status), or */
+static u64 rx_off;		/* card byte offset of block data */
+static u32 rx_pos, rx_len;
+
+static struct {
+	int app;		/* last command was APP_CMD */
+	int sending;		/* in a READ_MULTIPLE_BLOCK until stopped */
+	int blocklen;
+} card;
+
+static struct {
+	long cmds, cmd[64], stops, regs, clocks;
+} st;
+
+/* Block data of the emulated card is a function of the byte offset */
+static u8 card_byte(u64 off)
+{
+	u32 x = (u32)off * 2654435761u + (u32)(off >> 9);
+
+	return x >> 24;
+}
+
+/*
+ * The card: fill in the response words and set up the data phase, if
+ * there is one. Returns -1 if the card doesn't answer the command.
+ */
+static int card_cmd(int idx, u32 arg, u32 *r)
+{
+	static const u8 scr[8] = { 0x02, 0x35 };	/* SD 2.0, 1 and 4 bit */
+	static const u8 switch_status[64];		/* no high speed */
+	int app = card.app;
+	u32 csize = CARD_BLOCKS / 1024 - 1;
+
+	card.app = 0;
+	if (card.sending && idx != MMC_CMD_STOP_TRANSMISSION) {
+		printf("CMD%d while the card is sending data\n", idx);
+		exit(1);
+	}
+
+	/* R1 card status: READY_FOR_DATA in the transfer state */
+	r[0] = 0x900;
+
+	switch (idx) {
+	case MMC_CMD_GO_IDLE_STATE:
+		r[0] = 0;
+		break;
+	case SD_CMD_SEND_IF_COND:
+		r[0] = arg & 0xfff;
+		break;
+	case MMC_CMD_APP_CMD:
+		card.app = 1;
+		r[0] |= 0x20;
+		break;
+	case SD_CMD_APP_SEND_OP_COND:
+		if (!app)
+			return -1;
+		r[0] = OCR_BUSY | OCR_HCS | 0xff8000;
+		break;
+	case MMC_CMD_ALL_SEND_CID:
+		r[0] = 0x03534453;	/* "SD" */
+		r[1] = 0x53494d30;	/* "SIM0" */
+		r[2] = 0x10000001;
+		r[3] = 0x00a10000;
+		break;
+	case SD_CMD_SEND_RELATIVE_ADDR:
+		r[0] = 0x12340500;
+		break;
+	case MMC_CMD_SEND_CSD:
+		/* CSD 2.0: 25MHz, 512 byte blocks, (csize + 1) * 512KiB */
+		r[0] = 0x400e0032;
+		r[1] = 0x5b590000 | (csize >> 16);
+		r[2] = (csize & 0xffff) << 16 | 0x7f80;
+		r[3] = 0x0a400000;
+		break;
+	case MMC_CMD_SELECT_CARD:
+	case MMC_CMD_SEND_STATUS:
+		break;
+	case MMC_CMD_SET_BLOCKLEN:
+		card.blocklen = arg;
+		break;
+	case SD_CMD_APP_SEND_SCR:	/* == MMC_CMD_SEND_EXT_CSD */
+		if (!app)
+			return -1;
+		rx_buf = scr;
+		break;
+	case SD_CMD_SWITCH_FUNC:	/* ACMD6 is SET_BUS_WIDTH */
+		if (!app)
+			rx_buf = switch_status;
+		break;
+	case MMC_CMD_READ_MULTIPLE_BLOCK:
+		card.sending = 1;
+		/* fall through */
+	case MMC_CMD_READ_SINGLE_BLOCK:
+		if (card.blocklen != 512 || arg >= CARD_BLOCKS) {
+			printf("CMD%d: bad read of block %u (blocklen %d)\n",
+			       idx, arg, card.blocklen);
+			exit(1);
+		}
+		rx_off = (u64)arg * 512;
+		break;
+	case MMC_CMD_STOP_TRANSMISSION:
+		card.sending = 0;
+		break;
+	default:
+		printf("CMD%d not emulated\n", idx);
+		return -1;
+	}
+
+	return 0;
+}
+
+/* The controller, when the clock is started: run one command */
+static void run_cmd(void)
+{
+	u32 cmdat = regs[SIM_CMDAT];
+	int idx = regs[SIM_CMD] & 0x3f;
+	u32 arg = regs[SIM_ARGH] << 16 | (regs[SIM_ARGL] & 0xffff);
+	int rtype = cmdat & 3;
+	u32 r[4] = { 0 };
+	u8 b[18] = { 0 };
+	int i;
+
+	st.cmds++;
+	st.cmd[idx]++;
+	regs[SIM_STAT] = MMC_STAT_CLK_EN | MMC_STAT_END_CMD_RES;
+	regs[SIM_I_REG] = 0;
+	rx_buf = NULL;
+	rx_pos = rx_len = 0;
+
+	/* Command, response and the gaps around it */
+	st.clocks += 48 + 8 + (rtype == MMC_CMDAT_R2 ? 136 : rtype ? 48 : 0);
+
+	if (card_cmd(idx, arg, r)) {
+		regs[SIM_STAT] |= MMC_STAT_TIME_OUT_RESPONSE;
+		r[0] = r[1] = r[2] = r[3] = 0;
+	}
+
+	/* The 16-bit FIFO holds the response after the start and cmd bits */
+	b[0] = rtype == MMC_CMDAT_R2 ? 0x3f : idx;
+	for (i = 0; i < 16; i++)
+		b[1 + i] = r[i / 4] >> (24 - 8 * (i % 4));
+	for (i = 0; i < 9; i++)
+		resp[i] = b[2 * i] << 8 | b[2 * i + 1];
+	resp_pos = 0;
+
+	if (!(cmdat & MMC_CMDAT_DATA_EN))
+		return;
+	if (cmdat & MMC_CMDAT_WRITE) {
+		printf("CMD%d: writes are not emulated\n", idx);
+		exit(1);
+	}
+
+	rx_len = regs[SIM_NOB] * regs[SIM_BLKLEN];
+	regs[SIM_I_REG] = MMC_I_REG_RXFIFO_RD_REQ;
+
+	/* Start bit, data, CRC16 per line and end bit for every block */
+	st.clocks += regs[SIM_NOB] * (2 + 16 + regs[SIM_BLKLEN] * 8 /
+			(cmdat & MMC_CMDAT_SD_4DAT ? 4 : 1));
+}
+
+static u32 rx_word(void)
+{
+	u32 w = 0;
+	int i;
+
+	if (rx_pos >= rx_len) {
+		printf("RX FIFO read with no data\n");
+		exit(1);
+	}
+
+	for (i = 0; i < 4; i++, rx_pos++)
+		w |= (rx_buf ? rx_buf[rx_pos] :
+			card_byte(rx_off + rx_pos)) << (8 * i);
+
+	if (rx_pos >= rx_len) {
+		regs[SIM_I_REG] &= ~MMC_I_REG_RXFIFO_RD_REQ;
+		regs[SIM_STAT] |= MMC_STAT_DATA_TRAN_DONE;
+	}
+
+	return w;
+}
+
+/* Act on a write to MMC_STRPCL once the driver moves on */
+static void sim_sync(void)
+{
+	u32 v;
+
+	if (last != SIM_STRPCL)
+		return;
+
+	v = regs[SIM_STRPCL];
+	regs[SIM_STRPCL] = 0;
+
+	if (v & MMC_STRPCL_STOP_CLK) {
+		st.stops++;
+		regs[SIM_STAT] &= ~MMC_STAT_CLK_EN;
+	}
+	if (v & MMC_STRPCL_START_CLK)
+		run_cmd();
+}
+
+volatile u32 *pxa_sim_reg(u32 addr)
+{
+	static u32 other;
+	int r = (addr - MMC_BASE) >> 2;
+
+	sim_sync();
+
+	if (addr < MMC_BASE || r >= SIM_NREGS) {
+		last = -1;
+		return &other;
+	}
+
+	st.regs++;
+	last = r;
+	if (r == SIM_RES)
+		regs[r] = resp_pos < 9 ? resp[resp_pos++] : 0;
+	else if (r == SIM_RXFIFO)
+		regs[r] = rx_word();
+
+	return &regs[r];
+}
+
+void udelay(unsigned long usec)
+{
+}
+
+void init_part(block_dev_desc_t *dev_desc)
+{
+}
+
+void blk_cache_invalidate(int if_type, int dev)
+{
+}
+
+int main(int argc, char **argv)
+{
+	struct mmc *mmc;
+	ulong start, blocks, n, i;
+	u8 *buf;
+	int k;
+
+	if (argc < 4) {
+		printf("usage: %s <start> <blocks> <b_max>...\n", argv[0]);
+		return 1;
+	}
+	start = strtoul(argv[1], NULL, 0);
+	blocks = strtoul(argv[2], NULL, 0);
+
+	mmc_initialize(NULL);
+	mmc = find_mmc_device(0);
+	if (!mmc || mmc_init(mmc)) {
+		printf("mmc_init failed\n");
+		return 1;
+	}
+	printf("%s: %lu blocks, %d bit bus at %u Hz\n", mmc->name,
+	       mmc->block_dev.lba, mmc->bus_width, mmc->clock);
+
+	buf = malloc(blocks * 512);
+	for (k = 3; k < argc; k++) {
+		mmc->b_max = strtoul(argv[k], NULL, 0);
+		memset(&st, 0, sizeof(st));
+		memset(buf, 0x5a, blocks * 512);
+
+		n = mmc->block_dev.block_read(mmc->block_dev.dev, start,
+					      blocks, buf);
+		if (n != blocks) {
+			printf("b_max %u: read %lu of %lu blocks\n",
+			       mmc->b_max, n, blocks);
+			return 1;
+		}
+		for (i = 0; i < blocks * 512; i++)
+			if (buf[i] != card_byte((u64)start * 512 + i)) {
+				printf("b_max %u: MISMATCH at byte %lu\n",
+				       mmc->b_max, i);
+				return 1;
+			}
+
+		printf("b_max %5u: %ld cmds (CMD16 %ld CMD17 %ld CMD18 %ld "
+		       "CMD12 %ld), %ld clock stops, %ld register accesses, "
+		       "%ld bus clocks (%ld us)\n", mmc->b_max, st.cmds,
+		       st.cmd[MMC_CMD_SET_BLOCKLEN],
+		       st.cmd[MMC_CMD_READ_SINGLE_BLOCK],
+		       st.cmd[MMC_CMD_READ_MULTIPLE_BLOCK],
+		       st.cmd[MMC_CMD_STOP_TRANSMISSION], st.stops, st.regs,
+		       st.clocks, (long)((u64)st.clocks * 1000000 / mmc->clock));
+	}
+	return 0;
+}
@@ -0,0 +1,27 @@
+/*
+ * Forced into every source file of the PXA MMC harness after the board
+ * config: all PXA registers are routed to pxa_sim_reg() in main.c, which
+ * emulates the MMC controller and the card behind it.
+ *
+ * The harness drives the PIO data path only, so DMA is switched off.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ */
+
+#ifndef __PXA_SIM_H
+#define __PXA_SIM_H
+
+#include <asm/types.h>
+#include <asm/arch/hardware.h>
+
+#undef CONFIG_PXA_DMA
+
+extern volatile u32 *pxa_sim_reg(u32 addr);
+
+#undef __REG
+#define __REG(x)	(*pxa_sim_reg(x))
+
+#endif /* __PXA_SIM_H */
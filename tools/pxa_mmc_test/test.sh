@@ -0,0 +1,30 @@
+#!/bin/sh
+#
+# Read 3MiB (6144 blocks) from the emulated card with one CMD17 per
+# block, in chunks of 2048 blocks (the PXA DMA descriptor chain) and in
+# one CMD18 (the 16-bit MMC_NOB limit), then a short read that ends in a
+# single block. Every read is checked against the card pattern, and the
+# command counts against what mmc_bread() should issue.
+#
+
+set -e
+cd "$(dirname "$0")"
+
+expect() {
+	echo "$out" | grep -q "^b_max *$1: $2 cmds" || {
+		echo "b_max $1: expected $2 commands"
+		exit 1
+	}
+}
+
+out=$(./pxa_mmc_test 1000 6144 1 2048 65535)
+echo "$out"
+expect 1 6145
+expect 2048 7
+expect 65535 3
+
+out=$(./pxa_mmc_test 1001 7 3)
+echo "$out"
+expect 3 6
+
+echo "all reads ok"
@@ -0,0 +1,146 @@
+#!/usr/bin/env python3
+#
+# Edit the fastmap of an image written by ubi_fm_test so that attach has
+# to take the slow paths of attach_fastmap():
+#
+#   fmedit.py <image> pool   [vol_id]
+#       move the first mapped LEB of volume 0 out of the EBA table and its
+#       PEB from the used list into the user pool (plus one free PEB into
+#       the WL pool), as if it had been written after the fastmap
+#   fmedit.py <image> orphan [vol_id]
+#       unmap that LEB from the EBA table but leave its PEB in the used
+#       list, so attach finds it through the orphan loop
+#
+# With vol_id, the VID header of the moved PEB is also rewritten to carry
+# that volume ID, to check how attach treats out-of-range IDs.
+#
+# The layout matches ubi-media.h for a 16KiB PEB, 512 byte page NAND.
+
+import struct
+import sys
+import zlib
+
+PEB = 16384
+VID_OFF = 512
+DATA_OFF = 1024
+LEB = PEB - DATA_OFF
+
+UBI_INTERNAL_VOL_START = 0x7fffffff - 4096
+UBI_FM_SB_VOLUME_ID = UBI_INTERNAL_VOL_START + 1
+UBI_FM_MAX_START = 64
+UBI_FM_MAX_BLOCKS = 32
+
+FM_SB_SIZE = 312        # struct ubi_fm_sb
+FM_HDR_SIZE = 32        # struct ubi_fm_hdr
+FM_POOL_SIZE = 1048     # struct ubi_fm_scan_pool
+FM_VOLHDR_SIZE = 32     # struct ubi_fm_volhdr
+VID_HDR_SIZE_CRC = 60
+
+
+def ubi_crc32(data):
+    # crc32(UBI_CRC32_INIT, ...) without the final inversion
+    return ~zlib.crc32(bytes(data)) & 0xffffffff
+
+
+def find_anchor(data):
+    anchor, best = None, -1
+    for pnum in range(UBI_FM_MAX_START):
+        o = pnum * PEB + VID_OFF
+        if data[o:o + 4] != b'UBI!':
+            continue
+        vol_id = struct.unpack('>I', data[o + 8:o + 12])[0]
+        sqnum = struct.unpack('>Q', data[o + 24:o + 32])[0]
+        if vol_id == UBI_FM_SB_VOLUME_ID and sqnum > best:
+            anchor, best = pnum, sqnum
+    if anchor is None:
+        sys.exit('no fastmap anchor found')
+    return anchor
+
+
+def main():
+    img, mode = sys.argv[1], sys.argv[2]
+    new_vol_id = int(sys.argv[3]) if len(sys.argv) > 3 else None
+    if mode not in ('pool', 'orphan'):
+        sys.exit('unknown mode ' + mode)
+
+    with open(img, 'rb') as f:
+        data = bytearray(f.read())
+
+    anchor = find_anchor(data)
+    sb = anchor * PEB + DATA_OFF
+    nblocks = struct.unpack('>I', data[sb + 12:sb + 16])[0]
+    locs = struct.unpack('>%dI' % UBI_FM_MAX_BLOCKS,
+                         data[sb + 16:sb + 16 + 4 * UBI_FM_MAX_BLOCKS])[:nblocks]
+    raw = b''.join(bytes(data[p * PEB + DATA_OFF:(p + 1) * PEB]) for p in locs)
+
+    # Parse the fastmap: header, two pools, the PEB lists and volumes
+    pos = FM_SB_SIZE
+    hdr = list(struct.unpack('>7I4x', raw[pos:pos + FM_HDR_SIZE]))
+    pos += FM_HDR_SIZE
+    pools = []
+    for i in range(2):
+        magic, size, max_size = struct.unpack('>IHH', raw[pos:pos + 8])
+        pebs = list(struct.unpack('>%dI' % size, raw[pos + 8:pos + 8 + 4 * size]))
+        pools.append([magic, max_size, pebs])
+        pos += FM_POOL_SIZE
+    # free, used, scrub and erase lists; hdr[4] (bad) is unused
+    lists = []
+    for n in (1, 2, 3, 5):
+        lists.append([struct.unpack('>II', raw[pos + 8 * i:pos + 8 * i + 8])
+                      for i in range(hdr[n])])
+        pos += 8 * hdr[n]
+    vols = []
+    for v in range(hdr[6]):
+        volhdr = raw[pos:pos + FM_VOLHDR_SIZE]
+        pos += FM_VOLHDR_SIZE
+        magic, rsv = struct.unpack('>II', raw[pos:pos + 8])
+        eba = list(struct.unpack('>%dI' % rsv, raw[pos + 8:pos + 8 + 4 * rsv]))
+        pos += 8 + 4 * rsv
+        vols.append([volhdr, magic, eba])
+
+    volhdr, magic, eba = [v for v in vols
+                          if struct.unpack('>I', v[0][4:8])[0] == 0][0]
+    lnum = [i for i, p in enumerate(eba) if p != 0xffffffff][0]
+    pnum = eba[lnum]
+    eba[lnum] = 0xffffffff
+    print('moved PEB %d (LEB %d) to %s' % (pnum, lnum, mode))
+
+    if mode == 'pool':
+        ent = [e for e in lists[1] if e[0] == pnum][0]
+        lists[1].remove(ent)
+        pools[0][2].append(pnum)
+        pools[1][2].append(lists[0].pop()[0])
+
+    # Write the fastmap back
+    out = bytearray(raw[:FM_SB_SIZE])
+    out += struct.pack('>7I4x', hdr[0], len(lists[0]), len(lists[1]),
+                       len(lists[2]), hdr[4], len(lists[3]), hdr[6])
+    for magic_, max_size, pebs in pools:
+        b = struct.pack('>IHH', magic_, len(pebs), max_size)
+        b += struct.pack('>%dI' % len(pebs), *pebs)
+        out += b + bytes(FM_POOL_SIZE - len(b))
+    for l in lists:
+        for e in l:
+            out += struct.pack('>II', *e)
+    for volhdr_, magic_, eba_ in vols:
+        out += volhdr_ + struct.pack('>II', magic_, len(eba_))
+        out += struct.pack('>%dI' % len(eba_), *eba_)
+    out += bytes(len(raw) - len(out))
+    out[8:12] = bytes(4)
+    out[8:12] = struct.pack('>I', ubi_crc32(out))
+    for i, p in enumerate(locs):
+        data[p * PEB + DATA_OFF:(p + 1) * PEB] = out[i * LEB:(i + 1) * LEB]
+
+    if new_vol_id is not None:
+        o = pnum * PEB + VID_OFF
+        data[o + 8:o + 12] = struct.pack('>I', new_vol_id)
+        crc = ubi_crc32(data[o:o + VID_HDR_SIZE_CRC])
+        data[o + VID_HDR_SIZE_CRC:o + VID_HDR_SIZE_CRC + 4] = struct.pack('>I', crc)
+        print('PEB %d now claims volume %d' % (pnum, new_vol_id))
+
+    with open(img, 'r+b') as f:
+        f.write(data)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,354 @@
+/*
+ * Host harness for the UBI attach code (scan and fastmap).
+ *
+ * The UBI sources are built unmodified against the U-Boot headers and
+ * attached to a RAM-backed NAND MTD whose contents live in an image
+ * file, so an image can be written with fastmap enabled, edited with
+ * fmedit.py and attached again with or without fastmap support.
+ *
+ * Usage: ubi_fm_test <image> <step>...
+ *
+ *   erase      erase the whole image
+ *   mkvols     create the three test volumes
+ *   writeN     do 200 pseudo-random LEB writes with seed N
+ *   verifyN    check every LEB written by seeds 1..N
+ *   dump=FILE  write the volume EBA tables and erase counters to FILE
+ *   attach     attach and detach only
+ *
+ * Every step but "erase" attaches and detaches the device once.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ */
+
+#include <ubi_uboot.h>
+
+/*
+ * The U-Boot headers replace the host libc ones (-nostdinc), so the
+ * few host calls used here are declared by hand.
+ */
+extern long strtoul(const char *, char **, int);
+extern int atoi(const char *);
+extern void exit(int);
+extern int open(const char *, int, ...);
+extern long write(int, const void *, unsigned long);
+extern int ftruncate(int, long);
+extern void *mmap(void *, unsigned long, int, int, int, long);
+
+#define H_O_WRONLY	01
+#define H_O_RDWR	02
+#define H_O_CREAT	0100
+#define H_O_TRUNC	01000
+#define H_PROT_RW	3
+#define H_MAP_SHARED	1
+
+#define PEB_SIZE	(16 * 1024)
+#define PEB_COUNT	2048
+#define PAGE_SIZE_	512
+#define NVOLS		3
+#define WRITES		200
+
+static unsigned char *flash;
+static struct mtd_info mtd;
+static long nreads, nwrites, nerases;
+static unsigned char buf[PEB_SIZE];
+
+unsigned long simple_strtoul(const char *cp, char **endp, unsigned int base)
+{
+	return strtoul(cp, endp, base);
+}
+
+void panic(const char *fmt, ...)
+{
+	printf("PANIC %s\n", fmt);
+	exit(1);
+}
+
+static int ram_read(struct mtd_info *m, loff_t from, size_t len,
+		    size_t *retlen, u_char *b)
+{
+	nreads++;
+	memcpy(b, flash + from, len);
+	*retlen = len;
+	return 0;
+}
+
+static int ram_write(struct mtd_info *m, loff_t to, size_t len,
+		     size_t *retlen, const u_char *b)
+{
+	size_t i;
+
+	nwrites++;
+	for (i = 0; i < len; i++) {
+		if (flash[to + i] != 0xff) {
+			printf("write to non-erased flash at %lld\n",
+			       (long long)to + i);
+			exit(1);
+		}
+		flash[to + i] = b[i];
+	}
+	*retlen = len;
+	return 0;
+}
+
+static int ram_erase(struct mtd_info *m, struct erase_info *ei)
+{
+	nerases++;
+	memset(flash + ei->addr, 0xff, ei->len);
+	ei->state = MTD_ERASE_DONE;
+	if (ei->callback)
+		ei->callback(ei);
+	return 0;
+}
+
+static int ram_isbad(struct mtd_info *m, loff_t ofs)
+{
+	return 0;
+}
+
+static int ram_markbad(struct mtd_info *m, loff_t ofs)
+{
+	return 0;
+}
+
+struct mtd_info *get_mtd_device_nm(const char *name)
+{
+	return &mtd;
+}
+
+struct mtd_info *get_mtd_device(struct mtd_info *m, int num)
+{
+	return &mtd;
+}
+
+void put_mtd_device(struct mtd_info *m)
+{
+}
+
+static int vol_lebs(int vol_id)
+{
+	return vol_id == 1 ? 100 : 300;
+}
+
+/* LEB contents are a function of the volume, LEB and write generation */
+static void fill(unsigned char *b, int vol_id, int lnum, int gen, int len)
+{
+	unsigned int x = vol_id * 7919 + lnum * 104729 + gen * 31;
+	int i;
+
+	for (i = 0; i < len; i++) {
+		x = x * 1103515245 + 12345;
+		b[i] = x >> 16;
+	}
+}
+
+/* The n-th write of seed picks its volume and LEB from the same LCG */
+static void next_write(unsigned int *x, int *vol_id, int *lnum)
+{
+	*x = *x * 1103515245 + 12345;
+	*vol_id = (*x >> 8) % NVOLS;
+	*lnum = (*x >> 12) % vol_lebs(*vol_id) % WRITES;
+}
+
+static struct ubi_device *attach(void)
+{
+	nreads = nwrites = nerases = 0;
+	ubi_mtd_param_parse("ram", NULL);
+	if (ubi_init()) {
+		printf("attach failed\n");
+		exit(1);
+	}
+	printf("attach: %ld reads %ld writes %ld erases\n",
+	       nreads, nwrites, nerases);
+	return ubi_devices[0];
+}
+
+static void mkvols(struct ubi_device *ubi)
+{
+	struct ubi_mkvol_req req;
+	int i;
+
+	for (i = 0; i < NVOLS; i++) {
+		memset(&req, 0, sizeof(req));
+		req.vol_id = i;
+		req.alignment = 1;
+		req.bytes = (long long)ubi->leb_size * vol_lebs(i);
+		req.vol_type = UBI_DYNAMIC_VOLUME;
+		sprintf(req.name, "v%d", i);
+		req.name_len = strlen(req.name);
+		if (ubi_create_volume(ubi, &req)) {
+			printf("mkvol %d failed\n", i);
+			exit(1);
+		}
+	}
+}
+
+static void write_leb(struct ubi_device *ubi, int vol_id, int lnum, int gen)
+{
+	struct ubi_volume_desc *d;
+
+	d = ubi_open_volume(0, vol_id, UBI_READWRITE);
+	if (IS_ERR(d)) {
+		printf("open volume %d failed\n", vol_id);
+		exit(1);
+	}
+	fill(buf, vol_id, lnum, gen, ubi->leb_size);
+	if (ubi_is_mapped(d, lnum))
+		ubi_leb_unmap(d, lnum);
+	if (ubi_leb_write(d, lnum, buf, 0, ubi->leb_size, UBI_UNKNOWN)) {
+		printf("write %d:%d failed\n", vol_id, lnum);
+		exit(1);
+	}
+	ubi_close_volume(d);
+}
+
+static void do_write(struct ubi_device *ubi, int seed)
+{
+	unsigned int x = seed;
+	int i, vol_id, lnum;
+
+	for (i = 0; i < WRITES; i++) {
+		next_write(&x, &vol_id, &lnum);
+		write_leb(ubi, vol_id, lnum, seed * 1000 + i);
+	}
+	printf("write: %ld erases\n", nerases);
+}
+
+static void verify_leb(struct ubi_device *ubi, int vol_id, int lnum, int gen)
+{
+	static unsigned char exp[PEB_SIZE];
+	struct ubi_volume_desc *d;
+
+	d = ubi_open_volume(0, vol_id, UBI_READONLY);
+	if (IS_ERR(d)) {
+		printf("open volume %d failed\n", vol_id);
+		exit(1);
+	}
+	fill(exp, vol_id, lnum, gen, ubi->leb_size);
+	memset(buf, 0, ubi->leb_size);
+	if (ubi_leb_read(d, lnum, (char *)buf, 0, ubi->leb_size, 1) ||
+	    memcmp(buf, exp, ubi->leb_size)) {
+		printf("verify failed: volume %d LEB %d\n", vol_id, lnum);
+		exit(1);
+	}
+	ubi_close_volume(d);
+}
+
+static void do_verify(struct ubi_device *ubi, int seed)
+{
+	static int gen[NVOLS][300];
+	int s, i, vol_id, lnum, n = 0;
+	unsigned int x;
+
+	/* Replay the writes to learn the last generation of every LEB */
+	memset(gen, -1, sizeof(gen));
+	for (s = 1; s <= seed; s++) {
+		x = s;
+		for (i = 0; i < WRITES; i++) {
+			next_write(&x, &vol_id, &lnum);
+			gen[vol_id][lnum] = s * 1000 + i;
+		}
+	}
+
+	for (vol_id = 0; vol_id < NVOLS; vol_id++)
+		for (lnum = 0; lnum < vol_lebs(vol_id); lnum++)
+			if (gen[vol_id][lnum] >= 0) {
+				verify_leb(ubi, vol_id, lnum, gen[vol_id][lnum]);
+				n++;
+			}
+
+#ifdef CONFIG_MTD_UBI_FASTMAP
+	printf("verified %d LEBs, fastmap %s\n", n, ubi->fm ? "present" : "none");
+#else
+	printf("verified %d LEBs\n", n);
+#endif
+}
+
+static void dump(struct ubi_device *ubi, const char *fn)
+{
+	static char out[1 << 20];
+	struct ubi_volume *v;
+	int i, j, fd, n = 0;
+
+	for (i = 0; i < ubi->vtbl_slots + UBI_INT_VOL_COUNT; i++) {
+		v = ubi->volumes[i];
+		if (!v)
+			continue;
+		n += sprintf(out + n, "vol %d type %d used %d last %d pad %d rsv %d:",
+			     v->vol_id, v->vol_type, v->used_ebs,
+			     v->last_eb_bytes, v->data_pad, v->reserved_pebs);
+		for (j = 0; j < v->reserved_pebs; j++)
+			n += sprintf(out + n, " %d", v->eba_tbl[j]);
+		n += sprintf(out + n, "\n");
+	}
+	n += sprintf(out + n, "avail %d rsvd %d beb %d bad %d good %d\n",
+		     ubi->avail_pebs, ubi->rsvd_pebs, ubi->beb_rsvd_pebs,
+		     ubi->bad_peb_count, ubi->good_peb_count);
+	for (i = 0; i < ubi->peb_count; i++)
+		if (ubi->lookuptbl[i])
+			n += sprintf(out + n, "%d:%d\n", i, ubi->lookuptbl[i]->ec);
+
+	fd = open(fn, H_O_WRONLY | H_O_CREAT | H_O_TRUNC, 0644);
+	if (fd < 0 || write(fd, out, n) != n) {
+		printf("cannot write %s\n", fn);
+		exit(1);
+	}
+}
+
+int main(int argc, char **argv)
+{
+	struct ubi_device *ubi;
+	long size = (long)PEB_SIZE * PEB_COUNT;
+	int fd, k;
+
+	if (argc < 3) {
+		printf("usage: %s <image> <step>...\n", argv[0]);
+		return 1;
+	}
+
+	fd = open(argv[1], H_O_RDWR | H_O_CREAT, 0644);
+	if (fd < 0 || ftruncate(fd, size)) {
+		printf("cannot open %s\n", argv[1]);
+		return 1;
+	}
+	flash = mmap(NULL, size, H_PROT_RW, H_MAP_SHARED, fd, 0);
+
+	mtd.name = "ram";
+	mtd.type = MTD_NANDFLASH;
+	mtd.flags = MTD_CAP_NANDFLASH;
+	mtd.size = size;
+	mtd.erasesize = PEB_SIZE;
+	mtd.writesize = PAGE_SIZE_;
+	mtd.read = ram_read;
+	mtd.write = ram_write;
+	mtd.erase = ram_erase;
+	mtd.block_isbad = ram_isbad;
+	mtd.block_markbad = ram_markbad;
+
+	for (k = 2; k < argc; k++) {
+		char *a = argv[k];
+
+		if (!strcmp(a, "erase")) {
+			memset(flash, 0xff, size);
+			continue;
+		}
+
+		ubi = attach();
+		if (!strcmp(a, "mkvols"))
+			mkvols(ubi);
+		else if (!strncmp(a, "write", 5))
+			do_write(ubi, atoi(a + 5));
+		else if (!strncmp(a, "verify", 6))
+			do_verify(ubi, atoi(a + 6));
+		else if (!strncmp(a, "dump=", 5))
+			dump(ubi, a + 5);
+		else if (strcmp(a, "attach")) {
+			printf("unknown step %s\n", a);
+			return 1;
+		}
+		ubi_exit();
+	}
+	return 0;
+}
@@ -0,0 +1,68 @@
+#!/bin/sh
+#
+# Attach a fastmap image as written and with LEBs moved into the pool
+# and to the orphan path, compare the result with a full scan, and check
+# that PEBs claiming an invalid volume ID make attach drop the fastmap.
+#
+
+set -e
+cd "$(dirname "$0")"
+[ -x ubi_fm_test ] && [ -x ubi_scan_test ] || {
+	echo "build the harness with make check (after make zipitz2_config)"
+	exit 1
+}
+T=test.tmp
+rm -rf $T
+mkdir $T
+
+fail() {
+	echo "FAIL: $*"
+	exit 1
+}
+
+# Lines that must match between a fastmap attach and a scan: the volume
+# EBA tables and PEB accounting. The fastmap PEBs themselves are only
+# known to the scan (which erases them), so erase counters are compared
+# one way only.
+same_layout() {
+	grep -v ':' $1 > $T/a; grep -v ':' $2 > $T/b
+	cmp -s $T/a $T/b || fail "$1 and $2 differ"
+	grep -vxFf $2 $1 | grep -q . && fail "$1 has PEBs not in $2"
+	return 0
+}
+
+./ubi_fm_test $T/img erase mkvols write1 write2 verify2 > $T/log
+cp $T/img $T/scan.img
+./ubi_scan_test $T/scan.img verify2 dump=$T/scan > $T/log.scan ||
+	fail "scan attach"
+
+for mode in none pool orphan; do
+	cp $T/img $T/$mode.img
+	[ $mode = none ] || python3 fmedit.py $T/$mode.img $mode > /dev/null
+	./ubi_fm_test $T/$mode.img verify2 dump=$T/$mode > $T/log.$mode ||
+		fail "$mode: verify"
+	grep -q 'fastmap present' $T/log.$mode || fail "$mode: no fastmap"
+	# A fastmap attach reads a handful of pages, a scan every PEB
+	reads=$(sed -n 's/^attach: \([0-9]*\) reads.*/\1/p' $T/log.$mode | head -1)
+	[ "$reads" -lt 512 ] || fail "$mode: attach fell back to scanning"
+	same_layout $T/$mode $T/scan
+	echo "$mode: ok ($reads reads)"
+done
+
+# A PEB found through the pool or orphan path that claims a volume ID
+# >= UBI_MAX_VOLUMES must not be accepted by the fastmap. The VID header
+# validation in io.c rejects it before attach_fastmap() sees the ID, so
+# this only checks that attach gives up on the fastmap.
+for mode in pool orphan; do
+	for vol_id in 128 129; do
+		cp $T/img $T/bad.img
+		python3 fmedit.py $T/bad.img $mode $vol_id > /dev/null
+		./ubi_fm_test $T/bad.img attach > $T/log.bad 2>&1 || true
+		grep -q 'fastmap is not usable' $T/log.bad ||
+			fail "$mode: fastmap accepted vol_id $vol_id"
+		echo "$mode vol_id $vol_id: fastmap rejected"
+	done
+done
+
+rm -rf $T
+echo "all tests passed"
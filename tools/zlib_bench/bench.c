@@ -0,0 +1,184 @@
+/*
+ * Host check and benchmark for inflate() in lib/zlib.c.
+ *
+ * Reads corpus.lst, written by mkcorpus.py: one raw deflate stream, the
+ * data it must inflate to and its window size per line. Every stream is
+ * inflated 20 times with random input and output chunk sizes, which
+ * exercises the window and the slow path of inflate(), and once in one
+ * piece; all output must match byte for byte. With "-t N", the one piece
+ * inflate is then timed over N runs.
+ *
+ * Built twice by the Makefile, with the generic inflate_fast() and with
+ * CONFIG_ZLIB_INFLATE_FAST_ARM, so both can be compared on the host.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ */
+
+#include <common.h>
+#include <malloc.h>
+#include <u-boot/zlib.h>
+
+/*
+ * The U-Boot headers replace the host libc ones (-nostdinc), so the
+ * few host calls used here are declared by hand.
+ */
+typedef struct FILE FILE;
+extern FILE *fopen(const char *, const char *);
+extern int fscanf(FILE *, const char *, ...);
+extern int open(const char *, int, ...);
+extern long read(int, void *, unsigned long);
+extern int close(int);
+extern void exit(int);
+extern int atoi(const char *);
+extern int rand(void);
+extern void srand(unsigned int);
+extern long clock(void);
+
+#define CLOCKS_PER_SEC	1000000
+#define CHUNKED_RUNS	20
+#define SLACK		4096	/* output space after the expected data */
+
+static void *zalloc(void *opaque, unsigned int items, unsigned int size)
+{
+	void *p = malloc(items * size);
+
+	if (p)
+		memset(p, 0, items * size);
+	return p;
+}
+
+static void zfree(void *opaque, void *p, unsigned int nb)
+{
+	free(p);
+}
+
+static unsigned char *slurp(const char *fn, long *len)
+{
+	static unsigned char tmp[16 << 20];
+	unsigned char *b;
+	int fd;
+
+	fd = open(fn, 0);
+	if (fd < 0) {
+		printf("cannot open %s\n", fn);
+		exit(1);
+	}
+	*len = read(fd, tmp, sizeof(tmp));
+	close(fd);
+	b = malloc(*len);
+	memcpy(b, tmp, *len);
+	return b;
+}
+
+/*
+ * Inflate src into dst, in one piece or, if chunked, feeding random input
+ * and output chunks; returns the output length.
+ */
+static long run(unsigned char *src, long slen, unsigned char *dst, long dlen,
+		int wbits, int chunked)
+{
+	z_stream z;
+	long ip = 0, op = 0;
+	unsigned int ci, co;
+	int r;
+
+	memset(&z, 0, sizeof(z));
+	z.zalloc = zalloc;
+	z.zfree = zfree;
+	if (inflateInit2(&z, -wbits) != Z_OK) {
+		printf("inflateInit2 failed\n");
+		exit(1);
+	}
+
+	do {
+		ci = slen - ip;
+		co = dlen - op;
+		if (chunked) {
+			ci = 1 + rand() % (rand() % 2 ? 16 : 5000);
+			co = 1 + rand() % (rand() % 2 ? 300 : 70000);
+			if (ci > slen - ip)
+				ci = slen - ip;
+			if (co > dlen - op)
+				co = dlen - op;
+		}
+		z.next_in = src + ip;
+		z.avail_in = ci;
+		z.next_out = dst + op;
+		z.avail_out = co;
+		r = inflate(&z, Z_NO_FLUSH);
+		ip = z.next_in - src;
+		op = z.next_out - dst;
+		if (r != Z_OK && r != Z_STREAM_END && r != Z_BUF_ERROR) {
+			printf("inflate error %d (%s)\n", r, z.msg);
+			exit(1);
+		}
+	} while (r != Z_STREAM_END);
+
+	inflateEnd(&z);
+	return op;
+}
+
+static void check(unsigned char *c, long clen, unsigned char *ref, long rlen,
+		  unsigned char *o, int wbits, int chunked, const char *name)
+{
+	memset(o, 0x5a, rlen + SLACK);
+	if (run(c, clen, o, rlen + SLACK, wbits, chunked) != rlen ||
+	    memcmp(o, ref, rlen)) {
+		printf("MISMATCH %s%s\n", name, chunked ? " (chunked)" : "");
+		exit(1);
+	}
+}
+
+int main(int argc, char **argv)
+{
+	char cname[256], rname[256];
+	unsigned char *c, *ref, *o;
+	long clen, rlen, t, total = 0, tall = 0;
+	int wbits, reps = 0, i;
+	FILE *f;
+
+	if (argc == 3 && !strcmp(argv[1], "-t"))
+		reps = atoi(argv[2]);
+
+	f = fopen("corpus.lst", "r");
+	if (!f) {
+		printf("no corpus.lst, run mkcorpus.py first\n");
+		return 1;
+	}
+
+	srand(42);
+	while (fscanf(f, "%255s %255s %d", cname, rname, &wbits) == 3) {
+		c = slurp(cname, &clen);
+		ref = slurp(rname, &rlen);
+		o = malloc(rlen + SLACK);
+
+		for (i = 0; i < CHUNKED_RUNS; i++)
+			check(c, clen, ref, rlen, o, wbits, 1, cname);
+		check(c, clen, ref, rlen, o, wbits, 0, cname);
+
+		if (reps) {
+			t = clock();
+			for (i = 0; i < reps; i++)
+				run(c, clen, o, rlen + SLACK, wbits, 0);
+			t = clock() - t;
+			tall += t;
+			total += rlen;
+			printf("%-26s %8ld -> %8ld  %7.1f MB/s\n", cname, clen,
+			       rlen, reps * (double)rlen * CLOCKS_PER_SEC /
+			       (t ? t : 1) / 1e6);
+		}
+		free(c);
+		free(ref);
+		free(o);
+	}
+
+	if (reps)
+		printf("all bit-exact, total %.1f MB/s\n", reps * (double)total *
+		       CLOCKS_PER_SEC / (tall ? tall : 1) / 1e6);
+	else
+		printf("all bit-exact\n");
+	return 0;
+}
@@ -0,0 +1,92 @@
+#!/usr/bin/env python3
+#
+# Write the test corpus of bench.c into a directory:
+#
+#   mkcorpus.py <dir> [binary]
+#
+# Four inputs: a tar of part of the U-Boot sources (text), a host binary
+# (default: the python interpreter), synthetic data made of runs, short and
+# long matches and literals, and random data. Each is compressed as raw
+# deflate at levels 1, 6 and 9, with the fixed, RLE and Huffman-only
+# strategies, and with a 512 byte window, and listed in corpus.lst.
+
+import io
+import os
+import random
+import sys
+import tarfile
+import zlib
+
+SRCTREE = os.path.join(os.path.dirname(os.path.abspath(__file__)), '..', '..')
+
+# (level, strategy, window bits)
+SETTINGS = [
+    (1, 0, 15),
+    (6, 0, 15),
+    (9, 0, 15),
+    (6, zlib.Z_FIXED, 15),
+    (6, zlib.Z_RLE, 15),
+    (6, zlib.Z_HUFFMAN_ONLY, 15),
+    (9, 0, 9),
+]
+
+
+def text():
+    buf = io.BytesIO()
+    with tarfile.open(fileobj=buf, mode='w') as t:
+        for d in ['lib', 'fs', 'drivers/mtd', 'common', 'README']:
+            t.add(os.path.join(SRCTREE, d), arcname=d)
+    return buf.getvalue()[:6 << 20]
+
+
+def synth(r):
+    out = bytearray()
+    while len(out) < (3 << 20):
+        k = r.randrange(10)
+        if k < 3:
+            # runs of short patterns
+            d = r.choice([1, 2, 3, 4, 5, 6, 7, 8, 9, 12, 16, 31])
+            pat = bytes(r.randrange(256) for _ in range(d))
+            out += pat * (r.randrange(300) // d + 2)
+        elif k < 5:
+            out += bytes(r.randrange(256) for _ in range(r.randrange(1, 40)))
+        elif k < 8 and len(out) > 40000:
+            # matches up to the full 32K window back, possibly overlapping
+            s = len(out) - r.randrange(1, 33000)
+            for i in range(r.randrange(3, 600)):
+                out.append(out[s + i])
+        else:
+            out += bytes(r.choice(b'abcdefgh ')
+                         for _ in range(r.randrange(1, 200)))
+    return bytes(out)
+
+
+def main():
+    outdir = sys.argv[1]
+    binary = sys.argv[2] if len(sys.argv) > 2 else sys.executable
+    r = random.Random(7)
+
+    srcs = {
+        'text': text(),
+        'elf': open(binary, 'rb').read()[:4 << 20],
+        'synth': synth(r),
+        'random': bytes(r.randrange(256) for _ in range(1 << 20)),
+    }
+
+    os.makedirs(outdir, exist_ok=True)
+    lst = []
+    for name, data in srcs.items():
+        with open(os.path.join(outdir, name + '.raw'), 'wb') as f:
+            f.write(data)
+        for level, strategy, wbits in SETTINGS:
+            c = zlib.compressobj(level, zlib.DEFLATED, -wbits, 9, strategy)
+            fn = '%s_%d_%d_%d.def' % (name, level, strategy, wbits)
+            with open(os.path.join(outdir, fn), 'wb') as f:
+                f.write(c.compress(data) + c.flush())
+            lst.append('%s %s.raw %d\n' % (fn, name, wbits))
+    with open(os.path.join(outdir, 'corpus.lst'), 'w') as f:
+        f.write(''.join(lst))
+
+
+if __name__ == '__main__':
+    main()